@@ -0,0 +1,74 @@
+﻿# 离线流水线基准测试：本地媒体文件（或本机UDP回环推流）经 拉流→解码→空输出，
+# 按实时/极速节奏运行N路并发，输出帧率、各阶段耗时分位数、CPU与峰值内存的JSON报告
+QT       += core gui multimedia widgets
+
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+TARGET = PipelineBench
+
+# 与主程序一致：发布版不生成调试日志代码
+CONFIG(release, debug|release): DEFINES += LOG_MIN_LEVEL=1
+
+INCLUDEPATH += $$PWD/.. \
+    $$PWD/../include \
+    $$PWD/../include/FFmpeg \
+    $$PWD/../LogDemo \
+    $$PWD/../Pull
+
+SOURCES += \
+    main.cpp \
+    benchrunner.cpp \
+    ../LogDemo/Logger.cpp \
+    ../Pull/audiodecodethread.cpp \
+    ../Pull/audioplayer.cpp \
+    ../Pull/audioringbuffer.cpp \
+    ../Pull/avsyncengine.cpp \
+    ../Pull/decodescheduler.cpp \
+    ../Pull/decodethreading.cpp \
+    ../Pull/frameconverter.cpp \
+    ../Pull/framepool.cpp \
+    ../Pull/glvideorenderer.cpp \
+    ../Pull/gopcache.cpp \
+    ../Pull/packetring.cpp \
+    ../Pull/pipelinemetrics.cpp \
+    ../Pull/playimage.cpp \
+    ../Pull/rtspsyncpull.cpp \
+    ../Pull/streampullthread.cpp \
+    ../Pull/videodecodethread.cpp
+
+HEADERS += \
+    benchrunner.h \
+    ../DataStruct.h \
+    ../LogDemo/Logger.h \
+    ../Pull/audiodecodethread.h \
+    ../Pull/audioplayer.h \
+    ../Pull/audioringbuffer.h \
+    ../Pull/avsyncengine.h \
+    ../Pull/decodescheduler.h \
+    ../Pull/decodethreading.h \
+    ../Pull/frameconverter.h \
+    ../Pull/framepool.h \
+    ../Pull/glvideorenderer.h \
+    ../Pull/gopcache.h \
+    ../Pull/packetring.h \
+    ../Pull/pipelinemetrics.h \
+    ../Pull/playimage.h \
+    ../Pull/rtspsyncpull.h \
+    ../Pull/streampullthread.h \
+    ../Pull/videodecodethread.h
+
+# msvc >= 2017  编译器使用utf-8编码
+msvc {
+    greaterThan(QMAKE_MSC_VER, 1900){
+        QMAKE_CFLAGS += /utf-8
+        QMAKE_CXXFLAGS += /utf-8
+    }
+}
+
+win32: LIBS += -lpsapi
+
+DEPENDPATH += $$PWD/../lib \
+              $$PWD/../lib/FFmpeg \
+
+LIBS += -L$$PWD/../lib/FFmpeg/ -lavcodec -lavfilter -lavformat -lswscale -lavutil -lswresample -lavdevice
@@ -0,0 +1,382 @@
+﻿#include "benchrunner.h"
+#include "decodescheduler.h"
+#include "decodethreading.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QProcess>
+#include <QThread>
+#include <QTimer>
+#include <cstdio>
+#include "Logger.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+const char *paceName(RTSPSyncPull::SinkPace pace)
+{
+    return pace == RTSPSyncPull::RealtimePace ? "realtime" : "maxspeed";
+}
+
+// 合并多路会话的阶段统计（直方图逐桶相加）
+void mergeStage(PipelineMetrics::StageSnapshot &total, const PipelineMetrics::StageSnapshot &stage)
+{
+    total.count += stage.count;
+    total.totalUs += stage.totalUs;
+    total.maxUs = qMax(total.maxUs, stage.maxUs);
+    for (int i = 0; i < PipelineMetrics::BucketCount; ++i) {
+        total.buckets[i] += stage.buckets[i];
+    }
+}
+
+double perSecond(quint64 count, qint64 elapsedMs)
+{
+    return elapsedMs > 0 ? count * 1000.0 / elapsedMs : 0.0;
+}
+
+} // namespace
+
+BenchRunner::BenchRunner(const Options &options, QObject *parent)
+    : QObject(parent)
+    , m_options(options)
+    , m_durationTimer(new QTimer(this))
+{
+    m_durationTimer->setSingleShot(true);
+    connect(m_durationTimer, &QTimer::timeout, this, &BenchRunner::finish);
+}
+
+BenchRunner::~BenchRunner()
+{
+    for (Session &session : m_sessions) {
+        delete session.pull;
+    }
+    m_sessions.clear();
+
+    for (QProcess *source : m_loopbackSources) {
+        source->kill();
+        source->waitForFinished(1000);
+        delete source;
+    }
+    m_loopbackSources.clear();
+}
+
+bool BenchRunner::start()
+{
+    if (m_options.inputs.isEmpty() || m_options.streams <= 0) {
+        LogErr << "No input or stream count is zero";
+        return false;
+    }
+    if (m_options.loopback && m_options.durationSec <= 0) {
+        // 回环输入是直播流，不会自然结束
+        LogErr << "Loopback mode requires a duration";
+        return false;
+    }
+
+    if (m_options.poolThreads >= 0) {
+        m_scheduler = std::make_unique<DecodeScheduler>(m_options.poolThreads);
+    }
+
+    m_clock.start();
+    m_cpuStartUs = processCpuUs();
+
+    m_sessions.resize(m_options.streams);
+    for (int i = 0; i < m_options.streams; ++i) {
+        Session &session = m_sessions[i];
+        session.input = m_options.inputs.at(i % m_options.inputs.size());
+        session.url = session.input;
+
+        if (m_options.loopback) {
+            const int port = m_options.loopbackBasePort + i;
+            if (!startLoopbackSource(session.input, port)) {
+                return false;
+            }
+            session.url = QString("udp://127.0.0.1:%1?overrun_nonfatal=1&fifo_size=1000000").arg(port);
+        }
+
+        session.pull = new RTSPSyncPull();
+        session.pull->setObjectName(QString("bench%1").arg(i));
+        session.pull->setNullAudioOutput(true);
+        session.pull->setNullVideoOutput(true);
+        session.pull->setSinkPace(m_options.pace);
+        session.pull->setScheduler(m_scheduler.get());
+        session.pull->setHardwareDecoding(m_options.hardwareDecoding, m_options.hwDeviceTypes);
+        session.pull->setKeyframeOnly(m_options.keyframeOnly);
+
+        connect(session.pull, &RTSPSyncPull::playbackStarted, this, [this, i]() {
+            onSessionStarted(i);
+        });
+        connect(session.pull, &RTSPSyncPull::playbackFinished, this, [this, i]() {
+            onSessionEnded(i);
+        });
+        connect(session.pull, &RTSPSyncPull::errorOccurred, this, [this, i](const QString &error) {
+            Session &failed = m_sessions[i];
+            failed.errors.append(error);
+            // 未开始播放就出错（无法打开输入），不再等待该路结束
+            if (!failed.started) {
+                onSessionEnded(i);
+            }
+        });
+
+        session.pull->start(session.url);
+    }
+
+    if (m_options.durationSec > 0) {
+        m_durationTimer->start(m_options.durationSec * 1000);
+    }
+
+    LogInfo << "Benchmark started: " << m_options.streams << " streams, "
+            << paceName(m_options.pace) << ", "
+            << (m_scheduler ? QString("pool %1 threads").arg(m_scheduler->threadCount())
+                            : QString("thread per stream"));
+    return true;
+}
+
+bool BenchRunner::startLoopbackSource(const QString &input, int port)
+{
+    // 按原始速率推送（-re），循环输入直到测试结束
+    QProcess *source = new QProcess();
+    source->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    source->start(m_options.ffmpegPath, QStringList()
+                  << "-hide_banner" << "-loglevel" << "error"
+                  << "-re" << "-stream_loop" << "-1"
+                  << "-i" << input
+                  << "-c" << "copy"
+                  << "-f" << "mpegts"
+                  << QString("udp://127.0.0.1:%1?pkt_size=1316").arg(port));
+    m_loopbackSources.push_back(source);
+
+    if (!source->waitForStarted(3000)) {
+        LogErr << "Failed to start loopback source: " << m_options.ffmpegPath
+               << " (" << source->errorString() << ")";
+        return false;
+    }
+    return true;
+}
+
+void BenchRunner::onSessionStarted(int index)
+{
+    Session &session = m_sessions[index];
+    session.started = true;
+
+    // 统计从开始播放算起，不含连接与探测
+    session.pull->resetMetrics();
+}
+
+void BenchRunner::onSessionEnded(int index)
+{
+    Session &session = m_sessions[index];
+    if (session.ended) {
+        return;
+    }
+    session.ended = true;
+    session.snapshot = session.pull->metrics();
+    session.decoderThreads = session.pull->decodeThreads().threadCount;
+    session.decoderName = session.pull->videoDecoderName();
+
+    for (const Session &other : m_sessions) {
+        if (!other.ended) {
+            return;
+        }
+    }
+    finish();
+}
+
+void BenchRunner::finish()
+{
+    if (m_finished) {
+        return;
+    }
+    m_finished = true;
+    m_durationTimer->stop();
+
+    // 先取快照再停止，停止过程不计入统计
+    for (Session &session : m_sessions) {
+        if (!session.ended) {
+            session.snapshot = session.pull->metrics();
+            session.decoderThreads = session.pull->decodeThreads().threadCount;
+            session.decoderName = session.pull->videoDecoderName();
+        }
+    }
+    m_elapsedMs = m_clock.elapsed();
+    m_cpuUs = processCpuUs() - m_cpuStartUs;
+
+    for (Session &session : m_sessions) {
+        session.pull->stop();
+    }
+    for (QProcess *source : m_loopbackSources) {
+        source->kill();
+    }
+
+    const bool written = writeReport(buildReport());
+    emit finished(written ? 0 : 1);
+}
+
+QJsonObject BenchRunner::buildReport() const
+{
+    QJsonObject report;
+    report["pace"] = paceName(m_options.pace);
+    report["streams"] = m_options.streams;
+    report["threads"] = m_scheduler ? m_scheduler->threadCount() : -1;
+    report["decodeThreads"] = DecodeThreadingPolicy::instance().mode() == DecodeThreadingPolicy::AutoThreads
+                                  ? QJsonValue("auto")
+                                  : QJsonValue(DecodeThreadingPolicy::instance().resolve(0, 0, false).threadCount);
+    report["loopback"] = m_options.loopback;
+    report["hardwareDecoding"] = m_options.hardwareDecoding;
+    report["keyframeOnly"] = m_options.keyframeOnly;
+    report["inputs"] = QJsonArray::fromStringList(m_options.inputs);
+    report["elapsedMs"] = m_elapsedMs;
+
+    // CPU为整个进程的用户态+内核态时间，每路为平均值；100%表示占满一个核
+    const double cpuPercent = m_elapsedMs > 0 ? m_cpuUs / 10.0 / m_elapsedMs : 0.0;
+    QJsonObject cpu;
+    cpu["cpuMs"] = m_cpuUs / 1000;
+    cpu["percent"] = cpuPercent;
+    cpu["percentPerStream"] = cpuPercent / m_options.streams;
+    cpu["cores"] = QThread::idealThreadCount();
+    report["cpu"] = cpu;
+    report["peakRssBytes"] = peakRssBytes();
+
+    PipelineMetrics::Snapshot total;
+    QJsonArray sessions;
+    int failed = 0;
+    for (int i = 0; i < static_cast<int>(m_sessions.size()); ++i) {
+        const Session &session = m_sessions[i];
+        const PipelineMetrics::Snapshot &snapshot = session.snapshot;
+
+        QJsonObject entry;
+        entry["index"] = i;
+        entry["input"] = session.input;
+        entry["started"] = session.started;
+        entry["completed"] = session.ended && session.errors.isEmpty();
+        entry["elapsedMs"] = snapshot.elapsedMs;
+        entry["decoderThreads"] = session.decoderThreads;
+        entry["decoder"] = session.decoderName;
+        entry["videoFps"] = perSecond(snapshot.videoFramesPresented, snapshot.elapsedMs);
+        entry["decodedFps"] = perSecond(snapshot.videoFramesDecoded, snapshot.elapsedMs);
+        entry["videoFramesDecoded"] = static_cast<qint64>(snapshot.videoFramesDecoded);
+        entry["videoFramesPresented"] = static_cast<qint64>(snapshot.videoFramesPresented);
+        entry["videoFramesDropped"] = static_cast<qint64>(snapshot.videoFramesDropped);
+        entry["audioFramesDecoded"] = static_cast<qint64>(snapshot.audioFramesDecoded);
+        entry["videoPacketsDropped"] = static_cast<qint64>(snapshot.videoPacketsDropped);
+        entry["audioPacketsDropped"] = static_cast<qint64>(snapshot.audioPacketsDropped);
+
+        QJsonObject stages;
+        for (int s = 0; s < PipelineMetrics::StageCount; ++s) {
+            const auto stage = static_cast<PipelineMetrics::Stage>(s);
+            if (snapshot.stage(stage).count > 0) {
+                stages[PipelineMetrics::stageName(stage)] = stageJson(snapshot.stage(stage));
+            }
+            mergeStage(total.stages[s], snapshot.stage(stage));
+        }
+        entry["stages"] = stages;
+        entry["errors"] = QJsonArray::fromStringList(session.errors);
+        sessions.append(entry);
+
+        total.videoFramesDecoded += snapshot.videoFramesDecoded;
+        total.videoFramesPresented += snapshot.videoFramesPresented;
+        total.videoFramesDropped += snapshot.videoFramesDropped;
+        total.audioFramesDecoded += snapshot.audioFramesDecoded;
+        if (!session.started || !session.errors.isEmpty()) {
+            ++failed;
+        }
+    }
+
+    QJsonObject totals;
+    totals["videoFps"] = perSecond(total.videoFramesPresented, m_elapsedMs);
+    totals["decodedFps"] = perSecond(total.videoFramesDecoded, m_elapsedMs);
+    totals["videoFramesPresented"] = static_cast<qint64>(total.videoFramesPresented);
+    totals["videoFramesDropped"] = static_cast<qint64>(total.videoFramesDropped);
+    totals["audioFramesDecoded"] = static_cast<qint64>(total.audioFramesDecoded);
+    totals["failedStreams"] = failed;
+    QJsonObject stages;
+    for (int s = 0; s < PipelineMetrics::StageCount; ++s) {
+        if (total.stages[s].count > 0) {
+            stages[PipelineMetrics::stageName(static_cast<PipelineMetrics::Stage>(s))]
+                = stageJson(total.stages[s]);
+        }
+    }
+    totals["stages"] = stages;
+    report["totals"] = totals;
+    report["sessions"] = sessions;
+    return report;
+}
+
+bool BenchRunner::writeReport(const QJsonObject &report) const
+{
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    if (m_options.outputPath.isEmpty()) {
+        fwrite(json.constData(), 1, static_cast<size_t>(json.size()), stdout);
+        fflush(stdout);
+        return true;
+    }
+
+    QFile file(m_options.outputPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+        LogErr << "Failed to write report: " << m_options.outputPath;
+        return false;
+    }
+    return true;
+}
+
+QJsonObject BenchRunner::stageJson(const PipelineMetrics::StageSnapshot &stage)
+{
+    // 分位数为直方图桶上界（2的幂微秒）的估计值
+    QJsonObject json;
+    json["count"] = static_cast<qint64>(stage.count);
+    json["avgUs"] = stage.averageUs();
+    json["p50Us"] = stage.percentileUs(0.50);
+    json["p90Us"] = stage.percentileUs(0.90);
+    json["p99Us"] = stage.percentileUs(0.99);
+    json["maxUs"] = stage.maxUs;
+    return json;
+}
+
+qint64 BenchRunner::processCpuUs()
+{
+#ifdef Q_OS_WIN
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    // FILETIME单位为100纳秒
+    const auto toUs = [](const FILETIME &time) {
+        return ((qint64(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 10;
+    };
+    return toUs(kernel) + toUs(user);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return (qint64(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000
+           + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+qint64 BenchRunner::peakRssBytes()
+{
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return static_cast<qint64>(counters.PeakWorkingSetSize);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef Q_OS_MACOS
+    return usage.ru_maxrss;             // macOS为字节
+#else
+    return qint64(usage.ru_maxrss) * 1024;  // Linux为KB
+#endif
+#endif
+}
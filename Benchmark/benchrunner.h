@@ -0,0 +1,93 @@
+﻿#ifndef BENCHRUNNER_H
+#define BENCHRUNNER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QStringList>
+#include <memory>
+#include <vector>
+#include "rtspsyncpull.h"
+
+class QProcess;
+class QTimer;
+class DecodeScheduler;
+
+/**
+ * @brief 流水线基准测试：N路会话并发播放本地输入到空输出，结束后输出JSON报告
+ *
+ * 每路会话是完整的 RTSPSyncPull（拉流→解码→同步），音视频均使用空输出，
+ * 节奏为实时（按时间戳消费）或极速（解码多快消费多快）。输入按会话序号轮流分配。
+ * 回环模式下为每路会话启动一个 ffmpeg -re 进程，把输入以MPEG-TS推到本机UDP端口再拉取，
+ * 近似真实网络直播输入（需要PATH中有ffmpeg可执行文件）。
+ * 所有会话播放结束或到达指定时长后停止，统计帧率、各阶段耗时分位数、进程CPU与峰值内存。
+ */
+class BenchRunner : public QObject
+{
+    Q_OBJECT
+public:
+    struct Options {
+        QStringList inputs;
+        int streams = 1;
+        RTSPSyncPull::SinkPace pace = RTSPSyncPull::MaxSpeedPace;
+        int durationSec = 0;            // 0表示运行到所有输入结束（回环模式必须指定）
+        int poolThreads = -1;           // <0 每路独立线程，0 按CPU核数建线程池，>0 指定线程数
+        bool hardwareDecoding = false;
+        QList<AVHWDeviceType> hwDeviceTypes;    // 为空时使用平台默认顺序
+        bool keyframeOnly = false;              // 预览模式，只解码关键帧
+        bool loopback = false;
+        QString ffmpegPath = "ffmpeg";
+        int loopbackBasePort = 23000;
+        QString outputPath;             // 为空时输出到标准输出
+    };
+
+    explicit BenchRunner(const Options &options, QObject *parent = nullptr);
+    ~BenchRunner();
+
+    // 启动所有会话，参数错误时返回false
+    bool start();
+
+signals:
+    // 报告已输出，exitCode为进程退出码
+    void finished(int exitCode);
+
+private:
+    struct Session {
+        RTSPSyncPull *pull = nullptr;
+        QString input;
+        QString url;
+        bool started = false;
+        bool ended = false;
+        QStringList errors;
+        int decoderThreads = 0;                 // 结束时视频解码器的线程数
+        QString decoderName;                    // 结束时的解码方式（硬件回退后为software）
+        PipelineMetrics::Snapshot snapshot;     // 结束时的统计
+    };
+
+    void onSessionStarted(int index);
+    void onSessionEnded(int index);
+    void finish();
+    bool startLoopbackSource(const QString &input, int port);
+
+    QJsonObject buildReport() const;
+    bool writeReport(const QJsonObject &report) const;
+
+    static QJsonObject stageJson(const PipelineMetrics::StageSnapshot &stage);
+    static qint64 processCpuUs();
+    static qint64 peakRssBytes();
+
+private:
+    Options m_options;
+    std::vector<Session> m_sessions;
+    std::unique_ptr<DecodeScheduler> m_scheduler;
+    std::vector<QProcess*> m_loopbackSources;
+    QTimer *m_durationTimer = nullptr;
+
+    QElapsedTimer m_clock;
+    qint64 m_cpuStartUs = 0;
+    qint64 m_elapsedMs = 0;
+    qint64 m_cpuUs = 0;
+    bool m_finished = false;
+};
+
+#endif // BENCHRUNNER_H
@@ -0,0 +1,75 @@
+﻿#include <QCoreApplication>
+#include <QCommandLineParser>
+#include "benchrunner.h"
+#include "decodethreading.h"
+#include "Logger.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("PipelineBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Run local media through pull -> decode -> null sinks and report JSON metrics");
+    parser.addHelpOption();
+    parser.addPositionalArgument("inputs", "Local media files (MP4/MKV/TS) or stream URLs", "<input>...");
+    QCommandLineOption streamsOption(QStringList() << "n" << "streams", "Concurrent streams (default 1)", "count", "1");
+    QCommandLineOption paceOption("pace", "realtime or maxspeed (default maxspeed)", "pace", "maxspeed");
+    QCommandLineOption durationOption(QStringList() << "d" << "duration", "Stop after seconds (default: until inputs end)", "seconds", "0");
+    QCommandLineOption poolOption("pool", "Use a shared decode pool with this many threads (0 = CPU count)", "threads");
+    QCommandLineOption decodeThreadsOption("decode-threads", "Threads per video decoder: auto (by resolution and stream count) or a fixed count", "threads", "auto");
+    QCommandLineOption hwaccelOption("hwaccel", "Hardware decode preference, e.g. \"vaapi,vdpau\", \"auto\" or \"none\" (default none)", "types", "none");
+    QCommandLineOption keyframeOnlyOption("keyframe-only", "Decode keyframes only (camera wall preview mode)");
+    QCommandLineOption loopbackOption("loopback", "Push each input over local UDP with 'ffmpeg -re' and pull it back");
+    QCommandLineOption ffmpegOption("ffmpeg", "ffmpeg executable for loopback mode", "path", "ffmpeg");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "JSON report file (default: stdout)", "file");
+    QCommandLineOption logRulesOption("log-rules", "Log level rules (default \"*=warn\")", "rules", "*=warn");
+    parser.addOption(streamsOption);
+    parser.addOption(paceOption);
+    parser.addOption(durationOption);
+    parser.addOption(poolOption);
+    parser.addOption(decodeThreadsOption);
+    parser.addOption(hwaccelOption);
+    parser.addOption(keyframeOnlyOption);
+    parser.addOption(loopbackOption);
+    parser.addOption(ffmpegOption);
+    parser.addOption(outputOption);
+    parser.addOption(logRulesOption);
+    parser.process(app);
+
+    if (parser.positionalArguments().isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    // 日志写结构化文件，默认只留警告以上，避免日志本身影响测量
+    Logger::initLog("BenchLog", 64, true, Logger::StructuredFormat);
+    Logger::setLogRules(parser.value(logRulesOption));
+
+    const QString decodeThreads = parser.value(decodeThreadsOption);
+    if (decodeThreads != "auto") {
+        DecodeThreadingPolicy::instance().setFixed(decodeThreads.toInt());
+    }
+
+    BenchRunner::Options options;
+    options.inputs = parser.positionalArguments();
+    options.streams = parser.value(streamsOption).toInt();
+    options.pace = parser.value(paceOption) == "realtime" ? RTSPSyncPull::RealtimePace
+                                                          : RTSPSyncPull::MaxSpeedPace;
+    options.durationSec = parser.value(durationOption).toInt();
+    options.poolThreads = parser.isSet(poolOption) ? parser.value(poolOption).toInt() : -1;
+    options.hardwareDecoding = parser.value(hwaccelOption) != "none";
+    if (options.hardwareDecoding) {
+        options.hwDeviceTypes = VideoDecodeThread::parseHardwareDeviceTypes(parser.value(hwaccelOption));
+    }
+    options.keyframeOnly = parser.isSet(keyframeOnlyOption);
+    options.loopback = parser.isSet(loopbackOption);
+    options.ffmpegPath = parser.value(ffmpegOption);
+    options.outputPath = parser.value(outputOption);
+
+    BenchRunner runner(options);
+    QObject::connect(&runner, &BenchRunner::finished, &app, &QCoreApplication::exit);
+    if (!runner.start()) {
+        return 2;
+    }
+    return app.exec();
+}
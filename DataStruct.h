@@ -15,6 +15,7 @@ extern "C" {
 #include <libavutil/rational.h>
 #include <libavutil/time.h>
 #include <libavutil/frame.h>
+#include <libavutil/hwcontext.h>
 }
 
 enum class PushState {
@@ -27,4 +28,23 @@ enum class PushState {
 };
 Q_DECLARE_METATYPE(PushState); // 在类的声明之后添加这个宏
 
+// 流水线单步执行结果，独立线程模式与线程池调度模式共用
+struct StepResult
+{
+    enum Status {
+        Progress,   // 有进展，可立即再次执行
+        Idle,       // 暂无数据，等待生产者唤醒
+        Wait,       // 需在waitMs毫秒后再执行（帧率控制/背压）
+        Finished    // 已结束
+    };
+
+    Status status = Progress;
+    int waitMs = 0;
+
+    static StepResult progress() { return {Progress, 0}; }
+    static StepResult idle() { return {Idle, 0}; }
+    static StepResult wait(int ms) { return {Wait, ms}; }
+    static StepResult finished() { return {Finished, 0}; }
+};
+
 #endif // DATASTRUCT_H
@@ -0,0 +1,24 @@
+﻿# 结构化日志（Logger::StructuredFormat）转换工具：输出为HTML日志模板或纯文本
+QT       -= gui
+
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+TARGET = LogConvert
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    main.cpp
+
+HEADERS += \
+    ../LoggerTemplate.h \
+    ../StructuredLog.h
+
+# msvc >= 2017  编译器使用utf-8编码
+msvc {
+    greaterThan(QMAKE_MSC_VER, 1900){
+        QMAKE_CFLAGS += /utf-8
+        QMAKE_CXXFLAGS += /utf-8
+    }
+}
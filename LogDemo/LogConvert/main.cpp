@@ -0,0 +1,127 @@
+﻿#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <cstdio>
+#include "LoggerTemplate.h"
+#include "StructuredLog.h"
+
+namespace
+{
+
+// 与HTML日志中各级别的样式类对应
+char htmlClass(const QByteArray &level)
+{
+    if (level == "WARN") return 'w';
+    if (level == "ERROR") return 'c';
+    if (level == "FATAL") return 'f';
+    if (level == "INFO") return 'i';
+    return 'd';
+}
+
+QByteArray formatPrefix(const Logger::StructuredLogEntry &entry)
+{
+    QByteArray prefix;
+    prefix.append('[')
+        .append(QDateTime::fromMSecsSinceEpoch(entry.timestampMs).toString("yyyy-MM-dd hh:mm:ss.zzz").toLatin1())
+        .append("][").append(entry.level).append(']');
+    if (!entry.module.isEmpty()) {
+        prefix.append('[').append(entry.module).append(']');
+    }
+    prefix.append('[').append(entry.thread).append("] ");
+    return prefix;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("LogConvert");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Convert structured PullStreamDemo logs to HTML or plain text");
+    parser.addHelpOption();
+    parser.addPositionalArgument("files", "Structured log files (*.log)", "<file>...");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Output file (default: stdout)", "file");
+    QCommandLineOption textOption("text", "Write plain text instead of HTML");
+    QCommandLineOption moduleOption("module", "Only entries of this module (pull/video/audio/player)", "name");
+    QCommandLineOption levelOption("level", "Only entries of this level (DEBUG/INFO/WARN/ERROR/FATAL)", "level");
+    parser.addOption(outputOption);
+    parser.addOption(textOption);
+    parser.addOption(moduleOption);
+    parser.addOption(levelOption);
+    parser.process(app);
+
+    const QStringList inputs = parser.positionalArguments();
+    if (inputs.isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    QFile output;
+    if (parser.isSet(outputOption)) {
+        output.setFileName(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            fprintf(stderr, "Cannot open %s\n", qPrintable(output.fileName()));
+            return 1;
+        }
+    } else if (!output.open(stdout, QIODevice::WriteOnly)) {
+        return 1;
+    }
+
+    const bool html = !parser.isSet(textOption);
+    const QByteArray moduleFilter = parser.value(moduleOption).toUtf8();
+    const QByteArray levelFilter = parser.value(levelOption).toUpper().toUtf8();
+
+    if (html) {
+        output.write(Logger::logTemplate.toUtf8());
+        output.write("\r\n");
+    }
+
+    int converted = 0;
+    int malformed = 0;
+    for (const QString &input : inputs) {
+        QFile file(input);
+        if (!file.open(QIODevice::ReadOnly)) {
+            fprintf(stderr, "Cannot open %s\n", qPrintable(input));
+            continue;
+        }
+
+        while (!file.atEnd()) {
+            QByteArray line = file.readLine();
+            if (line.endsWith('\n')) {
+                line.chop(1);
+            }
+            if (line.isEmpty() || line.startsWith('#')) {
+                continue;
+            }
+
+            Logger::StructuredLogEntry entry;
+            if (!Logger::parseStructuredLine(line, &entry)) {
+                ++malformed;
+                continue;
+            }
+            if ((!moduleFilter.isEmpty() && entry.module != moduleFilter)
+                    || (!levelFilter.isEmpty() && entry.level != levelFilter)) {
+                continue;
+            }
+
+            const QByteArray prefix = formatPrefix(entry);
+            if (html) {
+                QByteArray div("<div class=\"");
+                div.append(htmlClass(entry.level)).append("\">")
+                    .append(QString::fromUtf8(prefix + entry.message).toHtmlEscaped().toUtf8())
+                    .append("</div>\r\n");
+                output.write(div);
+            } else {
+                output.write(prefix + entry.message + '\n');
+            }
+            ++converted;
+        }
+    }
+
+    fprintf(stderr, "%d entries converted, %d malformed lines skipped\n", converted, malformed);
+    return 0;
+}
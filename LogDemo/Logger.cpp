@@ -1,5 +1,6 @@
 ﻿#include "Logger.h"
 #include "LoggerTemplate.h"
+#include "StructuredLog.h"
 
 #include <QCoreApplication>
 
@@ -7,8 +8,18 @@
 #include <QDir>
 #include <QMutex>
 #include <QFile>
+#include <QThread>
+#include <QRegExp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 #ifdef Q_OS_WIN
 #include <Windows.h>
 #else
@@ -19,21 +30,409 @@ namespace Logger
 {
 static QString gLogDir;//日志存储路径
 static int gLogMaxCount;//最大日志条数
+static LogFormat gLogFormat = HtmlFormat;//日志文件格式
 
 static void outputMessage(QtMsgType type, const QMessageLogContext &context, const QString &msg);
 static void outputMessageAsync(QtMsgType type, const QMessageLogContext& context, const QString& msg);
 
-void initLog(const QString &logPath, int logMaxCount, bool async)
+namespace
 {
-    if (async)
+// 每条日志定长存放，超长部分截断；每线程一个单生产者/单消费者环形缓冲
+constexpr int kRecordTextSize = 480;
+constexpr int kNameSize = 32;
+constexpr quint64 kThreadBufferCapacity = 256;
+constexpr int kWriterIntervalMs = 50;
+
+struct LogRecord
+{
+    quint64 sequence;
+    qint64 timestampMs;
+    int type;
+    int length;
+    char module[kNameSize];
+    char text[kRecordTextSize];
+};
+
+struct ThreadBuffer
+{
+    LogRecord records[kThreadBufferCapacity];
+    std::atomic<quint64> head{0};       // 写线程读取位置
+    std::atomic<quint64> tail{0};       // 日志线程写入位置
+    std::atomic<quint64> dropped{0};    // 缓冲满时丢弃的条数
+    std::atomic_bool retired{false};    // 所属线程已退出
+    char threadName[kNameSize];         // 注册时的线程名
+};
+
+// 当前线程名，未命名时使用线程ID
+QByteArray currentThreadName()
+{
+    QThread *thread = QThread::currentThread();
+    const QString name = thread ? thread->objectName() : QString();
+    if (!name.isEmpty()) {
+        return name.toUtf8();
+    }
+    return QByteArray::number(reinterpret_cast<quintptr>(QThread::currentThreadId()), 16);
+}
+
+// 生成日志文件名：HTML每小时一个文件，结构化日志每天一个文件
+QString logFileName(const QDateTime &dt)
+{
+    if (gLogFormat == StructuredFormat) {
+        return QString("%1/%2.log").arg(gLogDir).arg(dt.toString("yyyy-MM-dd"));
+    }
+    return QString("%1/%2_log.html").arg(gLogDir).arg(dt.toString("yyyy-MM-dd hh"));
+}
+
+// 新建日志文件的文件头
+QByteArray logFileHeader()
+{
+    if (gLogFormat == StructuredFormat) {
+        return QByteArray(structuredLogHeader);
+    }
+    return logTemplate.toUtf8() + "\r\n";
+}
+
+// UTF-16转UTF-8直接写入定长缓冲，不分配内存；截断时末尾加"..."
+int encodeUtf8(const QString &src, char *dst, int capacity)
+{
+    const ushort *data = src.utf16();
+    const int size = src.size();
+    const int limit = capacity - 3;
+    int out = 0;
+    for (int i = 0; i < size; ++i) {
+        uint code = data[i];
+        if (QChar::isHighSurrogate(code) && i + 1 < size && QChar::isLowSurrogate(data[i + 1])) {
+            code = QChar::surrogateToUcs4(static_cast<ushort>(code), data[++i]);
+        }
+        const int length = code < 0x80 ? 1 : code < 0x800 ? 2 : code < 0x10000 ? 3 : 4;
+        if (out + length > limit) {
+            dst[out++] = '.';
+            dst[out++] = '.';
+            dst[out++] = '.';
+            break;
+        }
+        switch (length) {
+        case 1:
+            dst[out++] = static_cast<char>(code);
+            break;
+        case 2:
+            dst[out++] = static_cast<char>(0xC0 | (code >> 6));
+            dst[out++] = static_cast<char>(0x80 | (code & 0x3F));
+            break;
+        case 3:
+            dst[out++] = static_cast<char>(0xE0 | (code >> 12));
+            dst[out++] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            dst[out++] = static_cast<char>(0x80 | (code & 0x3F));
+            break;
+        default:
+            dst[out++] = static_cast<char>(0xF0 | (code >> 18));
+            dst[out++] = static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            dst[out++] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            dst[out++] = static_cast<char>(0x80 | (code & 0x3F));
+            break;
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief 异步日志写线程
+ *
+ * 日志线程只把消息编码进本线程的环形缓冲（原子变量收发，不加锁、不分配），缓冲满时丢弃并计数；
+ * 后台写线程定期（或收到警告以上级别日志时立即）收集所有线程的缓冲，按全局序号排序后
+ * 批量格式化、一次写入文件并刷新。
+ */
+class AsyncLogWriter
+{
+public:
+    static AsyncLogWriter &instance()
     {
-        qInstallMessageHandler(outputMessageAsync);
+        static AsyncLogWriter writer;
+        return writer;
     }
-    else
+
+    void start()
     {
-        qInstallMessageHandler(outputMessage);
+        if (m_thread.joinable()) {
+            return;
+        }
+        m_stopping = false;
+        m_thread = std::thread([this]() { run(); });
+    }
+
+    void submit(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+    {
+        ThreadBuffer *buffer = threadBuffer();
+        const quint64 tail = buffer->tail.load(std::memory_order_relaxed);
+        const quint64 used = tail - buffer->head.load(std::memory_order_acquire);
+        if (used >= kThreadBufferCapacity) {
+            buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+            wake();
+            return;
+        }
+
+        LogRecord &record = buffer->records[tail % kThreadBufferCapacity];
+        record.sequence = m_sequence.fetch_add(1, std::memory_order_relaxed);
+        record.timestampMs = QDateTime::currentMSecsSinceEpoch();
+        record.type = static_cast<int>(type);
+        qstrncpy(record.module, context.category ? context.category : "", kNameSize);
+        record.length = encodeUtf8(msg, record.text, kRecordTextSize);
+        buffer->tail.store(tail + 1, std::memory_order_release);
+
+        // 警告以上级别或缓冲过半时立即唤醒写线程
+        if (type != QtDebugMsg && type != QtInfoMsg) {
+            wake();
+        } else if (used + 1 >= kThreadBufferCapacity / 2) {
+            wake();
+        }
+    }
+
+    // 在调用线程上收集并写入所有已提交的日志
+    void flush()
+    {
+        drain();
+    }
+
+    ~AsyncLogWriter()
+    {
+        // 静态析构期间的日志改走默认输出
+        qInstallMessageHandler(nullptr);
+        m_stopping = true;
+        wake();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+        drain();
+    }
+
+private:
+    AsyncLogWriter() = default;
+
+    struct BufferHolder
+    {
+        std::shared_ptr<ThreadBuffer> buffer;
+        ~BufferHolder()
+        {
+            if (buffer) {
+                buffer->retired = true;
+            }
+        }
+    };
+
+    ThreadBuffer *threadBuffer()
+    {
+        // 每个线程首次写日志时注册一次
+        thread_local BufferHolder holder;
+        if (!holder.buffer) {
+            holder.buffer = std::make_shared<ThreadBuffer>();
+            qstrncpy(holder.buffer->threadName, currentThreadName().constData(), kNameSize);
+            std::lock_guard<std::mutex> locker(m_registryMutex);
+            m_buffers.push_back(holder.buffer);
+        }
+        return holder.buffer.get();
+    }
+
+    void wake()
+    {
+        m_pending.store(true, std::memory_order_release);
+        m_wakeCondition.notify_one();
+    }
+
+    void run()
+    {
+        while (!m_stopping) {
+            {
+                std::unique_lock<std::mutex> locker(m_wakeMutex);
+                m_wakeCondition.wait_for(locker, std::chrono::milliseconds(kWriterIntervalMs), [this]() {
+                    return m_stopping.load() || m_pending.load(std::memory_order_acquire);
+                });
+            }
+            m_pending = false;
+            drain();
+        }
+    }
+
+    void drain()
+    {
+        std::lock_guard<std::mutex> drainLocker(m_drainMutex);
+
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        {
+            std::lock_guard<std::mutex> locker(m_registryMutex);
+            buffers = m_buffers;
+        }
+
+        // 收集各线程已提交的记录，按提交顺序合并
+        struct Pending
+        {
+            ThreadBuffer *buffer;
+            quint64 tail;
+        };
+        std::vector<Pending> pending;
+        m_batch.clear();
+        quint64 dropped = 0;
+        for (const auto &buffer : buffers) {
+            const quint64 head = buffer->head.load(std::memory_order_relaxed);
+            const quint64 tail = buffer->tail.load(std::memory_order_acquire);
+            for (quint64 i = head; i < tail; ++i) {
+                m_batch.push_back({&buffer->records[i % kThreadBufferCapacity], buffer->threadName});
+            }
+            pending.push_back({buffer.get(), tail});
+            dropped += buffer->dropped.exchange(0, std::memory_order_relaxed);
+        }
+
+        if (!m_batch.empty() || dropped > 0) {
+            std::sort(m_batch.begin(), m_batch.end(), [](const BatchItem &a, const BatchItem &b) {
+                return a.record->sequence < b.record->sequence;
+            });
+            writeBatch(dropped);
+        }
+
+        // 写完后才归还槽位
+        for (const Pending &item : pending) {
+            item.buffer->head.store(item.tail, std::memory_order_release);
+        }
+
+        // 移除已退出且已写完的线程缓冲
+        std::lock_guard<std::mutex> locker(m_registryMutex);
+        m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(),
+                                       [](const std::shared_ptr<ThreadBuffer> &buffer) {
+                                           return buffer->retired
+                                                  && buffer->head.load() == buffer->tail.load();
+                                       }),
+                        m_buffers.end());
+    }
+
+    void writeBatch(quint64 dropped)
+    {
+        static const char typeList[] = { 'd', 'w', 'c', 'f', 'i' };
+
+        m_html.clear();
+        m_console.clear();
+
+        auto append = [this](int type, qint64 timestampMs, const char *thread, const char *module,
+                             const char *text, int length) {
+            const QDateTime dt = QDateTime::fromMSecsSinceEpoch(timestampMs);
+            const QString fileName = logFileName(dt);
+            if (fileName != m_file.fileName()) {
+                writeFile();
+                openFile(fileName);
+            }
+
+            const QByteArray contentDt = dt.toString("yyyy-MM-dd hh:mm:ss.zzz").toLatin1();
+            QByteArray prefix;
+            prefix.append('[').append(contentDt).append("][").append(levelName(type)).append(']');
+            if (module[0] != '\0') {
+                prefix.append('[').append(module).append(']');
+            }
+            prefix.append(' ');
+
+            if (gLogFormat == StructuredFormat) {
+                appendStructuredLine(m_html, timestampMs, type, thread, module, text, length);
+            } else {
+                m_html.append("<div class=\"").append(typeList[type]).append("\">")
+                    .append(prefix).append(text, length).append("</div>\r\n");
+            }
+            m_console.append(prefix).append(text, length).append('\n');
+        };
+
+        if (dropped > 0) {
+            const QByteArray text = QByteArray("Log buffer full, ") + QByteArray::number(dropped)
+                                    + " messages dropped";
+            append(QtWarningMsg, QDateTime::currentMSecsSinceEpoch(), "logger", "",
+                   text.constData(), text.size());
+        }
+        for (const BatchItem &item : m_batch) {
+            append(item.record->type, item.record->timestampMs, item.thread, item.record->module,
+                   item.record->text, item.record->length);
+        }
+
+        writeFile();
+#ifdef Q_OS_WIN
+        ::OutputDebugStringW(reinterpret_cast<const wchar_t *>(QString::fromUtf8(m_console).utf16()));
+#else
+        fwrite(m_console.constData(), 1, static_cast<size_t>(m_console.size()), stderr);
+#endif
+        m_console.clear();
+    }
+
+    void openFile(const QString &fileName)
+    {
+        if (m_file.isOpen()) {
+            m_file.close();
+        }
+        m_file.setFileName(fileName);
+        const bool exist = m_file.exists();
+        m_file.open(QIODevice::WriteOnly | QIODevice::Append);
+        if (!exist) {
+            m_file.write(logFileHeader());
+        }
+    }
+
+    void writeFile()
+    {
+        if (m_html.isEmpty()) {
+            return;
+        }
+        if (m_file.isOpen()) {
+            m_file.write(m_html);
+            m_file.flush();
+        }
+        m_html.clear();
+    }
+
+private:
+    std::thread m_thread;
+    std::atomic_bool m_stopping{false};
+    std::atomic_bool m_pending{false};
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCondition;
+
+    std::atomic<quint64> m_sequence{0};
+    std::mutex m_registryMutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+
+    // 以下仅在持有m_drainMutex时访问
+    struct BatchItem
+    {
+        const LogRecord *record;
+        const char *thread;
+    };
+    std::mutex m_drainMutex;
+    std::vector<BatchItem> m_batch;
+    QByteArray m_html;
+    QByteArray m_console;
+    QFile m_file;
+};
+
+int levelFromName(const QString &name)
+{
+    static const char *names[] = { "debug", "info", "warn", "error", "off" };
+    for (int i = 0; i <= OffLevel; ++i) {
+        if (name.compare(QLatin1String(names[i]), Qt::CaseInsensitive) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int moduleFromName(const QString &name)
+{
+    static const char *names[] = { "general", "pull", "video", "audio", "player" };
+    for (int i = 0; i < ModuleCount; ++i) {
+        if (name.compare(QLatin1String(names[i]), Qt::CaseInsensitive) == 0) {
+            return i;
+        }
     }
+    return -1;
+}
+} // namespace
+
 
+void initLog(const QString &logPath, int logMaxCount, bool async, LogFormat format)
+{
+    // 先设置目录等全局参数再启动写线程、安装处理函数，写线程读取时已就绪
+    gLogFormat = format;
     gLogDir = logPath;
     gLogMaxCount = logMaxCount;
     QDir dir(gLogDir);
@@ -45,63 +444,77 @@ void initLog(const QString &logPath, int logMaxCount, bool async)
         dir.remove(infoList.first());
         infoList.removeFirst();
     }
+
+    if (async)
+    {
+        AsyncLogWriter::instance().start();
+        qInstallMessageHandler(outputMessageAsync);
+    }
+    else
+    {
+        qInstallMessageHandler(outputMessage);
+    }
+
+    const QString rules = qEnvironmentVariable("LOG_RULES");
+    if (!rules.isEmpty() && !setLogRules(rules)) {
+        LogWarn << "Invalid LOG_RULES:" << rules;
+    }
 }
-static void outputMessageAsync(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+
+void setLogLevel(Level level)
 {
-    static const QString messageTemp = QString("<div class=\"%1\">[%2][%3] %4</div>\r\n");
-    static const QString typeNames[] = { "DEBUG", "WARN", "ERROR", "FATAL", "INFO" };
-    static const char typeList[] = { 'd', 'w', 'c', 'f', 'i' };
-    static QMutex mutex;
-    static QFile file;
-    static QTextStream textStream;
-    static uint count = 0;
-    static const uint maxCount = 512;
-    Q_UNUSED(context);
-    QDateTime dt = QDateTime::currentDateTime();
-    //每小时一个文件
-    QString contentDt = dt.toString("yyyy-MM-dd hh");
-    QString message = QString("[%1][%2] %3")
-                          .arg(contentDt)
-                          .arg(typeNames[static_cast<int>(type)])
-                          .arg(msg);
-    QString htmlMessage = messageTemp
-                              .arg(typeList[static_cast<int>(type)])
-                              .arg(contentDt)
-                              .arg(typeNames[static_cast<int>(type)])
-                              .arg(msg);
-    QString newfileName = QString("%1/%2_log.html").arg(gLogDir).arg(contentDt);
-    mutex.lock();
-    if (file.fileName() != newfileName)
-    {
-        if (file.isOpen())
-        {
-            file.close();
+    for (auto &moduleLevel : gModuleLevels) {
+        moduleLevel.store(level, std::memory_order_relaxed);
+    }
+}
+
+void setModuleLogLevel(Module module, Level level)
+{
+    if (module >= 0 && module < ModuleCount) {
+        gModuleLevels[module].store(level, std::memory_order_relaxed);
+    }
+}
+
+bool setLogRules(const QString &rules)
+{
+    bool ok = true;
+    const QStringList items = rules.split(QRegExp("[,;]"), QString::SkipEmptyParts);
+    for (const QString &item : items) {
+        const QStringList pair = item.split('=');
+        const int level = pair.size() == 2 ? levelFromName(pair[1].trimmed()) : -1;
+        if (level < 0) {
+            ok = false;
+            continue;
         }
-        file.setFileName(newfileName);
-        bool exist = file.exists();
-        file.open(QIODevice::WriteOnly | QIODevice::Append);
-        textStream.setDevice(&file);
-        textStream.setCodec("UTF-8");
-        if (!exist)
-        {
-            textStream << logTemplate << "\r\n";
+
+        const QString moduleName = pair[0].trimmed();
+        if (moduleName == "*") {
+            setLogLevel(static_cast<Level>(level));
+            continue;
+        }
+        const int module = moduleFromName(moduleName);
+        if (module < 0) {
+            ok = false;
+            continue;
         }
+        setModuleLogLevel(static_cast<Module>(module), static_cast<Level>(level));
     }
-    textStream << htmlMessage;
-    textStream.flush();
-    count += static_cast<uint>(htmlMessage.length());
-    if (count >= maxCount)
-    {
-        file.close();
-        file.open(QIODevice::WriteOnly | QIODevice::Append);
+    return ok;
+}
+
+void flushLog()
+{
+    AsyncLogWriter::instance().flush();
+}
+static void outputMessageAsync(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+{
+    AsyncLogWriter &writer = AsyncLogWriter::instance();
+    writer.submit(type, context, msg);
+
+    // 程序即将中止，同步写出
+    if (type == QtFatalMsg) {
+        writer.flush();
     }
-    mutex.unlock();
-#ifdef Q_OS_WIN
-    ::OutputDebugString(message.toStdWString().data());
-    ::OutputDebugString(L"\r\n");
-#else
-    fprintf(stderr, message.toStdString().data());
-#endif
 }
 static void outputMessage(QtMsgType type, const QMessageLogContext& context, const QString& msg)
 {
@@ -109,9 +522,29 @@ static void outputMessage(QtMsgType type, const QMessageLogContext& context, con
     static const char typeList[] = { 'd', 'w', 'c', 'f', 'i' };
     static QMutex mutex;
 
-    Q_UNUSED(context);
     QDateTime dt = QDateTime::currentDateTime();
 
+    if (gLogFormat == StructuredFormat)
+    {
+        const QByteArray text = msg.toUtf8();
+        QByteArray line;
+        appendStructuredLine(line, dt.toMSecsSinceEpoch(), static_cast<int>(type),
+                             currentThreadName().constData(),
+                             context.category ? context.category : "",
+                             text.constData(), text.size());
+        QFile file(logFileName(dt));
+        QMutexLocker locker(&mutex);
+        const bool exist = file.exists();
+        file.open(QIODevice::WriteOnly | QIODevice::Append);
+        if (!exist)
+        {
+            file.write(logFileHeader());
+        }
+        file.write(line);
+        file.close();
+        return;
+    }
+
     //每小时一个文件
     QString fileNameDt = dt.toString("yyyy-MM-dd_hh");
 //    每分钟一个文件
@@ -1,13 +1,91 @@
 ﻿// Logger.h
 #pragma once
 #include <QDebug>
+#include <atomic>
+
+// 编译期最低日志级别（0调试 1信息 2警告 3错误 4关闭），低于该级别的日志语句不生成代码，
+// 在qmake中通过 DEFINES += LOG_MIN_LEVEL=n 设置
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+// 日志所属模块，源文件在包含任何头文件之前定义，如 #define LOG_MODULE Logger::PullModule
+#ifndef LOG_MODULE
+#define LOG_MODULE Logger::GeneralModule
+#endif
 
 namespace Logger
 {
-#define LogDebug qDebug() << "| "
-#define LogInfo qInfo() << "| "
-#define LogWarn qWarning() << "| "
-#define LogErr qCritical() << "| "
+// 日志级别，低于最低级别的日志在宏展开处直接跳过，不求值任何参数
+enum Level
+{
+    DebugLevel,
+    InfoLevel,
+    WarnLevel,
+    ErrorLevel,
+    OffLevel
+};
+
+// 日志模块，各自有独立的运行时最低级别
+enum Module
+{
+    GeneralModule,
+    PullModule,     // 拉流、包队列、会话与调度
+    VideoModule,    // 视频解码与转换
+    AudioModule,    // 音频解码
+    PlayerModule,   // 音视频输出、同步与显示
+    ModuleCount
+};
+
+inline std::atomic<int> gModuleLevels[ModuleCount]{};
+
+inline bool isLevelEnabled(Module module, Level level)
+{
+    return level >= gModuleLevels[module].load(std::memory_order_relaxed);
+}
+
+// 模块名，作为Qt日志分类（QMessageLogContext::category）随消息传给日志处理函数
+constexpr const char *moduleName(Module module)
+{
+    switch (module) {
+    case PullModule:   return "pull";
+    case VideoModule:  return "video";
+    case AudioModule:  return "audio";
+    case PlayerModule: return "player";
+    default:           return "general";
+    }
+}
+
+#define LOG_STATEMENT(level, method) \
+    if constexpr (LOG_MIN_LEVEL > (level)) {} \
+    else if (!Logger::isLevelEnabled(LOG_MODULE, level)) {} \
+    else QMessageLogger(nullptr, 0, nullptr, Logger::moduleName(LOG_MODULE)).method() << "| "
+
+#define LogDebug LOG_STATEMENT(Logger::DebugLevel, debug)
+#define LogInfo LOG_STATEMENT(Logger::InfoLevel, info)
+#define LogWarn LOG_STATEMENT(Logger::WarnLevel, warning)
+#define LogErr LOG_STATEMENT(Logger::ErrorLevel, critical)
+
+// 日志文件格式
+enum LogFormat
+{
+    HtmlFormat,         // 每小时一个HTML文件（LoggerTemplate.h）
+    StructuredFormat    // 每天一个结构化文本文件，每行一条，格式见StructuredLog.h
+};
+
+// 初始化日志输出；环境变量 LOG_RULES 可覆盖各模块级别（格式见setLogRules）
+void initLog(const QString &logPath = QStringLiteral("Log"), int logMaxCount = 1024, bool async = true,
+             LogFormat format = HtmlFormat);
+
+// 运行时设置所有模块的最低日志级别
+void setLogLevel(Level level);
+
+// 运行时设置单个模块的最低日志级别
+void setModuleLogLevel(Module module, Level level);
+
+// 按规则设置级别，如 "*=warn,pull=debug,audio=off"，模块名为 general/pull/video/audio/player
+bool setLogRules(const QString &rules);
 
-void initLog(const QString &logPath = QStringLiteral("Log"), int logMaxCount = 1024, bool async = true);
+// 等待已提交的异步日志全部写入文件
+void flushLog();
 } // namespace Logger
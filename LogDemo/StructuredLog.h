@@ -0,0 +1,102 @@
+﻿#pragma once
+#include <QByteArray>
+#include <QList>
+
+namespace Logger
+{
+/*
+ * 结构化日志：UTF-8文本，每行一条，字段以制表符分隔
+ *   时间戳(自1970年的毫秒数)  级别  线程  模块  消息
+ * 字段内的反斜杠、制表符、换行与回车分别转义为 \\、\t、\n、\r；以'#'开头的行为文件头或注释。
+ */
+static const char structuredLogHeader[] = "#PullStreamDemo structured log v1\n";
+
+struct StructuredLogEntry
+{
+    qint64 timestampMs = 0;
+    QByteArray level;
+    QByteArray thread;
+    QByteArray module;
+    QByteArray message;
+};
+
+// 按QtMsgType取级别名
+inline const char *levelName(int type)
+{
+    static const char *names[] = { "DEBUG", "WARN", "ERROR", "FATAL", "INFO" };
+    return (type >= 0 && type < 5) ? names[type] : "DEBUG";
+}
+
+inline void appendEscaped(QByteArray &out, const char *text, int length)
+{
+    for (int i = 0; i < length; ++i) {
+        const char c = text[i];
+        switch (c) {
+        case '\\': out.append("\\\\"); break;
+        case '\t': out.append("\\t"); break;
+        case '\n': out.append("\\n"); break;
+        case '\r': out.append("\\r"); break;
+        default: out.append(c); break;
+        }
+    }
+}
+
+inline QByteArray unescapeField(const QByteArray &field)
+{
+    QByteArray out;
+    out.reserve(field.size());
+    for (int i = 0; i < field.size(); ++i) {
+        const char c = field[i];
+        if (c != '\\' || i + 1 >= field.size()) {
+            out.append(c);
+            continue;
+        }
+        const char next = field[++i];
+        switch (next) {
+        case 't': out.append('\t'); break;
+        case 'n': out.append('\n'); break;
+        case 'r': out.append('\r'); break;
+        default: out.append(next); break;
+        }
+    }
+    return out;
+}
+
+// 追加一条结构化日志行
+inline void appendStructuredLine(QByteArray &out, qint64 timestampMs, int type, const char *thread,
+                                 const char *module, const char *text, int length)
+{
+    out.append(QByteArray::number(timestampMs)).append('\t')
+        .append(levelName(type)).append('\t');
+    appendEscaped(out, thread, static_cast<int>(qstrlen(thread)));
+    out.append('\t');
+    appendEscaped(out, module, static_cast<int>(qstrlen(module)));
+    out.append('\t');
+    appendEscaped(out, text, length);
+    out.append('\n');
+}
+
+// 解析一行，注释行与格式错误的行返回false
+inline bool parseStructuredLine(const QByteArray &line, StructuredLogEntry *entry)
+{
+    if (line.isEmpty() || line.startsWith('#')) {
+        return false;
+    }
+
+    const QList<QByteArray> fields = line.split('\t');
+    if (fields.size() != 5) {
+        return false;
+    }
+
+    bool ok = false;
+    entry->timestampMs = fields[0].toLongLong(&ok);
+    if (!ok) {
+        return false;
+    }
+    entry->level = fields[1];
+    entry->thread = unescapeField(fields[2]);
+    entry->module = unescapeField(fields[3]);
+    entry->message = unescapeField(fields[4]);
+    return true;
+}
+} // namespace Logger
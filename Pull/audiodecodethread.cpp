@@ -1,6 +1,10 @@
-﻿#include "audiodecodethread.h"
+﻿#define LOG_MODULE Logger::AudioModule
+#include "audiodecodethread.h"
+#include "audioplayer.h"
+#include "pipelinemetrics.h"
 #include <Logger.h>
 #include <QElapsedTimer>
+#include <cstring>
 
 AudioDecodeThread::AudioDecodeThread(QObject *parent)
     : QThread{parent}
@@ -13,7 +17,29 @@ AudioDecodeThread::~AudioDecodeThread()
     close();
 }
 
-bool AudioDecodeThread::init(AVCodecParameters *codecParams)
+bool AudioDecodeThread::init(const AVCodecParameters *codecParams, AVRational timeBase)
+{
+    if (!openCodec(codecParams, timeBase)) {
+        return false;
+    }
+
+    // 创建包和帧
+    m_packet = av_packet_alloc();
+    m_frame = av_frame_alloc();
+    if (!m_packet || !m_frame) {
+        emit errorOccurred("Failed to allocate frame");
+        return false;
+    }
+
+    // 初始化重采样器
+    if (!initResampler()) {
+        return false;
+    }
+
+    return true;
+}
+
+bool AudioDecodeThread::openCodec(const AVCodecParameters *codecParams, AVRational timeBase)
 {
     if (!codecParams) {
         emit errorOccurred("Invalid codec parameters");
@@ -43,6 +69,10 @@ bool AudioDecodeThread::init(AVCodecParameters *codecParams)
         return false;
     }
 
+    // 帧时间戳沿用数据包的流时间基
+    m_timeBase = timeBase;
+    m_codecContext->pkt_timebase = timeBase;
+
     // 设置低延迟选项
     m_codecContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
     m_codecContext->flags2 |= AV_CODEC_FLAG2_FAST;
@@ -56,18 +86,6 @@ bool AudioDecodeThread::init(AVCodecParameters *codecParams)
         return false;
     }
 
-    // 创建帧
-    m_frame = av_frame_alloc();
-    if (!m_frame) {
-        emit errorOccurred("Failed to allocate frame");
-        return false;
-    }
-
-    // 初始化重采样器
-    if (!initResampler()) {
-        return false;
-    }
-
     LogInfo << "Audio decoder initialized: "
             << "Codec: " << m_codec->name
             << " Channels: " << m_codecContext->channels
@@ -93,13 +111,28 @@ void AudioDecodeThread::setTargetFormat(int sampleRate, int channels, AVSampleFo
     }
 }
 
-void AudioDecodeThread::close() {
-    if (!m_running) return;
+void AudioDecodeThread::setTargetLatency(int targetLatencyMs) {
+    m_targetLatencyMs = qMax(0, targetLatencyMs);
+}
+
+void AudioDecodeThread::setMetrics(PipelineMetrics *metrics) {
+    m_metrics = metrics;
+}
 
+void AudioDecodeThread::setAudioOutput(AudioPlayer *player) {
+    m_audioOutput = player;
+}
+
+void AudioDecodeThread::close() {
+    // 未启动（init后启动前失败）时也要释放解码器资源，cleanup可重复调用
     m_running = false;
 
     // 唤醒等待的线程
-    m_queueCondition.wakeAll();
+    m_packetRing.wakeAll();
+    {
+        QMutexLocker locker(&m_pauseMutex);
+        m_pauseCondition.wakeAll();
+    }
 
     // 等待线程结束
     if (isRunning()) {
@@ -113,109 +146,130 @@ void AudioDecodeThread::close() {
     cleanup();
 }
 
-void AudioDecodeThread::onAudioPacketReceived(AVPacket *packet) {
-    if (!m_running || !packet) {
-        LogErr << "音频包数据为空";
-        return;
-    }
-
-    QMutexLocker locker(&m_queueMutex);
-
-    // 空包表示流结束
-    if (packet->size == 0 && packet->data == nullptr) {
-        m_flushing = true;
-        // 不释放，直接加入队列
-    }
-
-    // 检查队列大小，防止内存溢出
-    if (m_packetQueue.size() >= m_maxQueueSize) {
-        LogWarn << "Audio packet queue overflow, dropping oldest packets";
-
-        // 丢弃旧的数据包
-        while (m_packetQueue.size() >= m_maxQueueSize / 2) {
-            AVPacket *oldPacket = m_packetQueue.dequeue();
-            av_packet_free(&oldPacket);
-        }
-
-        m_dropFrames = true;  // 设置丢帧标志
-    }
-    LogInfo << "音频包数据添加到队列";
-    // 添加到队列
-    m_packetQueue.enqueue(packet);
-    m_queueCondition.wakeOne();
-}
-
 void AudioDecodeThread::setPaused(bool paused) {
     m_paused = paused;
 
     if (!paused) {
-        QMutexLocker locker(&m_queueMutex);
-        m_queueCondition.wakeAll();
+        QMutexLocker locker(&m_pauseMutex);
+        m_pauseCondition.wakeAll();
     }
 }
 
-void AudioDecodeThread::run() {
+void AudioDecodeThread::startExternal() {
+    prepareDecoding();
+}
+
+void AudioDecodeThread::prepareDecoding() {
     m_running = true;
     m_flushing = false;
     m_paused = false;
-    m_dropFrames = false;
+    m_maxOutputBytes = 0;
+}
+
+void AudioDecodeThread::run() {
+    prepareDecoding();
 
     while (m_running) {
         // 处理暂停状态
         if (m_paused) {
-            QMutexLocker locker(&m_queueMutex);
-            m_queueCondition.wait(&m_queueMutex, 100);
+            QMutexLocker locker(&m_pauseMutex);
+            m_pauseCondition.wait(&m_pauseMutex, 100);
             continue;
         }
 
-        AVPacket *packet = nullptr;
+        StepResult result = step();
+        if (result.status == StepResult::Finished) {
+            break;
+        }
+        if (result.status == StepResult::Idle) {
+            // 队列为空时阻塞等待
+            m_packetRing.waitForData(100);
+        } else if (result.status == StepResult::Wait) {
+            QThread::msleep(static_cast<unsigned long>(result.waitMs));
+        }
+    }
 
-        // 从队列获取数据包
-        {
-            QMutexLocker locker(&m_queueMutex);
+    LogInfo << "Audio decoding thread stopped";
+}
 
-            if (m_packetQueue.isEmpty()) {
-                if (m_flushing) {
-                    // 没有更多数据包且处于刷新状态，退出循环
-                    break;
-                }
-                // 等待新数据包
-                m_queueCondition.wait(&m_queueMutex, 100);
-                continue;
-            }
+StepResult AudioDecodeThread::step() {
+    if (!m_running || !m_packet) {
+        return StepResult::finished();
+    }
 
-            packet = m_packetQueue.dequeue();
-        }
+    // 暂停期间定时轮询，不占用工作线程
+    if (m_paused) {
+        return StepResult::wait(20);
+    }
 
-        // 处理数据包
-        if (packet) {
+    // 播放缓冲放不下下一帧时先不出队，包留在队列中，本地输入的背压由此传到拉流线程；
+    // 丢帧只在缓冲大小不足一帧等异常情况下发生
+    if (outputFull()) {
+        return StepResult::wait(10);
+    }
 
-            // 如果设置了丢帧标志，跳过非关键帧
-            if (m_dropFrames  && packet->data != nullptr) {
-                av_packet_free(&packet);
-                LogWarn << "丢帧";
-                continue;
-            }
+    int64_t arrivalUs = 0;
+    if (!m_packetRing.pop(m_packet, 0, &arrivalUs)) {
+        return StepResult::idle();
+    }
 
-            if (decodePacket(packet)) {
-                // 如果队列大小恢复正常，清除丢帧标志
-                if (m_dropFrames && m_packetQueue.size() < m_maxQueueSize / 4) {
-                    m_dropFrames = false;
-                    LogInfo << "Audio queue recovered, resuming normal processing";
-                }
-            }
-            av_packet_free(&packet);
+    // 音频包可独立解码，超过目标延迟时一次丢弃到与最新包相差不超过目标延迟的位置
+    const int targetLatencyMs = m_targetLatencyMs.load();
+    if (targetLatencyMs > 0 && m_timeBase.num > 0) {
+        const int64_t maxDelay = av_rescale_q(targetLatencyMs, AVRational{1, 1000}, m_timeBase);
+        const int skipped = m_packetRing.skipToLatest(m_packet, maxDelay, &arrivalUs);
+        if (skipped > 0) {
+            LogDebug << "Audio latency above " << targetLatencyMs << "ms, skipped " << skipped << " packets";
         }
+    }
+
+    if (m_metrics && arrivalUs > 0) {
+        m_metrics->record(PipelineMetrics::AudioQueueWait, av_gettime_relative() - arrivalUs);
+    }
 
+    // 重连后的不连续标记
+    if (PacketRing::isDiscontinuity(m_packet)) {
+        handleDiscontinuity();
+        return StepResult::progress();
     }
 
-    // 刷新解码器
-    decodePacket(nullptr);
+    // 空包表示流结束，刷新解码器并发送结束信号
+    if (PacketRing::isEndOfStream(m_packet)) {
+        m_flushing = true;
+        decodePacket(nullptr);
+        emit audioFrameDecoded(nullptr);
+        LogInfo << "Audio stream reached end";
+        return StepResult::finished();
+    }
 
-    // 发送结束信号
-    emit audioFrameDecoded(nullptr);
+    decodePacket(m_packet);
+    av_packet_unref(m_packet);
+    return StepResult::progress();
+}
 
-    LogInfo << "Audio decoding thread stopped";
+void AudioDecodeThread::handleDiscontinuity()
+{
+    AVRational timeBase{0, 1};
+    AVCodecParameters *params = m_packetRing.takeCodecParameters(&timeBase);
+    if (!params) {
+        // 编解码参数未变，复用解码器
+        avcodec_flush_buffers(m_codecContext);
+        m_timeBase = timeBase;
+        m_codecContext->pkt_timebase = timeBase;
+        LogInfo << "Audio stream resumed, decoder reused";
+        return;
+    }
+
+    // 参数变化，重新打开解码器；输出格式保持不变，由重采样器适配新的输入
+    if (m_codecContext) {
+        avcodec_free_context(&m_codecContext);
+        m_codecContext = nullptr;
+    }
+    if (!openCodec(params, timeBase) || !initResampler()) {
+        LogErr << "Failed to reopen audio decoder after reconnect";
+        m_running = false;
+    }
+    avcodec_parameters_free(&params);
 }
 
 bool AudioDecodeThread::initResampler()
@@ -277,7 +331,11 @@ bool AudioDecodeThread::initResampler()
 
 bool AudioDecodeThread::decodePacket(AVPacket *packet) {
     // 发送包到解码器
-    int ret = avcodec_send_packet(m_codecContext, packet);
+    int ret;
+    {
+        MetricTimer timer(m_metrics, PipelineMetrics::AudioSendPacket);
+        ret = avcodec_send_packet(m_codecContext, packet);
+    }
     if (ret < 0) {
         // 忽略EOF和EAGAIN错误
         if (ret != AVERROR_EOF && ret != AVERROR(EAGAIN)) {
@@ -290,9 +348,10 @@ bool AudioDecodeThread::decodePacket(AVPacket *packet) {
 
     // 接收解码帧
     while (ret >= 0) {
+        const int64_t receiveStartUs = m_metrics ? av_gettime_relative() : 0;
         ret = avcodec_receive_frame(m_codecContext, m_frame);
         if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-            LogWarn << "监测到结束符,ret"<< ret;
+            LogDebug << "监测到结束符,ret"<< ret;
             return true;
         }
         if (ret < 0) {
@@ -301,21 +360,17 @@ bool AudioDecodeThread::decodePacket(AVPacket *packet) {
             LogWarn << "Error receiving frame from decoder: " << error;
             return false;
         }
-
-        // 更新音频时钟
-        if (m_frame->pts != AV_NOPTS_VALUE) {
-            // 转换时间戳为毫秒
-            qint64 pts = av_rescale_q(m_frame->pts,
-                                      m_codecContext->time_base,
-                                      {1, 1000});
-            emit audioClockUpdated(pts);
+        if (m_metrics) {
+            m_metrics->record(PipelineMetrics::AudioReceiveFrame, av_gettime_relative() - receiveStartUs);
+            m_metrics->addAudioFrameDecoded();
         }
 
-        // 重采样音频帧
-        auto resampledFrame = resampleFrame(m_frame);
-        if (resampledFrame) {
+        // 重采样音频帧：有音频输出时直接写入其缓冲，否则按帧发出
+        if (m_audioOutput) {
+            writeToOutput(m_frame);
+        } else if (auto resampledFrame = resampleFrame(m_frame)) {
             // 发送重采样后的帧
-            LogWarn << "发送重采样后的帧";
+            LogDebug << "发送重采样后的帧";
             emit audioFrameDecoded(resampledFrame);
         }
 
@@ -352,10 +407,27 @@ std::shared_ptr<AVFrame> AudioDecodeThread::resampleFrame(AVFrame *frame) {
         return nullptr;
     }
 
-    // 创建输出帧
+    // 输出缓冲取自池，最后一个引用释放时归还；帧长变大时按新大小重建池
+    const int bufferSize = av_samples_get_buffer_size(nullptr, m_targetChannels, outSamples, m_targetFormat, 0);
+    if (bufferSize <= 0) {
+        LogWarn << "Invalid output buffer size: " << bufferSize;
+        return nullptr;
+    }
+    if (!m_outputPool || bufferSize > m_outputPoolSize) {
+        av_buffer_pool_uninit(&m_outputPool);
+        m_outputPoolSize = bufferSize;
+        m_outputPool = av_buffer_pool_init(m_outputPoolSize, av_buffer_alloc);
+    }
+    AVBufferRef *buffer = m_outputPool ? av_buffer_pool_get(m_outputPool) : nullptr;
+    if (!buffer) {
+        LogWarn << "Failed to allocate output buffer";
+        return nullptr;
+    }
+
     AVFrame *outFrame = av_frame_alloc();
     if (!outFrame) {
         LogWarn << "Failed to allocate output frame";
+        av_buffer_unref(&buffer);
         return nullptr;
     }
 
@@ -365,21 +437,22 @@ std::shared_ptr<AVFrame> AudioDecodeThread::resampleFrame(AVFrame *frame) {
     outFrame->channel_layout = av_get_default_channel_layout(m_targetChannels);
     outFrame->format = m_targetFormat;
     outFrame->nb_samples = outSamples;
-
-    // 分配缓冲区
-    int ret = av_frame_get_buffer(outFrame, 0);
+    outFrame->buf[0] = buffer;
+    int ret = av_samples_fill_arrays(outFrame->data, outFrame->linesize, buffer->data,
+                                     m_targetChannels, outSamples, m_targetFormat, 0);
     if (ret < 0) {
-        char error[AV_ERROR_MAX_STRING_SIZE] = {0};
-        av_strerror(ret, error, sizeof(error));
-        LogWarn << "Failed to allocate output buffer: " << error;
         av_frame_free(&outFrame);
         return nullptr;
     }
+    outFrame->extended_data = outFrame->data;
 
     // 执行重采样
-    ret = swr_convert(m_swrContext,
-                      outFrame->data, outSamples,
-                      (const uint8_t**)frame->data, frame->nb_samples);
+    {
+        MetricTimer timer(m_metrics, PipelineMetrics::AudioResample);
+        ret = swr_convert(m_swrContext,
+                          outFrame->data, outSamples,
+                          (const uint8_t**)frame->data, frame->nb_samples);
+    }
     if (ret < 0) {
         char error[AV_ERROR_MAX_STRING_SIZE] = {0};
         av_strerror(ret, error, sizeof(error));
@@ -396,17 +469,87 @@ std::shared_ptr<AVFrame> AudioDecodeThread::resampleFrame(AVFrame *frame) {
     });
 }
 
+bool AudioDecodeThread::writeToOutput(AVFrame *frame)
+{
+    const int bytesPerSample = m_targetChannels * av_get_bytes_per_sample(m_targetFormat);
+    const int maxSamples = m_swrContext ? swr_get_out_samples(m_swrContext, frame->nb_samples)
+                                        : frame->nb_samples;
+    if (bytesPerSample <= 0 || maxSamples <= 0) {
+        LogWarn << "Invalid output sample count: " << maxSamples;
+        return false;
+    }
+
+    m_maxOutputBytes = qMax(m_maxOutputBytes, maxSamples * bytesPerSample);
+
+    AudioPlayer::WriteRegion region;
+    if (!m_audioOutput->beginWrite(maxSamples * bytesPerSample, &region)) {
+        LogWarn << "Audio buffer overflow, dropping frame";
+        return false;
+    }
+
+    int written = 0;
+    if (!m_swrContext) {
+        // 格式一致（交错格式，只有一个平面），直接拷入环形缓冲
+        const char *data = reinterpret_cast<const char*>(frame->data[0]);
+        const int bytes = frame->nb_samples * bytesPerSample;
+        const int head = qMin(bytes, region.size[0]);
+        memcpy(region.data[0], data, head);
+        if (bytes > head) {
+            memcpy(region.data[1], data + head, bytes - head);
+        }
+        written = bytes;
+    } else {
+        // 重采样器直接输出到环形缓冲；回绕时第二次调用只取出重采样器内已缓存的样本
+        MetricTimer timer(m_metrics, PipelineMetrics::AudioResample);
+        const uint8_t **input = const_cast<const uint8_t**>(frame->extended_data);
+        int inputSamples = frame->nb_samples;
+        for (int i = 0; i < 2 && region.size[i] > 0; ++i) {
+            uint8_t *output = reinterpret_cast<uint8_t*>(region.data[i]);
+            const int capacity = region.size[i] / bytesPerSample;
+            const int ret = swr_convert(m_swrContext, &output, capacity, input, inputSamples);
+            if (ret < 0) {
+                char error[AV_ERROR_MAX_STRING_SIZE] = {0};
+                av_strerror(ret, error, sizeof(error));
+                LogWarn << "Failed to resample audio: " << error;
+                break;
+            }
+            written += ret * bytesPerSample;
+            inputSamples = 0;
+            if (ret < capacity) {
+                break;
+            }
+        }
+    }
+
+    const qint64 ptsUs = (frame->pts != AV_NOPTS_VALUE && m_timeBase.num > 0)
+                             ? av_rescale_q(frame->pts, m_timeBase, AVRational{1, 1000000})
+                             : AV_NOPTS_VALUE;
+    m_audioOutput->commitWrite(written, ptsUs);
+    return written > 0;
+}
+
+bool AudioDecodeThread::outputFull() const
+{
+    if (!m_audioOutput || m_maxOutputBytes <= 0) {
+        return false;
+    }
+    // 一个包可能解出多帧，按最大单帧估计；缓冲整体小于一帧时不等待，走丢帧路径
+    const qint64 freeBytes = m_audioOutput->freeSpace();
+    return freeBytes >= 0 && freeBytes < m_maxOutputBytes
+           && m_audioOutput->bufferCapacity() >= m_maxOutputBytes;
+}
+
 void AudioDecodeThread::cleanup() {
+    const bool hadResources = m_packet || m_frame || m_codecContext;
+
     // 清空包队列
-    {
-        QMutexLocker locker(&m_queueMutex);
-        while (!m_packetQueue.isEmpty()) {
-            AVPacket *packet = m_packetQueue.dequeue();
-            av_packet_free(&packet);
-        }
+    m_packetRing.clear();
+
+    // 释放包和帧
+    if (m_packet) {
+        av_packet_free(&m_packet);
     }
 
-    // 释放帧
     if (m_frame) {
         av_frame_free(&m_frame);
         m_frame = nullptr;
@@ -424,11 +567,16 @@ void AudioDecodeThread::cleanup() {
         m_swrContext = nullptr;
     }
 
+    // 已发出的帧仍持有缓冲时，池在最后一个缓冲归还后销毁
+    av_buffer_pool_uninit(&m_outputPool);
+    m_outputPoolSize = 0;
+
     // 重置状态
     m_running = false;
     m_paused = false;
     m_flushing = false;
-    m_dropFrames = false;
 
-    LogInfo << "Audio decoder resources cleaned up";
+    if (hadResources) {
+        LogInfo << "Audio decoder resources cleaned up";
+    }
 }
@@ -3,12 +3,14 @@
 
 #include <QThread>
 #include <QMutex>
-#include <QQueue>
 #include <QAtomicInteger>
 #include <memory>
 #include "DataStruct.h"
+#include "packetring.h"
 #include <QWaitCondition>
 
+class PipelineMetrics;
+class AudioPlayer;
 
 class AudioDecodeThread : public QThread
 {
@@ -17,10 +19,21 @@ public:
     explicit AudioDecodeThread(QObject *parent = nullptr);
     ~AudioDecodeThread();
 
-    bool init(AVCodecParameters *codecParams);
+    // timeBase为流时间基，用于将帧时间戳换算为毫秒
+    bool init(const AVCodecParameters *codecParams, AVRational timeBase);
     // 设置目标音频参数
     void setTargetFormat(int sampleRate, int channels, AVSampleFormat format);
 
+    // 目标延迟：包队列排队超过该时长时丢弃旧包，0表示不限制
+    void setTargetLatency(int targetLatencyMs);
+
+    // 设置流水线统计（需在启动前设置），为空时不统计
+    void setMetrics(PipelineMetrics *metrics);
+
+    // 设置音频输出（需在启动前设置）：设置后重采样结果直接写入播放器的环形缓冲，
+    // 不再发出audioFrameDecoded；为空时按帧发出
+    void setAudioOutput(AudioPlayer *player);
+
     // 关闭解码器
     void close();
 
@@ -29,17 +42,21 @@ public:
     int channels() const { return m_targetChannels; }
     AVSampleFormat sampleFormat() const { return m_targetFormat; }
 
+    // 包队列，由拉流线程直接写入
+    PacketRing *packetRing() { return &m_packetRing; }
+
+    // 以外部调度方式启动（线程池模式），不创建线程，由调度器驱动step
+    void startExternal();
+
+    // 执行一步：解码一个数据包
+    StepResult step();
+
 signals:
     void audioFrameDecoded(std::shared_ptr<AVFrame> frame);
 
-    // 音频时钟更新
-    void audioClockUpdated(qint64 pts);
-
     void errorOccurred(const QString &error);
 
 public slots:
-    void onAudioPacketReceived(AVPacket *packet);
-
     // 更新播放状态
     void setPaused(bool paused);
 
@@ -47,15 +64,30 @@ protected:
     void run() override;
 
 private:
+    // 重置运行状态
+    void prepareDecoding();
+
+    // 创建并打开解码器
+    bool openCodec(const AVCodecParameters *codecParams, AVRational timeBase);
+
+    // 处理重连后的不连续标记：参数不变时刷新解码器，否则重新打开
+    void handleDiscontinuity();
+
     // 初始化重采样器
     bool initResampler();
 
     // 解码音频包
     bool decodePacket(AVPacket *packet);
 
-    // 重采样音频帧
+    // 重采样音频帧，输出缓冲取自m_outputPool
     std::shared_ptr<AVFrame> resampleFrame(AVFrame *frame);
 
+    // 重采样并直接写入音频输出的环形缓冲，空间不足时丢弃该帧
+    bool writeToOutput(AVFrame *frame);
+
+    // 音频输出的环形缓冲放不下下一帧（背压），此时暂不解码
+    bool outputFull() const;
+
     // 清理资源
     void cleanup();
 
@@ -64,17 +96,25 @@ private:
     AVCodecContext *m_codecContext = nullptr;
     SwrContext *m_swrContext = nullptr;
     const AVCodec *m_codec = nullptr;
+    AVRational m_timeBase{0, 1};
+    PipelineMetrics *m_metrics = nullptr;
+    AudioPlayer *m_audioOutput = nullptr;
+    int m_maxOutputBytes = 0;           // 写入输出的最大单帧字节数，背压判断用（解码线程访问）
+
+    // 按帧发出时的输出缓冲池，容量不足时按新的大小重建
+    AVBufferPool *m_outputPool = nullptr;
+    int m_outputPoolSize = 0;
 
     // 帧处理
+    AVPacket *m_packet = nullptr;
     AVFrame *m_frame = nullptr;
 
-    // 包队列
-    QQueue<AVPacket*> m_packetQueue;
-    QMutex m_queueMutex;
-    QWaitCondition m_queueCondition;
+    // 包队列，满时由拉流线程丢弃新包
+    PacketRing m_packetRing{128};
 
-    int m_maxQueueSize = 100;
-    bool m_dropFrames = false;
+    // 暂停等待
+    QMutex m_pauseMutex;
+    QWaitCondition m_pauseCondition;
 
     // 音频参数
     int m_targetSampleRate = 44100;
@@ -85,6 +125,7 @@ private:
     std::atomic_bool m_running{false};
     std::atomic_bool m_paused{false};
     std::atomic_bool m_flushing{false};
+    std::atomic<int> m_targetLatencyMs{0};
 };
 
 #endif // AUDIODECODETHREAD_H
@@ -1,14 +1,35 @@
-﻿#include "audioplayer.h"
+﻿#define LOG_MODULE Logger::PlayerModule
+#include "audioplayer.h"
+#include "audioringbuffer.h"
+#include "pipelinemetrics.h"
 #include <QAudioDeviceInfo>
 #include <QCoreApplication>
+#include <cstring>
 #include "Logger.h"
 
+namespace {
+
+// 测量值与插值预测之差小于该值时按比例收敛，超过则直接跳到测量值
+const qint64 kClockSnapUs = 40000;
+const int kClockSlewDivisor = 8;
+
+// 新帧PTS与推算的队尾PTS相差超过该值时视为不连续，添加锚点
+const qint64 kAnchorToleranceUs = 2000;
+
+} // namespace
+
 
 AudioPlayer::AudioPlayer(QObject *parent)
     : QObject(parent)
+    , m_ringBuffer(new AudioRingBuffer(this))
+    , m_nullTimer(new QTimer(this))
 {
     // 初始化时钟计时器
     m_clockTimer.start();
+
+    m_nullTimer->setTimerType(Qt::PreciseTimer);
+    m_nullTimer->setInterval(10);
+    connect(m_nullTimer, &QTimer::timeout, this, &AudioPlayer::onNullDeviceTick);
 }
 
 AudioPlayer::~AudioPlayer()
@@ -35,6 +56,17 @@ bool AudioPlayer::initialize(int sampleRate, int channels, int sampleSize)
     // 设置音频格式
     setupAudioFormat();
 
+    // 空设备不打开声卡，按请求的格式消费
+    if (m_deviceMode != DefaultDevice) {
+        allocateRingBuffer(0);
+        LogInfo << "Audio player initialized with null device ("
+                << (m_deviceMode == NullRealtime ? "realtime" : "max speed") << "): "
+                << m_sampleRate << "Hz, " << m_channels << "ch, "
+                << "Ring size: " << m_ringBuffer->capacity();
+        m_initialized = true;
+        return true;
+    }
+
     // 检查设备支持
     QAudioDeviceInfo deviceInfo = QAudioDeviceInfo::defaultOutputDevice();
     if (!deviceInfo.isFormatSupported(m_audioFormat)) {
@@ -80,16 +112,38 @@ bool AudioPlayer::initialize(int sampleRate, int channels, int sampleSize)
 
     m_audioOutput->setBufferSize(bufferSize);
 
+    // 环形缓冲一次性分配，至少容纳两个设备缓冲
+    allocateRingBuffer(m_audioOutput->bufferSize() * 2);
+
     LogInfo << "Audio player initialized: "
             << "Sample rate: " << m_audioFormat.sampleRate()
             << " Channels: " << m_audioFormat.channelCount()
             << " Sample size: " << m_audioFormat.sampleSize()
-            << " Buffer size: " << m_audioOutput->bufferSize();
+            << " Buffer size: " << m_audioOutput->bufferSize()
+            << " Ring size: " << m_ringBuffer->capacity();
 
     m_initialized = true;
     return true;
 }
 
+void AudioPlayer::allocateRingBuffer(qint64 minBytes)
+{
+    const int sampleBytes = bytesPerSample();
+    qint64 ringSize = static_cast<qint64>(m_sampleRate) * sampleBytes * m_maxBufferMs / 1000;
+    ringSize = qMax(ringSize, minBytes);
+    ringSize -= ringSize % qMax(1, sampleBytes);
+    m_ringBuffer->allocate(ringSize);
+}
+
+void AudioPlayer::setDeviceMode(DeviceMode mode)
+{
+    if (m_initialized && mode != m_deviceMode) {
+        LogWarn << "Audio device mode must be set before initialize";
+        return;
+    }
+    m_deviceMode = mode;
+}
+
 void AudioPlayer::setupAudioFormat()
 {
     m_audioFormat.setSampleRate(m_sampleRate);
@@ -126,9 +180,38 @@ void AudioPlayer::start() {
         return;
     }
 
-    // 启动音频设备
-    m_audioDevice = m_audioOutput->start();
-    if (!m_audioDevice) {
+    // 空设备：实时模式由定时器按采样率消费，极速模式在写入时消费
+    if (m_deviceMode != DefaultDevice) {
+        {
+            QMutexLocker clockLocker(&m_clockMutex);
+            m_clockUs = AV_NOPTS_VALUE;
+            m_clockRunning = false;
+        }
+        m_nullRunUs = 0;
+        m_nullDeviceBytes = 0;
+        m_nullConsuming = false;
+        m_nullClock.start();
+        m_nullLastUs = 0;
+        if (m_deviceMode == NullRealtime) {
+            m_nullTimer->start();
+        }
+        m_playing = true;
+        m_paused = false;
+        LogInfo << "Null audio device started";
+        return;
+    }
+
+    // 拉模式启动：设备按自己的回调节奏从环形缓冲读取
+    if (!m_ringBuffer->isOpen()
+            && !m_ringBuffer->open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        emit errorOccurred("Failed to open audio ring buffer");
+        return;
+    }
+    m_audioOutput->setNotifyInterval(10);
+    connect(m_audioOutput, &QAudioOutput::notify, this, &AudioPlayer::onDeviceNotify, Qt::UniqueConnection);
+    m_audioOutput->start(m_ringBuffer);
+    if (m_audioOutput->error() != QAudio::NoError) {
+        disconnect(m_audioOutput, &QAudioOutput::notify, this, &AudioPlayer::onDeviceNotify);
         emit errorOccurred("Failed to start audio output");
         return;
     }
@@ -136,13 +219,14 @@ void AudioPlayer::start() {
     m_playing = true;
     m_paused = false;
 
-    // 设置 notify 信号，减少触发频率避免过度调用
-    m_audioOutput->setNotifyInterval(10);  // 改为10ms
-    connect(m_audioOutput, &QAudioOutput::notify, this, &AudioPlayer::writeAudioData, Qt::UniqueConnection);
     LogDebug << "输出缓冲区大小：" <<m_audioOutput->bufferSize();
-    // 重置时钟
+    // 重置时钟，processedUSecs随start归零，与环形缓冲的累计位置对齐
     m_clockTimer.restart();
-    m_bytesWritten = 0;
+    {
+        QMutexLocker clockLocker(&m_clockMutex);
+        m_clockUs = AV_NOPTS_VALUE;
+        m_clockRunning = false;
+    }
 
     LogInfo << "Audio playback started, waiting for audio data...";
 }
@@ -152,13 +236,14 @@ void AudioPlayer::stop() {
         return;
     }
 
+    m_nullTimer->stop();
+
     // 断开notify信号连接
     if (m_audioOutput) {
-        disconnect(m_audioOutput, &QAudioOutput::notify, this, &AudioPlayer::writeAudioData);
+        disconnect(m_audioOutput, &QAudioOutput::notify, this, &AudioPlayer::onDeviceNotify);
         m_audioOutput->stop();
     }
 
-    m_audioDevice = nullptr;
     m_playing = false;
     m_paused = false;
 
@@ -176,9 +261,21 @@ void AudioPlayer::pause() {
     if (m_audioOutput) {
         m_audioOutput->suspend();
     }
+    m_nullTimer->stop();
 
     m_paused = true;
 
+    // 冻结时钟在暂停时刻
+    {
+        QMutexLocker clockLocker(&m_clockMutex);
+        const qint64 nowUs = m_clockTimer.nsecsElapsed() / 1000;
+        if (m_clockRunning && m_clockUs != AV_NOPTS_VALUE) {
+            m_clockUs += nowUs - m_clockUpdatedUs;
+        }
+        m_clockUpdatedUs = nowUs;
+        m_clockRunning = false;
+    }
+
     LogInfo << "Audio playback paused";
 }
 
@@ -190,6 +287,10 @@ void AudioPlayer::resume() {
     if (m_audioOutput) {
         m_audioOutput->resume();
     }
+    if (m_deviceMode == NullRealtime) {
+        m_nullLastUs = m_nullClock.nsecsElapsed() / 1000;
+        m_nullTimer->start();
+    }
 
     m_paused = false;
 
@@ -198,12 +299,26 @@ void AudioPlayer::resume() {
 
 void AudioPlayer::clearBuffer() {
     QMutexLocker locker(&m_bufferMutex);
-    m_audioBuffer.clear();
+    m_ringBuffer->clear();
+    m_endPtsUs = AV_NOPTS_VALUE;
+    m_anchors.clear();
+
+    QMutexLocker clockLocker(&m_clockMutex);
+    m_clockUs = AV_NOPTS_VALUE;
+    m_clockRunning = false;
 }
 
 qint64 AudioPlayer::audioClock() {
     QMutexLocker locker(&m_clockMutex);
-    return m_audioClock;
+    if (m_clockUs == AV_NOPTS_VALUE) {
+        return 0;
+    }
+
+    qint64 clockUs = m_clockUs;
+    if (m_clockRunning) {
+        clockUs += m_clockTimer.nsecsElapsed() / 1000 - m_clockUpdatedUs;
+    }
+    return clockUs / 1000;
 }
 
 void AudioPlayer::onAudioFrameReady(std::shared_ptr<AVFrame> frame) {
@@ -211,44 +326,119 @@ void AudioPlayer::onAudioFrameReady(std::shared_ptr<AVFrame> frame) {
         return;
     }
 
-    // 转换音频帧
-    QByteArray audioData = convertAudioFrame(frame);
-    if (audioData.isEmpty()) {
+    const int dataSize = frameDataSize(frame.get());
+    if (dataSize <= 0) {
         LogErr << "音频数据转换失败";
         return;
     }
 
-    // 添加到缓冲区
+    // 超出最大缓冲时长时丢弃新帧，不推进队尾PTS，下一帧入队时按不连续处理
+    WriteRegion region;
+    if (!beginWrite(dataSize, &region)) {
+        LogWarn << "Audio buffer overflow, dropping frame";
+        return;
+    }
+
+    qint64 ptsUs = AV_NOPTS_VALUE;
     {
         QMutexLocker locker(&m_bufferMutex);
-
-        // 防止缓冲区溢出
-        while (m_audioBuffer.size() >= m_maxBufferSize) {
-            m_audioBuffer.dequeue();
-            LogWarn << "Audio buffer overflow, dropping frame";
+        if (frame->pts != AV_NOPTS_VALUE && m_timeBase.num > 0) {
+            ptsUs = av_rescale_q(frame->pts, m_timeBase, AVRational{1, 1000000});
         }
+    }
 
-        m_audioBuffer.enqueue(audioData);
-        LogDebug << "音频帧已添加到缓冲区，当前缓冲区大小:" << m_audioBuffer.size();
+    // 直接从解码帧拷入环形缓冲，设备回调时读取
+    const char *data = reinterpret_cast<const char*>(frame->data[0]);
+    const int head = qMin(dataSize, region.size[0]);
+    memcpy(region.data[0], data, head);
+    if (dataSize > head) {
+        memcpy(region.data[1], data + head, dataSize - head);
     }
+    commitWrite(dataSize, ptsUs);
+    LogDebug << "音频帧已添加到缓冲区，当前缓冲字节:" << m_ringBuffer->available();
+}
 
-    // 立即尝试写入数据，确保音频流能够激活
-    if (m_playing && !m_paused) {
-        writeAudioData();
+bool AudioPlayer::beginWrite(int bytes, WriteRegion *region)
+{
+    if (!m_initialized || bytes <= 0 || !region) {
+        return false;
+    }
+
+    char *first = nullptr;
+    char *second = nullptr;
+    qint64 firstLen = 0;
+    qint64 secondLen = 0;
+    if (m_ringBuffer->writeRegions(&first, &firstLen, &second, &secondLen) < bytes) {
+        return false;
+    }
+
+    region->data[0] = first;
+    region->size[0] = static_cast<int>(qMin<qint64>(firstLen, bytes));
+    region->data[1] = second;
+    region->size[1] = static_cast<int>(qMin<qint64>(secondLen, bytes - region->size[0]));
+    return true;
+}
+
+qint64 AudioPlayer::freeSpace() const
+{
+    if (!m_initialized) {
+        return -1;
     }
+    return m_ringBuffer->freeSpace();
+}
+
+qint64 AudioPlayer::bufferCapacity() const
+{
+    return m_initialized ? m_ringBuffer->capacity() : 0;
 }
 
-QByteArray AudioPlayer::convertAudioFrame(std::shared_ptr<AVFrame> frame) {
+void AudioPlayer::commitWrite(int bytes, qint64 ptsUs)
+{
+    if (bytes <= 0) {
+        return;
+    }
+
+    // 极速空设备写入即消费，没有播放位置，不记录时间轴
+    if (m_deviceMode == NullMaxSpeed) {
+        m_ringBuffer->commit(bytes);
+        m_ringBuffer->discard(m_ringBuffer->available());
+        return;
+    }
+
+    QMutexLocker locker(&m_bufferMutex);
+    recordTimelineLocked(m_ringBuffer->totalWritten(), ptsUs, bytes);
+    m_ringBuffer->commit(bytes);
+}
+
+void AudioPlayer::recordTimelineLocked(qint64 position, qint64 ptsUs, int bytes)
+{
+    // 队尾PTS按写入的采样数推进；帧PTS与推算值不一致时在该帧起始位置添加锚点
+    const qint64 bytesPerSecond = static_cast<qint64>(m_sampleRate) * bytesPerSample();
+    const qint64 durationUs = bytesPerSecond > 0 ? bytes * 1000000LL / bytesPerSecond : 0;
+    if (ptsUs != AV_NOPTS_VALUE) {
+        if (m_endPtsUs == AV_NOPTS_VALUE || qAbs(ptsUs - m_endPtsUs) > kAnchorToleranceUs) {
+            if (m_endPtsUs != AV_NOPTS_VALUE) {
+                LogDebug << "Audio timeline gap:" << (ptsUs - m_endPtsUs) / 1000 << "ms";
+            }
+            m_anchors.enqueue(PtsAnchor{position, ptsUs});
+            m_endPtsUs = ptsUs;
+        }
+    }
+    if (m_endPtsUs != AV_NOPTS_VALUE) {
+        m_endPtsUs += durationUs;
+    }
+}
+
+int AudioPlayer::frameDataSize(const AVFrame *frame) const {
     if (!frame || frame->format != AV_SAMPLE_FMT_S16) {
-        LogWarn << "Invalid frame or format not S16, format:" << frame->format;
-        return QByteArray();
+        LogWarn << "Invalid frame or format not S16, format:" << (frame ? frame->format : -1);
+        return 0;
     }
 
     // 验证帧参数与播放器设置是否匹配
     if (frame->sample_rate != m_sampleRate) {
         LogWarn << "Sample rate mismatch: frame=" << frame->sample_rate
                 << ", player=" << m_sampleRate;
-        // 可以选择继续处理或返回空数据
     }
 
     if (frame->channels != m_channels) {
@@ -260,7 +450,7 @@ QByteArray AudioPlayer::convertAudioFrame(std::shared_ptr<AVFrame> frame) {
     int dataSize = frame->nb_samples * frame->channels * 2;
     if (dataSize <= 0 || !frame->data[0]) {
         LogWarn << "Invalid audio frame data, size:" << dataSize;
-        return QByteArray();
+        return 0;
     }
 
     // 验证数据大小是否为帧大小的倍数
@@ -270,17 +460,23 @@ QByteArray AudioPlayer::convertAudioFrame(std::shared_ptr<AVFrame> frame) {
                 << dataSize << " bytes, frame size: " << frameSize;
     }
 
-    LogDebug << "Audio frame converted - samples:" << frame->nb_samples
-             << " channels:" << frame->channels
-             << " sample_rate:" << frame->sample_rate
-             << " data size:" << dataSize;
+    return dataSize;
+}
 
-    return QByteArray(reinterpret_cast<const char*>(frame->data[0]), dataSize);
+void AudioPlayer::setMaxBufferMs(int maxBufferMs)
+{
+    m_maxBufferMs = qMax(20, maxBufferMs);
+}
+
+void AudioPlayer::setTimeBase(AVRational timeBase)
+{
+    QMutexLocker locker(&m_bufferMutex);
+    m_timeBase = timeBase;
 }
 
-void AudioPlayer::setMaxBufferSize(int newMaxBufferSize)
+void AudioPlayer::setMetrics(PipelineMetrics *metrics)
 {
-    m_maxBufferSize = newMaxBufferSize;
+    m_metrics = metrics;
 }
 
 int AudioPlayer::getBufferDelayMs() const {
@@ -292,87 +488,104 @@ int AudioPlayer::getBufferDelayMs() const {
     return static_cast<int>(bufferSize / bytesPerMs);
 }
 
-// 优化writeAudioData逻辑，减少碎片化写入
-void AudioPlayer::writeAudioData() {
-    if (!m_audioDevice || !m_playing || m_paused) {
+void AudioPlayer::onNullDeviceTick() {
+    if (!m_playing || m_paused) {
         return;
     }
 
-    QMutexLocker locker(&m_bufferMutex);
-    if (m_audioBuffer.isEmpty()) {
+    const qint64 nowUs = m_nullClock.nsecsElapsed() / 1000;
+    m_nullRunUs += nowUs - m_nullLastUs;
+    m_nullLastUs = nowUs;
+
+    // 本拍应播放的字节数；数据不足时按静音推进设备时间轴，之后不追赶
+    const int sampleBytes = qMax(1, bytesPerSample());
+    const qint64 targetBytes = m_nullRunUs * m_sampleRate / 1000000 * sampleBytes;
+    const qint64 dueBytes = targetBytes - m_nullDeviceBytes;
+    if (dueBytes <= 0) {
         return;
     }
+    m_nullDeviceBytes = targetBytes;
 
-    int totalBytesWritten = 0;
-    int frameSize = (m_sampleSize / 8) * m_channels;
-
-    // === 批量写入策略 ===
-    while (!m_audioBuffer.isEmpty()) {
-        int freeBytes = m_audioOutput->bytesFree();
+    const qint64 available = m_ringBuffer->available();
+    const qint64 consumed = m_ringBuffer->discard(qMin(dueBytes, available - available % sampleBytes));
+    m_nullConsuming = consumed > 0;
 
-        // 如果可用空间太小，等待下次
-        if (freeBytes < frameSize * 2) {  // 至少需要2个采样点的空间
-            LogDebug << "Audio buffer nearly full, free bytes:" << freeBytes
-                     << ", waiting for more space";
-            break;
-        }
-
-        QByteArray &data = m_audioBuffer.head();
-        int bytesToWrite = qMin(data.size(), freeBytes);
-
-        // 确保写入完整的采样点
-        bytesToWrite = (bytesToWrite / frameSize) * frameSize;
+    QMutexLocker locker(&m_bufferMutex);
+    updateAudioClockFromDevice();
+}
 
-        if (bytesToWrite <= 0) {
-            break;
-        }
+void AudioPlayer::onDeviceNotify() {
+    if (!m_playing || m_paused || !m_audioOutput) {
+        return;
+    }
 
-        int written = m_audioDevice->write(data.constData(), bytesToWrite);
-        if (written <= 0) {
-            if (written < 0) {
-                LogErr << "Failed to write audio data, error:" << written;
-                emit errorOccurred("Failed to write audio data");
-            }
-            break;
-        }
+    // 设备缓冲占用，接近0表示即将欠载
+    if (m_metrics) {
+        m_metrics->setAudioDeviceBuffer(m_audioOutput->bufferSize() - m_audioOutput->bytesFree(),
+                                        m_audioOutput->bufferSize());
+    }
 
-        totalBytesWritten += written;
-        m_bytesWritten += written;
+    QMutexLocker locker(&m_bufferMutex);
+    updateAudioClockFromDevice();
+}
 
-        // 更新音频时钟（简化版本）
-        updateAudioClockFromBytes();
+void AudioPlayer::updateAudioClockFromDevice() {
+    const qint64 bytesPerSecond = static_cast<qint64>(m_sampleRate) * bytesPerSample();
+    if (bytesPerSecond <= 0) {
+        return;
+    }
 
-        // 处理数据更新
-        if (written >= data.size()) {
-            m_audioBuffer.dequeue();
-        } else {
-            data = data.mid(written);
-            break;
-        }
+    // 设备已处理的字节减去设备缓冲中尚未播放的部分，即正在播放的样本在环形缓冲中的累计位置；
+    // 设备在start时从环形缓冲位置0开始读取，两者一一对应。空设备读出即播放，没有设备延迟
+    qint64 processedBytes = m_ringBuffer->totalRead();
+    qint64 latencyBytes = 0;
+    bool running = m_nullConsuming;
+    if (m_audioOutput) {
+        processedBytes = m_audioOutput->processedUSecs() * bytesPerSecond / 1000000;
+        latencyBytes = m_audioOutput->bufferSize() - m_audioOutput->bytesFree();
+        // 设备欠载（Idle）时播放位置不前进，读取时不外推
+        running = m_audioOutput->state() == QAudio::ActiveState;
     }
+    const qint64 playedPosition = qBound<qint64>(0, processedBytes - latencyBytes,
+                                                 m_ringBuffer->totalRead());
 
-    if (totalBytesWritten > 0) {
-        LogDebug << "成功写入音频数据:" << totalBytesWritten << "字节"
-                 << ", 剩余缓冲区:" << m_audioBuffer.size()
-                 << ", 可写空间:" << m_audioOutput->bytesFree()
-                 << ", 缓冲区使用率:" << (100.0 * (m_audioOutput->bufferSize() - m_audioOutput->bytesFree()) / m_audioOutput->bufferSize()) << "%";
+    // 找到播放位置所在区段的锚点，已播放过的锚点出队
+    while (m_anchors.size() > 1 && m_anchors.at(1).position <= playedPosition) {
+        m_anchors.dequeue();
     }
-}
 
-// 简化的音频时钟更新
-void AudioPlayer::updateAudioClockFromBytes() {
-    QMutexLocker clockLocker(&m_clockMutex);
+    bool hasPts = false;
+    qint64 measuredUs = 0;
+    if (!m_anchors.isEmpty()) {
+        const PtsAnchor &anchor = m_anchors.head();
+        measuredUs = anchor.ptsUs + (playedPosition - anchor.position) * 1000000 / bytesPerSecond;
+        hasPts = true;
+    } else {
+        // 没有时间戳时只能给出从开始播放起的时长，不作为同步时钟发出
+        measuredUs = playedPosition * 1000000 / bytesPerSecond;
+    }
 
-    // 计算基于字节的播放位置
-    double bytesPerMs = (m_sampleRate * m_channels * (m_sampleSize / 8.0)) / 1000.0;
-    if (bytesPerMs > 0) {
-        // 考虑缓冲区中还未播放的数据
-        int bufferedBytes = m_audioOutput->bufferSize() - m_audioOutput->bytesFree();
-        qint64 playedBytes = qMax(0LL, m_bytesWritten - bufferedBytes);
+    // 设备按周期成块消耗数据，测量值呈阶梯状；与插值预测接近时按比例收敛，保持时钟平滑
+    qint64 clockUs = measuredUs;
+    {
+        QMutexLocker clockLocker(&m_clockMutex);
+        const qint64 nowUs = m_clockTimer.nsecsElapsed() / 1000;
+        if (m_clockRunning && m_clockUs != AV_NOPTS_VALUE) {
+            const qint64 predictedUs = m_clockUs + (nowUs - m_clockUpdatedUs);
+            const qint64 diffUs = measuredUs - predictedUs;
+            if (qAbs(diffUs) < kClockSnapUs) {
+                clockUs = predictedUs + diffUs / kClockSlewDivisor;
+            }
+        }
+        m_clockUs = clockUs;
+        m_clockUpdatedUs = nowUs;
+        m_clockRunning = running;
+    }
 
-        m_audioClock = static_cast<qint64>(playedBytes / bytesPerMs);
-        LogDebug << "音频时钟:"<<m_audioClock;
-        emit audioClockUpdated(m_audioClock);
+    if (hasPts) {
+        LogDebug << "音频时钟:" << clockUs / 1000 << "ms, 设备延迟:"
+                 << latencyBytes * 1000 / bytesPerSecond << "ms";
+        emit audioClockUpdated(clockUs / 1000);
     }
 }
 
@@ -395,16 +608,8 @@ void AudioPlayer::handleStateChanged(QAudio::State state) {
         LogInfo << "Audio state: Stopped - 音频流已停止";
         break;
     case QAudio::IdleState:
-        LogInfo << "Audio state: Idle - 等待音频数据，缓冲区大小:" << m_audioBuffer.size();
-            // 在Idle状态时尝试写入数据
-            if (m_playing && !m_paused) {
-            writeAudioData();
-        }
+        // 拉模式下设备会继续轮询环形缓冲，有数据后自动回到Active
+        LogInfo << "Audio state: Idle - 等待音频数据，缓冲字节:" << m_ringBuffer->available();
         break;
     }
 }
-
-void AudioPlayer::updateAudioClock(qint64 pts) {
-    QMutexLocker locker(&m_clockMutex);
-    m_audioClock = pts;
-}
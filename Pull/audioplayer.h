@@ -5,24 +5,37 @@
 #include <QIODevice>
 #include <QAudioOutput>
 #include <QAudioFormat>
-#include <QBuffer>
 #include <QMutex>
 #include <QQueue>
 #include <QThread>
 #include <memory>
 #include <QElapsedTimer>
+#include <QTimer>
 
 #include "DataStruct.h"
 
+class PipelineMetrics;
+class AudioRingBuffer;
 
 class AudioPlayer : public QObject
 {
     Q_OBJECT
 
 public:
+    // 输出设备
+    enum DeviceMode {
+        DefaultDevice,      // 系统默认输出设备
+        NullRealtime,       // 空设备：不打开声卡，按采样率实时消费数据，音频时钟照常工作
+        NullMaxSpeed        // 空设备：写入即消费，不等待，也不提供音频时钟
+    };
+
     explicit AudioPlayer(QObject *parent = nullptr);
     ~AudioPlayer();
 
+    // 设置输出设备（需在initialize之前设置）
+    void setDeviceMode(DeviceMode mode);
+    DeviceMode deviceMode() const { return m_deviceMode; }
+
     // 初始化音频输出
     bool initialize(int sampleRate = 44100, int channels = 2, int sampleSize = 16);
 
@@ -44,17 +57,42 @@ public:
     // 清空缓冲区
     void clearBuffer();
 
-    // 获取当前音频时钟 (毫秒)
+    // 当前音频时钟（毫秒）：设备正在播放的样本对应的流PTS，两次设备通知之间按系统时间插值
     qint64 audioClock() ;
 
-    void setMaxBufferSize(int newMaxBufferSize);
+    // 设置待播放数据的最大缓冲时长（毫秒），超出时丢弃新到的帧；在initialize之前设置
+    void setMaxBufferMs(int maxBufferMs);
+
+    // 设置音频帧时间戳的时间基，音频时钟据此换算为流PTS（毫秒）
+    void setTimeBase(AVRational timeBase);
+
+    // 设置流水线统计，记录设备缓冲占用，为空时不统计
+    void setMetrics(PipelineMetrics *metrics);
+
+    // 可直接写入的缓冲区域，回绕时分为两段（第二段可能为空），大小均为整采样点
+    struct WriteRegion {
+        char *data[2] = {nullptr, nullptr};
+        int size[2] = {0, 0};
+    };
+
+    // 生产者（单个线程，如解码线程）直接写入：确认还能容纳bytes字节并取得可写区域，
+    // 空间不足时返回false，调用方丢弃该帧。与onAudioFrameReady二选一
+    bool beginWrite(int bytes, WriteRegion *region);
+
+    // 环形缓冲剩余可写字节数，未初始化时返回-1（生产者据此在写满前暂停解码）
+    qint64 freeSpace() const;
+    qint64 bufferCapacity() const;
+
+    // 提交实际写入的字节数，ptsUs为首个样本的PTS（微秒），无时间戳时为AV_NOPTS_VALUE
+    void commitWrite(int bytes, qint64 ptsUs);
+
+    // 每个采样点（所有声道）的字节数
+    int bytesPerSample() const { return m_channels * (m_sampleSize / 8); }
 
 public slots:
     // 接收音频帧
     void onAudioFrameReady(std::shared_ptr<AVFrame> frame);
 
-    // 更新音频时钟 (用于外部同步)
-    void updateAudioClock(qint64 pts);
 signals:
     // 状态变化信号
     void stateChanged(QAudio::State state);
@@ -62,30 +100,48 @@ signals:
     // 错误信号
     void errorOccurred(const QString &error);
 
-    // 音频时钟更新信号
+    // 音频时钟更新信号：当前正在播放的音频PTS（毫秒）
     void audioClockUpdated(qint64 pts);
 
 private slots:
     // 处理状态变化
     void handleStateChanged(QAudio::State state);
 
-    // 写入音频数据
-    void writeAudioData();
+    // 设备周期通知：更新音频时钟与缓冲统计
+    void onDeviceNotify();
+
+    // 空设备实时节拍：按经过的时间消费数据
+    void onNullDeviceTick();
 
 private:
     // 设置音频格式
     void setupAudioFormat();
 
+    // 按最大缓冲时长分配环形缓冲，至少minBytes字节，按采样点对齐
+    void allocateRingBuffer(qint64 minBytes);
+
     int getBufferDelayMs() const;
 
-    void updateAudioClockFromBytes();
+    // 由设备已处理时长与设备缓冲占用计算播放位置，换算为PTS并平滑（调用方持有m_bufferMutex）
+    void updateAudioClockFromDevice();
+
+    // 校验音频帧格式，返回可直接写入设备的PCM字节数，无效时返回0
+    int frameDataSize(const AVFrame *frame) const;
 
-    // 转换音频帧
-    QByteArray convertAudioFrame(std::shared_ptr<AVFrame> frame);
+    // 记录写入位置的时间轴：推进队尾PTS，不连续时添加锚点（调用方持有m_bufferMutex）
+    void recordTimelineLocked(qint64 position, qint64 ptsUs, int bytes);
 
 private:
-    QAudioOutput *m_audioOutput = nullptr;
-    QIODevice *m_audioDevice = nullptr;
+    QAudioOutput *m_audioOutput = nullptr;     // 空设备时为空
+    DeviceMode m_deviceMode = DefaultDevice;
+
+    // 空设备：实时模式下定时消费，设备时间轴在欠载时照常前进（相当于播放静音），不追赶
+    QTimer *m_nullTimer = nullptr;
+    QElapsedTimer m_nullClock;
+    qint64 m_nullRunUs = 0;                  // 累计运行时长（不含暂停）
+    qint64 m_nullLastUs = 0;
+    qint64 m_nullDeviceBytes = 0;            // 设备时间轴位置（字节）
+    bool m_nullConsuming = false;            // 最近一拍有数据被消费
 
     // 音频格式
     QAudioFormat m_audioFormat;
@@ -93,14 +149,27 @@ private:
     int m_channels = 2;
     int m_sampleSize = 16;
 
-    // 音频缓冲区
-    QQueue<QByteArray> m_audioBuffer;
-    mutable QMutex m_bufferMutex;
-
-    int m_maxBufferSize = 1024;
-
-    // 音频时钟
-    qint64 m_audioClock = 0;
+    // 音频缓冲区：拉模式交给设备读取，位置以累计字节计
+    AudioRingBuffer *m_ringBuffer = nullptr;
+    mutable QMutex m_bufferMutex;            // 保护时间轴信息，设备读取不经过此锁
+    qint64 m_endPtsUs = AV_NOPTS_VALUE;      // 已入队数据末尾对应的PTS（微秒）
+    AVRational m_timeBase{0, 1};
+
+    // PTS锚点：从环形缓冲该字节位置开始的数据对应的PTS，之后按采样数连续推算；
+    // 只在时间轴不连续（首帧、上游丢包、溢出丢帧）时添加
+    struct PtsAnchor {
+        qint64 position;    // 累计写入环形缓冲的字节位置
+        qint64 ptsUs;
+    };
+    QQueue<PtsAnchor> m_anchors;
+
+    int m_maxBufferMs = 1000;
+    PipelineMetrics *m_metrics = nullptr;
+
+    // 音频时钟（微秒）及其更新时刻（m_clockTimer），无时间戳时为从开始播放起的时长
+    qint64 m_clockUs = AV_NOPTS_VALUE;
+    qint64 m_clockUpdatedUs = 0;
+    bool m_clockRunning = false;             // 设备正在消耗数据，读取时可外推
     QMutex m_clockMutex;
 
     // 播放状态
@@ -108,8 +177,6 @@ private:
     std::atomic_bool m_playing{false};
     std::atomic_bool m_paused{false};
 
-    // 性能统计
-    qint64 m_bytesWritten = 0;
     QElapsedTimer m_clockTimer;
 
 };
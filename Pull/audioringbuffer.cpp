@@ -0,0 +1,145 @@
+﻿#define LOG_MODULE Logger::PlayerModule
+#include "audioringbuffer.h"
+#include <cstring>
+#include "Logger.h"
+
+AudioRingBuffer::AudioRingBuffer(QObject *parent)
+    : QIODevice(parent)
+{
+
+}
+
+void AudioRingBuffer::allocate(qint64 capacity)
+{
+    m_buffer.assign(static_cast<size_t>(qMax<qint64>(capacity, 0)), 0);
+    clear();
+
+    LogDebug << "Audio ring buffer allocated:" << capacity << "bytes";
+}
+
+qint64 AudioRingBuffer::push(const char *data, qint64 len)
+{
+    if (!data || len <= 0) {
+        return 0;
+    }
+
+    char *first = nullptr;
+    char *second = nullptr;
+    qint64 firstLen = 0;
+    qint64 secondLen = 0;
+    const qint64 toWrite = qMin(len, writeRegions(&first, &firstLen, &second, &secondLen));
+    if (toWrite <= 0) {
+        return 0;
+    }
+
+    // 回绕时分两段拷贝
+    const qint64 head = qMin(toWrite, firstLen);
+    memcpy(first, data, static_cast<size_t>(head));
+    if (toWrite > head) {
+        memcpy(second, data + head, static_cast<size_t>(toWrite - head));
+    }
+
+    commit(toWrite);
+    return toWrite;
+}
+
+qint64 AudioRingBuffer::writeRegions(char **first, qint64 *firstLen, char **second, qint64 *secondLen)
+{
+    *first = nullptr;
+    *second = nullptr;
+    *firstLen = 0;
+    *secondLen = 0;
+
+    const qint64 size = capacity();
+    if (size == 0) {
+        return 0;
+    }
+
+    const qint64 writePos = m_writePos.load(std::memory_order_relaxed);
+    const qint64 readPos = m_readPos.load(std::memory_order_acquire);
+    const qint64 free = size - (writePos - readPos);
+    if (free <= 0) {
+        return 0;
+    }
+
+    const qint64 offset = writePos % size;
+    *first = m_buffer.data() + offset;
+    *firstLen = qMin(free, size - offset);
+    if (free > *firstLen) {
+        *second = m_buffer.data();
+        *secondLen = free - *firstLen;
+    }
+    return free;
+}
+
+void AudioRingBuffer::commit(qint64 len)
+{
+    if (len <= 0) {
+        return;
+    }
+    m_writePos.store(m_writePos.load(std::memory_order_relaxed) + len, std::memory_order_release);
+}
+
+qint64 AudioRingBuffer::discard(qint64 len)
+{
+    const qint64 readPos = m_readPos.load(std::memory_order_relaxed);
+    const qint64 toSkip = qMin(len, m_writePos.load(std::memory_order_acquire) - readPos);
+    if (toSkip <= 0) {
+        return 0;
+    }
+    m_readPos.store(readPos + toSkip, std::memory_order_release);
+    return toSkip;
+}
+
+qint64 AudioRingBuffer::available() const
+{
+    return m_writePos.load(std::memory_order_acquire) - m_readPos.load(std::memory_order_acquire);
+}
+
+qint64 AudioRingBuffer::freeSpace() const
+{
+    return capacity() - available();
+}
+
+void AudioRingBuffer::clear()
+{
+    m_writePos.store(0, std::memory_order_release);
+    m_readPos.store(0, std::memory_order_release);
+}
+
+qint64 AudioRingBuffer::bytesAvailable() const
+{
+    return available() + QIODevice::bytesAvailable();
+}
+
+qint64 AudioRingBuffer::readData(char *data, qint64 maxlen)
+{
+    const qint64 size = capacity();
+    if (!data || maxlen <= 0 || size == 0) {
+        return 0;
+    }
+
+    const qint64 readPos = m_readPos.load(std::memory_order_relaxed);
+    const qint64 writePos = m_writePos.load(std::memory_order_acquire);
+    const qint64 toRead = qMin(maxlen, writePos - readPos);
+    if (toRead <= 0) {
+        return 0;
+    }
+
+    const qint64 offset = readPos % size;
+    const qint64 first = qMin(toRead, size - offset);
+    memcpy(data, m_buffer.data() + offset, static_cast<size_t>(first));
+    if (toRead > first) {
+        memcpy(data + first, m_buffer.data(), static_cast<size_t>(toRead - first));
+    }
+
+    m_readPos.store(readPos + toRead, std::memory_order_release);
+    return toRead;
+}
+
+qint64 AudioRingBuffer::writeData(const char *data, qint64 len)
+{
+    Q_UNUSED(data)
+    Q_UNUSED(len)
+    return -1;
+}
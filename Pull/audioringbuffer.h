@@ -0,0 +1,67 @@
+﻿#ifndef AUDIORINGBUFFER_H
+#define AUDIORINGBUFFER_H
+
+#include <QIODevice>
+#include <atomic>
+#include <vector>
+
+/**
+ * @brief 播放器 -> 音频设备的单生产者/单消费者PCM字节环形缓冲
+ *
+ * 以拉模式交给 QAudioOutput::start(QIODevice*)，由设备按自己的回调节奏调用 readData 取数据，
+ * 生产者通过 push 写入解码后的PCM，或用 writeRegions/commit 让重采样器直接写入缓冲。缓冲在 allocate 时一次性分配，
+ * 运行期间收发只做内存拷贝与原子变量更新，不分配内存、不加锁。
+ * 读写位置为自开始以来的累计字节数，同时用于计算播放位置。
+ */
+class AudioRingBuffer : public QIODevice
+{
+    Q_OBJECT
+public:
+    explicit AudioRingBuffer(QObject *parent = nullptr);
+
+    // 分配容量（字节）并清空数据，不能与读写并发调用
+    void allocate(qint64 capacity);
+
+    qint64 capacity() const { return static_cast<qint64>(m_buffer.size()); }
+
+    // 生产者：写入数据，空间不足时只写入能容纳的部分，返回写入的字节数
+    qint64 push(const char *data, qint64 len);
+
+    // 生产者：取得可直接写入的空闲空间，回绕时分为两段（second可能为空），返回总字节数；
+    // 写入后调用commit提交实际写入的字节数
+    qint64 writeRegions(char **first, qint64 *firstLen, char **second, qint64 *secondLen);
+    void commit(qint64 len);
+
+    // 消费者：丢弃最多len字节（空设备消费），返回丢弃的字节数
+    qint64 discard(qint64 len);
+
+    // 可读字节数
+    qint64 available() const;
+
+    // 可写字节数
+    qint64 freeSpace() const;
+
+    // 累计写入/读出的字节数
+    qint64 totalWritten() const { return m_writePos.load(std::memory_order_acquire); }
+    qint64 totalRead() const { return m_readPos.load(std::memory_order_acquire); }
+
+    // 清空数据并将累计位置归零，只能在设备停止读取后调用
+    void clear();
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+
+protected:
+    // 消费者：音频设备回调读取，无数据时返回0，设备进入Idle状态等待
+    qint64 readData(char *data, qint64 maxlen) override;
+
+    // 只读设备，写入走push
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    std::vector<char> m_buffer;
+    std::atomic<qint64> m_writePos{0};
+    std::atomic<qint64> m_readPos{0};
+};
+
+#endif // AUDIORINGBUFFER_H
@@ -0,0 +1,224 @@
+﻿#define LOG_MODULE Logger::PlayerModule
+#include "avsyncengine.h"
+#include <Logger.h>
+
+namespace {
+
+// 超前超过该值才等待
+const double kSyncThreshold = 0.01;
+
+// 落后超过 max(帧时长, 该值) 时丢帧
+const double kMinDropThreshold = 0.04;
+
+// 偏差超过该值视为时间戳跳变，重新对齐时钟
+const double kNoSyncThreshold = 10.0;
+
+// 音频时钟超过该时间未更新视为失效
+const double kAudioClockTimeout = 1.0;
+
+// 单次等待上限，保证停止和时钟变化能及时响应
+const int kMaxWaitMs = 100;
+
+// 连续丢帧上限，避免主时钟异常时画面长时间不刷新
+const int kMaxConsecutiveDrops = 8;
+
+} // namespace
+
+double AVSyncEngine::Clock::get(double now) const
+{
+    if (!isValid()) {
+        return NAN;
+    }
+    return paused ? pts : pts + (now - updatedAt);
+}
+
+void AVSyncEngine::Clock::set(double value, double now)
+{
+    pts = value;
+    updatedAt = now;
+}
+
+AVSyncEngine::AVSyncEngine()
+{
+
+}
+
+void AVSyncEngine::setMasterClock(MasterClock master)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_master == master) {
+        return;
+    }
+    m_master = master;
+    m_consecutiveDrops = 0;
+    LogInfo << "Sync master clock: "
+            << (master == AudioMaster ? "audio" : master == VideoMaster ? "video" : "external");
+}
+
+AVSyncEngine::MasterClock AVSyncEngine::masterClock() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_master;
+}
+
+void AVSyncEngine::updateAudioClock(double pts)
+{
+    QMutexLocker locker(&m_mutex);
+    const double current = now();
+    m_audioClock.set(pts, current);
+
+    // 音频为主时外部时钟跟随音频，音频中断时可无缝退回
+    if (m_master == AudioMaster) {
+        m_externalClock.set(pts, current);
+    }
+}
+
+void AVSyncEngine::setExternalClock(double pts)
+{
+    QMutexLocker locker(&m_mutex);
+    m_externalClock.set(pts, now());
+}
+
+double AVSyncEngine::audioClock() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_audioClock.get(now());
+}
+
+double AVSyncEngine::videoClock() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_videoClock.get(now());
+}
+
+double AVSyncEngine::externalClock() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_externalClock.get(now());
+}
+
+AVSyncEngine::Schedule AVSyncEngine::schedule(double pts, double duration)
+{
+    QMutexLocker locker(&m_mutex);
+    const double current = now();
+    Schedule result;
+
+    // 无时间戳的帧无法同步，直接显示
+    if (std::isnan(pts)) {
+        presentLocked(pts, 0.0, current);
+        return result;
+    }
+
+    double master = masterTimeLocked(current);
+    if (std::isnan(master)) {
+        // 尚无参考时钟，以第一帧建立外部时钟
+        m_externalClock.set(pts, current);
+        master = pts;
+    }
+
+    double diff = pts - master;
+    if (std::fabs(diff) > kNoSyncThreshold) {
+        LogInfo << "Timestamp discontinuity " << diff << "s, resync clocks";
+        m_externalClock.set(pts, current);
+        presentLocked(pts, 0.0, current);
+        return result;
+    }
+
+    if (diff > kSyncThreshold) {
+        result.decision = Wait;
+        result.waitMs = qMin(kMaxWaitMs, static_cast<int>(std::ceil(diff * 1000.0)));
+        return result;
+    }
+
+    const double dropThreshold = qMax(duration, kMinDropThreshold);
+    if (diff < -dropThreshold) {
+        if (m_master == VideoMaster) {
+            // 视频为主时钟时不丢帧，从当前帧重新开始计时
+            m_externalClock.set(pts, current);
+            diff = 0.0;
+        } else if (m_consecutiveDrops < kMaxConsecutiveDrops) {
+            m_consecutiveDrops++;
+            m_stats.droppedFrames++;
+            result.decision = Drop;
+            return result;
+        }
+    }
+
+    presentLocked(pts, diff, current);
+    return result;
+}
+
+void AVSyncEngine::setPaused(bool paused)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_paused == paused) {
+        return;
+    }
+    m_paused = paused;
+
+    // 暂停时冻结当前值，恢复时从当前时刻继续走
+    const double current = now();
+    for (Clock *clock : {&m_audioClock, &m_videoClock, &m_externalClock}) {
+        if (clock->isValid()) {
+            clock->set(clock->get(current), current);
+        }
+        clock->paused = paused;
+    }
+}
+
+void AVSyncEngine::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_audioClock = Clock();
+    m_videoClock = Clock();
+    m_externalClock = Clock();
+    m_paused = false;
+    m_consecutiveDrops = 0;
+}
+
+AVSyncEngine::Stats AVSyncEngine::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats;
+}
+
+void AVSyncEngine::resetStats()
+{
+    QMutexLocker locker(&m_mutex);
+    m_stats = Stats();
+}
+
+double AVSyncEngine::now()
+{
+    return av_gettime_relative() / 1000000.0;
+}
+
+double AVSyncEngine::masterTimeLocked(double now) const
+{
+    if (m_master == AudioMaster) {
+        const bool audioAlive = m_audioClock.isValid()
+                                && (m_paused || now - m_audioClock.updatedAt < kAudioClockTimeout);
+        if (audioAlive) {
+            return m_audioClock.get(now);
+        }
+    }
+    // 视频为主时按外部时钟控制节奏，落后时外部时钟重新对齐到视频
+    return m_externalClock.get(now);
+}
+
+void AVSyncEngine::presentLocked(double pts, double diff, double now)
+{
+    if (!std::isnan(pts)) {
+        m_videoClock.set(pts, now);
+    }
+    m_consecutiveDrops = 0;
+
+    const double driftMs = diff * 1000.0;
+    m_stats.presentedFrames++;
+    m_stats.lastDriftMs = driftMs;
+    m_stats.averageDriftMs = m_stats.averageDriftMs * 0.9 + std::fabs(driftMs) * 0.1;
+    m_stats.maxDriftMs = qMax(m_stats.maxDriftMs, std::fabs(driftMs));
+    if (!std::isnan(pts) && m_audioClock.isValid()) {
+        m_stats.avDriftMs = (pts - m_audioClock.get(now)) * 1000.0;
+    }
+}
@@ -0,0 +1,107 @@
+﻿#ifndef AVSYNCENGINE_H
+#define AVSYNCENGINE_H
+
+#include <QMutex>
+#include <cmath>
+#include "DataStruct.h"
+
+/**
+ * @brief 音视频同步引擎
+ *
+ * 维护音频、视频、外部三个时钟（单位秒，两次更新之间按系统时间外推），
+ * 视频帧按流时间基换算出的 PTS 与主时钟比较，决定立即显示、等待或丢弃。
+ * 只在显示时丢帧，解码不跳过任何数据包，参考帧始终完整解码。
+ * 主时钟可选：
+ *  - AudioMaster：以音频播放位置为准（默认），音频时钟失效时退回外部时钟；
+ *  - VideoMaster：视频按自身时间戳节奏显示，不丢帧，只统计与音频的偏差；
+ *  - ExternalMaster：以外部时钟为准（未设置时从第一帧起按系统时间走），可用于多路画面对齐。
+ * 线程安全。
+ */
+class AVSyncEngine
+{
+public:
+    enum MasterClock {
+        AudioMaster,
+        VideoMaster,
+        ExternalMaster
+    };
+
+    enum Decision {
+        Present,    // 立即显示
+        Wait,       // 未到显示时间
+        Drop        // 已过显示时间，丢弃
+    };
+
+    struct Schedule {
+        Decision decision = Present;
+        int waitMs = 0;
+    };
+
+    // 偏差统计（毫秒），正值表示视频超前
+    struct Stats {
+        quint64 presentedFrames = 0;
+        quint64 droppedFrames = 0;
+        double lastDriftMs = 0.0;       // 最近一帧显示时相对主时钟的偏差
+        double averageDriftMs = 0.0;    // 偏差绝对值的滑动平均
+        double maxDriftMs = 0.0;        // 偏差绝对值的最大值
+        double avDriftMs = 0.0;         // 最近一帧显示时视频时钟与音频时钟之差
+    };
+
+    AVSyncEngine();
+
+    void setMasterClock(MasterClock master);
+    MasterClock masterClock() const;
+
+    // 更新音频时钟：当前正在播放的音频PTS（秒）
+    void updateAudioClock(double pts);
+
+    // 设置外部时钟（秒）
+    void setExternalClock(double pts);
+
+    // 当前各时钟值（秒），未建立时返回NAN
+    double audioClock() const;
+    double videoClock() const;
+    double externalClock() const;
+
+    // 决定一帧的显示时机，pts/duration单位为秒（pts为NAN表示无时间戳）
+    // 返回Present时视为该帧已显示，更新视频时钟与统计
+    Schedule schedule(double pts, double duration);
+
+    // 暂停时冻结所有时钟
+    void setPaused(bool paused);
+
+    // 清空时钟（重新开始播放时调用），保留主时钟设置
+    void reset();
+
+    Stats stats() const;
+    void resetStats();
+
+private:
+    struct Clock {
+        double pts = NAN;
+        double updatedAt = 0.0;
+        bool paused = false;
+
+        bool isValid() const { return !std::isnan(pts); }
+        double get(double now) const;
+        void set(double value, double now);
+    };
+
+    static double now();
+    double masterTimeLocked(double now) const;
+    void presentLocked(double pts, double diff, double now);
+
+private:
+    mutable QMutex m_mutex;
+    MasterClock m_master = AudioMaster;
+
+    Clock m_audioClock;
+    Clock m_videoClock;
+    Clock m_externalClock;
+    bool m_paused = false;
+
+    int m_consecutiveDrops = 0;
+    Stats m_stats;
+};
+
+#endif // AVSYNCENGINE_H
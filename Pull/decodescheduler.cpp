@@ -0,0 +1,283 @@
+﻿#define LOG_MODULE Logger::PullModule
+#include "decodescheduler.h"
+#include <QThread>
+#include <Logger.h>
+
+namespace {
+
+// 当前线程所属的调度器与工作线程序号，用于把任务提交到本线程队列
+struct WorkerContext {
+    DecodeScheduler *scheduler = nullptr;
+    int index = -1;
+};
+thread_local WorkerContext tlsWorker;
+
+} // namespace
+
+PipelineTask::PipelineTask(const QString &name, StepFunction step, DecodeScheduler *scheduler)
+    : m_name(name)
+    , m_step(std::move(step))
+    , m_scheduler(scheduler)
+{
+
+}
+
+void PipelineTask::notify()
+{
+    int state = m_state.load();
+    for (;;) {
+        switch (state) {
+        case Idle:
+        case Sleeping:
+            if (m_state.compare_exchange_weak(state, Queued)) {
+                m_scheduler->enqueue(shared_from_this());
+                return;
+            }
+            break;
+        case Running:
+            if (m_state.compare_exchange_weak(state, Notified)) {
+                return;
+            }
+            break;
+        default:
+            // 已在队列中、已标记或已结束
+            return;
+        }
+    }
+}
+
+DecodeScheduler::DecodeScheduler(int threadCount)
+{
+    if (threadCount <= 0) {
+        threadCount = qMax(1, QThread::idealThreadCount());
+    }
+
+    m_clock.start();
+
+    for (int i = 0; i <= threadCount; ++i) {
+        m_queues.push_back(std::make_unique<TaskQueue>());
+    }
+
+    for (int i = 0; i < threadCount; ++i) {
+        QThread *worker = QThread::create([this, i]() { workerLoop(i); });
+        worker->setObjectName(QString("DecodeWorker%1").arg(i));
+        m_workers.push_back(worker);
+        worker->start();
+    }
+
+    LogInfo << "Decode scheduler started with " << threadCount << " worker threads";
+}
+
+DecodeScheduler::~DecodeScheduler()
+{
+    m_stopping = true;
+    {
+        QMutexLocker locker(&m_sleepMutex);
+        m_wakeCondition.wakeAll();
+    }
+
+    for (QThread *worker : m_workers) {
+        worker->wait();
+        delete worker;
+    }
+    m_workers.clear();
+}
+
+std::shared_ptr<PipelineTask> DecodeScheduler::addTask(const QString &name, PipelineTask::StepFunction step)
+{
+    auto task = std::make_shared<PipelineTask>(name, std::move(step), this);
+    task->m_state = PipelineTask::Queued;
+    enqueue(task);
+    return task;
+}
+
+void DecodeScheduler::removeTask(const std::shared_ptr<PipelineTask> &task)
+{
+    if (!task) {
+        return;
+    }
+
+    task->m_removed = true;
+
+    // 未在执行的任务直接结束；队列/定时器中残留的条目出队时会被跳过
+    int state = task->m_state.load();
+    for (;;) {
+        if (state == PipelineTask::Running || state == PipelineTask::Notified) {
+            QMutexLocker locker(&m_removeMutex);
+            m_removeCondition.wait(&m_removeMutex, 10);
+            state = task->m_state.load();
+            continue;
+        }
+        if (state == PipelineTask::Done
+                || task->m_state.compare_exchange_weak(state, PipelineTask::Done)) {
+            break;
+        }
+    }
+}
+
+void DecodeScheduler::enqueue(std::shared_ptr<PipelineTask> task)
+{
+    // 工作线程内提交到本线程队列，外部线程提交到注入队列
+    const int index = (tlsWorker.scheduler == this)
+                          ? tlsWorker.index
+                          : static_cast<int>(m_queues.size()) - 1;
+    {
+        TaskQueue &queue = *m_queues[index];
+        QMutexLocker locker(&queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+
+    m_queuedCount.fetch_add(1);
+    if (m_sleepingWorkers.load() > 0) {
+        QMutexLocker locker(&m_sleepMutex);
+        m_wakeCondition.wakeOne();
+    }
+}
+
+std::shared_ptr<PipelineTask> DecodeScheduler::takeTask(int workerIndex)
+{
+    // 本线程队列 -> 注入队列，均按FIFO取，保证各路流轮转
+    const int injectIndex = static_cast<int>(m_queues.size()) - 1;
+    for (int index : {workerIndex, injectIndex}) {
+        TaskQueue &queue = *m_queues[index];
+        QMutexLocker locker(&queue.mutex);
+        if (!queue.tasks.empty()) {
+            std::shared_ptr<PipelineTask> task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            m_queuedCount.fetch_sub(1);
+            return task;
+        }
+    }
+
+    return steal(workerIndex);
+}
+
+std::shared_ptr<PipelineTask> DecodeScheduler::steal(int workerIndex)
+{
+    const int workerCount = static_cast<int>(m_workers.size());
+    for (int offset = 1; offset < workerCount; ++offset) {
+        TaskQueue &queue = *m_queues[(workerIndex + offset) % workerCount];
+        QMutexLocker locker(&queue.mutex);
+        if (!queue.tasks.empty()) {
+            // 从队尾窃取，与队列所有者错开
+            std::shared_ptr<PipelineTask> task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            m_queuedCount.fetch_sub(1);
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void DecodeScheduler::runTask(const std::shared_ptr<PipelineTask> &task)
+{
+    int expected = PipelineTask::Queued;
+    if (!task->m_state.compare_exchange_strong(expected, PipelineTask::Running)) {
+        // 已被移除的残留条目
+        return;
+    }
+
+    StepResult result = task->m_removed ? StepResult::finished() : task->m_step();
+
+    if (result.status == StepResult::Finished || task->m_removed) {
+        task->m_state = PipelineTask::Done;
+        QMutexLocker locker(&m_removeMutex);
+        m_removeCondition.wakeAll();
+        return;
+    }
+
+    if (result.status == StepResult::Progress) {
+        // 重新排到队尾，让其他流的任务先执行
+        task->m_state = PipelineTask::Queued;
+        enqueue(task);
+        return;
+    }
+
+    const int target = (result.status == StepResult::Wait)
+                           ? PipelineTask::Sleeping
+                           : PipelineTask::Idle;
+    expected = PipelineTask::Running;
+    if (task->m_state.compare_exchange_strong(expected, target)) {
+        if (target == PipelineTask::Sleeping) {
+            addTimer(task, result.waitMs);
+        }
+    } else {
+        // 执行期间收到notify
+        task->m_state = PipelineTask::Queued;
+        enqueue(task);
+    }
+}
+
+void DecodeScheduler::addTimer(const std::shared_ptr<PipelineTask> &task, int waitMs)
+{
+    const qint64 deadline = m_clock.elapsed() + qMax(1, waitMs);
+
+    QMutexLocker locker(&m_timerMutex);
+    m_timers.emplace(deadline, task);
+    m_nextDeadline = m_timers.begin()->first;
+}
+
+int DecodeScheduler::fireTimers()
+{
+    std::vector<std::shared_ptr<PipelineTask>> expired;
+    int nextWaitMs = -1;
+    {
+        QMutexLocker locker(&m_timerMutex);
+        const qint64 now = m_clock.elapsed();
+        while (!m_timers.empty() && m_timers.begin()->first <= now) {
+            if (auto task = m_timers.begin()->second.lock()) {
+                expired.push_back(std::move(task));
+            }
+            m_timers.erase(m_timers.begin());
+        }
+        if (m_timers.empty()) {
+            m_nextDeadline = -1;
+        } else {
+            m_nextDeadline = m_timers.begin()->first;
+            nextWaitMs = static_cast<int>(m_timers.begin()->first - now);
+        }
+    }
+
+    for (auto &task : expired) {
+        int expected = PipelineTask::Sleeping;
+        if (task->m_state.compare_exchange_strong(expected, PipelineTask::Queued)) {
+            enqueue(task);
+        }
+    }
+    return nextWaitMs;
+}
+
+void DecodeScheduler::workerLoop(int workerIndex)
+{
+    tlsWorker.scheduler = this;
+    tlsWorker.index = workerIndex;
+
+    while (!m_stopping) {
+        // 忙碌时也要按时触发到期的定时任务
+        const qint64 deadline = m_nextDeadline.load();
+        int nextWaitMs = -1;
+        if (deadline >= 0 && m_clock.elapsed() >= deadline) {
+            nextWaitMs = fireTimers();
+        }
+
+        std::shared_ptr<PipelineTask> task = takeTask(workerIndex);
+        if (task) {
+            runTask(task);
+            continue;
+        }
+
+        if (nextWaitMs < 0) {
+            nextWaitMs = fireTimers();
+        }
+
+        // 无可执行任务，休眠到下一个定时任务到期或被唤醒
+        QMutexLocker locker(&m_sleepMutex);
+        m_sleepingWorkers.fetch_add(1);
+        if (m_queuedCount.load() == 0 && !m_stopping) {
+            m_wakeCondition.wait(&m_sleepMutex, nextWaitMs < 0 ? 100 : qMax(1, nextWaitMs));
+        }
+        m_sleepingWorkers.fetch_sub(1);
+    }
+
+    tlsWorker = WorkerContext();
+}
@@ -0,0 +1,119 @@
+﻿#ifndef DECODESCHEDULER_H
+#define DECODESCHEDULER_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QString>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+#include "DataStruct.h"
+
+class QThread;
+class DecodeScheduler;
+
+/**
+ * @brief 调度任务：一路流的一个流水线阶段（视频解码/音频解码）
+ *
+ * 每次执行一步（step），由返回的 StepResult 决定重新排队、挂起等待唤醒或定时再执行，
+ * 同一任务任一时刻只会在一个工作线程上执行。
+ */
+class PipelineTask : public std::enable_shared_from_this<PipelineTask>
+{
+public:
+    using StepFunction = std::function<StepResult()>;
+
+    PipelineTask(const QString &name, StepFunction step, DecodeScheduler *scheduler);
+
+    const QString &name() const { return m_name; }
+
+    // 有新数据可处理（线程安全），挂起中的任务重新排队
+    void notify();
+
+    bool isFinished() const { return m_state.load() == Done; }
+
+private:
+    friend class DecodeScheduler;
+
+    enum State {
+        Idle,       // 挂起，等待notify
+        Queued,     // 在就绪队列中
+        Running,    // 正在执行
+        Notified,   // 执行期间收到notify，执行完立即重新排队
+        Sleeping,   // 定时等待中
+        Done        // 已结束或已移除
+    };
+
+    QString m_name;
+    StepFunction m_step;
+    DecodeScheduler *m_scheduler = nullptr;
+    std::atomic<int> m_state{Idle};
+    std::atomic_bool m_removed{false};
+};
+
+/**
+ * @brief 固定大小的工作窃取线程池，承载多路流的解码任务（任务不应执行阻塞的网络读取）
+ *
+ * 每个工作线程有自己的就绪队列（FIFO，保证各路流轮转执行），空闲时从其他线程队列尾部窃取；
+ * 外部线程提交的任务进入公共注入队列。线程数默认等于CPU核数，与流数量无关。
+ */
+class DecodeScheduler
+{
+public:
+    explicit DecodeScheduler(int threadCount = 0);
+    ~DecodeScheduler();
+
+    DecodeScheduler(const DecodeScheduler &) = delete;
+    DecodeScheduler &operator=(const DecodeScheduler &) = delete;
+
+    // 添加任务并立即排队执行
+    std::shared_ptr<PipelineTask> addTask(const QString &name, PipelineTask::StepFunction step);
+
+    // 移除任务，阻塞直到该任务当前步骤执行完毕，之后不会再被调用
+    void removeTask(const std::shared_ptr<PipelineTask> &task);
+
+    int threadCount() const { return static_cast<int>(m_workers.size()); }
+
+private:
+    friend class PipelineTask;
+
+    struct TaskQueue {
+        QMutex mutex;
+        std::deque<std::shared_ptr<PipelineTask>> tasks;
+    };
+
+    void enqueue(std::shared_ptr<PipelineTask> task);
+    std::shared_ptr<PipelineTask> takeTask(int workerIndex);
+    std::shared_ptr<PipelineTask> steal(int workerIndex);
+    void runTask(const std::shared_ptr<PipelineTask> &task);
+    void addTimer(const std::shared_ptr<PipelineTask> &task, int waitMs);
+    int fireTimers();
+    void workerLoop(int workerIndex);
+
+private:
+    std::vector<QThread*> m_workers;
+    std::vector<std::unique_ptr<TaskQueue>> m_queues;   // 每个工作线程一个，最后一个为注入队列
+    std::atomic<int> m_queuedCount{0};
+    std::atomic_bool m_stopping{false};
+
+    // 空闲工作线程休眠
+    QMutex m_sleepMutex;
+    QWaitCondition m_wakeCondition;
+    std::atomic<int> m_sleepingWorkers{0};
+
+    // 定时任务
+    QMutex m_timerMutex;
+    std::multimap<qint64, std::weak_ptr<PipelineTask>> m_timers;
+    std::atomic<qint64> m_nextDeadline{-1};
+    QElapsedTimer m_clock;
+
+    // 任务移除等待
+    QMutex m_removeMutex;
+    QWaitCondition m_removeCondition;
+};
+
+#endif // DECODESCHEDULER_H
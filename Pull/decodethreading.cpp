@@ -0,0 +1,127 @@
+﻿#define LOG_MODULE Logger::VideoModule
+#include "decodethreading.h"
+#include <QThread>
+#include <Logger.h>
+
+namespace {
+
+// 按分辨率限制单路线程数：小画面多线程收益很小，帧级多线程还会增加延迟与内存
+int resolutionThreadCap(int width, int height)
+{
+    const qint64 pixels = qint64(width) * height;
+    if (pixels <= 0) {
+        return 4;
+    }
+    if (pixels <= 720 * 576) {
+        return 2;
+    }
+    if (pixels <= 1920 * 1088) {
+        return 8;
+    }
+    return 16;
+}
+
+} // namespace
+
+DecodeThreadingPolicy &DecodeThreadingPolicy::instance()
+{
+    static DecodeThreadingPolicy policy;
+    return policy;
+}
+
+void DecodeThreadingPolicy::setAuto(int coreBudget)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_mode = AutoThreads;
+        m_coreBudget = coreBudget;
+    }
+    LogInfo << "Decode threading: auto, core budget "
+            << (coreBudget > 0 ? coreBudget : QThread::idealThreadCount());
+    notifyDecoders();
+}
+
+void DecodeThreadingPolicy::setFixed(int threadCount, int threadType)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_mode = FixedThreads;
+        m_fixed.threadCount = qMax(0, threadCount);
+        m_fixed.threadType = threadType;
+    }
+    LogInfo << "Decode threading: fixed " << threadCount << " threads, type " << threadType;
+    notifyDecoders();
+}
+
+DecodeThreadingPolicy::Mode DecodeThreadingPolicy::mode() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_mode;
+}
+
+DecodeThreadingPolicy::Settings DecodeThreadingPolicy::resolve(int width, int height, bool lowLatency) const
+{
+    Settings settings;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_mode == FixedThreads) {
+            settings = m_fixed;
+        } else {
+            // 核数在活动解码器间平分，再按分辨率封顶
+            const int cores = m_coreBudget > 0 ? m_coreBudget : qMax(1, QThread::idealThreadCount());
+            const int decoders = qMax(1, static_cast<int>(m_decoders.size()));
+            settings.threadCount = qMin(qMax(1, cores / decoders), resolutionThreadCap(width, height));
+            settings.threadType = FF_THREAD_FRAME | FF_THREAD_SLICE;
+        }
+    }
+
+    if (lowLatency) {
+        settings.threadType = FF_THREAD_SLICE;
+    }
+    return settings;
+}
+
+int DecodeThreadingPolicy::addDecoder(std::function<void()> changed)
+{
+    int id = 0;
+    bool notify = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        id = m_nextId++;
+        m_decoders.emplace(id, std::move(changed));
+        notify = (m_mode == AutoThreads);
+    }
+    if (notify) {
+        notifyDecoders(id);
+    }
+    return id;
+}
+
+void DecodeThreadingPolicy::removeDecoder(int id)
+{
+    bool notify = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        notify = m_decoders.erase(id) > 0 && m_mode == AutoThreads;
+    }
+    if (notify) {
+        notifyDecoders();
+    }
+}
+
+int DecodeThreadingPolicy::activeDecoders() const
+{
+    QMutexLocker locker(&m_mutex);
+    return static_cast<int>(m_decoders.size());
+}
+
+void DecodeThreadingPolicy::notifyDecoders(int excludeId)
+{
+    // 持锁调用，removeDecoder返回后不会再回调已注销的解码器
+    QMutexLocker locker(&m_mutex);
+    for (const auto &decoder : m_decoders) {
+        if (decoder.first != excludeId) {
+            decoder.second();
+        }
+    }
+}
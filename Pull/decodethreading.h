@@ -0,0 +1,71 @@
+﻿#ifndef DECODETHREADING_H
+#define DECODETHREADING_H
+
+#include <QMutex>
+#include <functional>
+#include <map>
+#include "DataStruct.h"
+
+/**
+ * @brief 软件解码的线程策略（全局共享，线程安全）
+ *
+ * 决定每路解码器的 thread_count / thread_type。自动模式按分辨率和当前活动解码器数量分配：
+ * 少量高分辨率流使用帧级多线程占满各核，大量小画面流每路单线程，避免线程数远超核数。
+ * 固定模式所有解码器使用指定值。解码器打开时注册、关闭时注销，数量或策略变化时通知已注册的
+ * 解码器，由其在下一个关键帧处按新设置重新打开。
+ */
+class DecodeThreadingPolicy
+{
+public:
+    enum Mode {
+        AutoThreads,        // 按分辨率与活动流数量分配
+        FixedThreads        // 所有解码器使用固定设置
+    };
+
+    struct Settings {
+        int threadCount = 1;                                // 0 由libavcodec按核数决定
+        int threadType = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+        bool operator==(const Settings &other) const {
+            return threadCount == other.threadCount && threadType == other.threadType;
+        }
+        bool operator!=(const Settings &other) const { return !(*this == other); }
+    };
+
+    static DecodeThreadingPolicy &instance();
+
+    DecodeThreadingPolicy(const DecodeThreadingPolicy &) = delete;
+    DecodeThreadingPolicy &operator=(const DecodeThreadingPolicy &) = delete;
+
+    // 自动模式，coreBudget为所有解码器共用的核数，<=0 时使用CPU核数
+    void setAuto(int coreBudget = 0);
+
+    // 固定模式
+    void setFixed(int threadCount, int threadType = FF_THREAD_FRAME | FF_THREAD_SLICE);
+
+    Mode mode() const;
+
+    // 按当前策略计算一路解码器的设置；低延迟解码只用片级多线程（帧级多线程每个线程多一帧延迟）
+    Settings resolve(int width, int height, bool lowLatency) const;
+
+    // 注册/注销活动解码器，changed在数量或策略变化时被调用（任意线程、持锁调用，只可设置标志）
+    int addDecoder(std::function<void()> changed);
+    void removeDecoder(int id);
+    int activeDecoders() const;
+
+private:
+    DecodeThreadingPolicy() = default;
+
+    // 通知所有已注册的解码器
+    void notifyDecoders(int excludeId = -1);
+
+private:
+    mutable QMutex m_mutex;
+    Mode m_mode = AutoThreads;
+    int m_coreBudget = 0;
+    Settings m_fixed;
+    std::map<int, std::function<void()>> m_decoders;
+    int m_nextId = 1;
+};
+
+#endif // DECODETHREADING_H
@@ -0,0 +1,146 @@
+﻿#define LOG_MODULE Logger::VideoModule
+#include "frameconverter.h"
+#include "framepool.h"
+#include <Logger.h>
+
+FrameConverter::FrameConverter()
+{
+
+}
+
+FrameConverter::~FrameConverter()
+{
+    reset();
+}
+
+void FrameConverter::setTargetSize(const QSize &size)
+{
+    if (!size.isValid() || size == m_targetSize) {
+        return;
+    }
+
+    m_targetSize = size;
+
+    // 目标尺寸变化，下一帧转换时重建上下文（旧上下文在重建时释放，均在调用线程内）
+    m_outputSize = QSize();
+}
+
+std::shared_ptr<AVFrame> FrameConverter::convert(const AVFrame *src)
+{
+    if (!src || !ensureContext(src)) {
+        return nullptr;
+    }
+
+    // 输出缓冲取自帧池，显示组件释放最后一个引用后回到池中
+    std::shared_ptr<AVFrame> dst = FramePool::instance().acquire(
+        m_outputSize.width(), m_outputSize.height(), AV_PIX_FMT_RGBA);
+    if (!dst) {
+        LogWarn << "Failed to allocate output frame";
+        return nullptr;
+    }
+
+    // 转换+缩放一次完成，直接写入输出帧
+    int ret = sws_scale(m_swsContext,
+                        src->data, src->linesize,
+                        0, src->height,
+                        dst->data, dst->linesize);
+    if (ret <= 0) {
+        LogWarn << "Failed to convert frame";
+        return nullptr;
+    }
+
+    av_frame_copy_props(dst.get(), src);
+
+    return dst;
+}
+
+void FrameConverter::reset()
+{
+    if (m_swsContext) {
+        sws_freeContext(m_swsContext);
+        m_swsContext = nullptr;
+    }
+    m_srcWidth = 0;
+    m_srcHeight = 0;
+    m_srcFormat = AV_PIX_FMT_NONE;
+    m_outputSize = QSize();
+}
+
+bool FrameConverter::isDirectRenderable(int format)
+{
+    return format == AV_PIX_FMT_YUV420P
+           || format == AV_PIX_FMT_YUVJ420P
+           || format == AV_PIX_FMT_NV12;
+}
+
+std::shared_ptr<AVFrame> FrameConverter::reference(const AVFrame *src)
+{
+    if (!src) {
+        return nullptr;
+    }
+
+    AVFrame *dst = av_frame_alloc();
+    if (!dst) {
+        LogWarn << "Failed to allocate output frame";
+        return nullptr;
+    }
+
+    if (av_frame_ref(dst, src) < 0) {
+        av_frame_free(&dst);
+        return nullptr;
+    }
+
+    return std::shared_ptr<AVFrame>(dst, [](AVFrame *f) {
+        if (f) av_frame_free(&f);
+    });
+}
+
+bool FrameConverter::ensureContext(const AVFrame *src)
+{
+    const AVPixelFormat srcFormat = static_cast<AVPixelFormat>(src->format);
+    if (m_swsContext
+            && m_outputSize.isValid()
+            && m_srcWidth == src->width
+            && m_srcHeight == src->height
+            && m_srcFormat == srcFormat) {
+        return true;
+    }
+
+    reset();
+
+    // 输出尺寸：按源宽高比放入目标区域，未设置目标时保持原尺寸
+    QSize sourceSize(src->width, src->height);
+    m_outputSize = m_targetSize.isEmpty()
+                       ? sourceSize
+                       : sourceSize.scaled(m_targetSize, Qt::KeepAspectRatio);
+    m_outputSize = m_outputSize.expandedTo(QSize(2, 2));
+
+    // 缩小到一半以下的小画面用快速双线性，画质差异不明显，开销明显更低
+    const bool smallOutput = m_outputSize.width() * 2 <= src->width
+                             && m_outputSize.height() * 2 <= src->height;
+    const int scaleFlags = smallOutput ? SWS_FAST_BILINEAR : SWS_BILINEAR;
+
+    m_swsContext = sws_getContext(
+        src->width, src->height, srcFormat,
+        m_outputSize.width(), m_outputSize.height(), AV_PIX_FMT_RGBA,
+        scaleFlags, nullptr, nullptr, nullptr
+        );
+
+    if (!m_swsContext) {
+        LogWarn << "Failed to create image conversion context";
+        m_outputSize = QSize();
+        return false;
+    }
+
+    m_srcWidth = src->width;
+    m_srcHeight = src->height;
+    m_srcFormat = srcFormat;
+
+    LogInfo << "SWS context created for conversion: "
+            << av_get_pix_fmt_name(srcFormat) << " -> RGBA "
+            << src->width << "x" << src->height
+            << " -> " << m_outputSize.width() << "x" << m_outputSize.height()
+            << (smallOutput ? " (fast)" : "");
+
+    return true;
+}
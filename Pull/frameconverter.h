@@ -0,0 +1,55 @@
+﻿#ifndef FRAMECONVERTER_H
+#define FRAMECONVERTER_H
+
+#include <QSize>
+#include <memory>
+#include "DataStruct.h"
+
+/**
+ * @brief 解码帧 -> 显示帧转换器
+ *
+ * 一次 sws_scale 同时完成像素格式转换（-> RGBA）和缩放（按源宽高比放入目标区域），
+ * 输出为引用计数的 AVFrame（缓冲取自 FramePool），显示组件直接引用其数据绘制，不再做任何拷贝或二次缩放。
+ * 仅在解码线程内使用，非线程安全。
+ */
+class FrameConverter
+{
+public:
+    FrameConverter();
+    ~FrameConverter();
+
+    FrameConverter(const FrameConverter &) = delete;
+    FrameConverter &operator=(const FrameConverter &) = delete;
+
+    // 设置目标显示区域，输出尺寸按源宽高比缩放到该区域内
+    void setTargetSize(const QSize &size);
+    QSize targetSize() const { return m_targetSize; }
+
+    // 转换帧，失败返回nullptr
+    std::shared_ptr<AVFrame> convert(const AVFrame *src);
+
+    // 释放转换上下文
+    void reset();
+
+    // 可由GL组件直接渲染的YUV格式，此类帧无需转换
+    static bool isDirectRenderable(int format);
+
+    // 引用源帧（不拷贝像素数据），用于YUV直通
+    static std::shared_ptr<AVFrame> reference(const AVFrame *src);
+
+private:
+    bool ensureContext(const AVFrame *src);
+
+private:
+    SwsContext *m_swsContext = nullptr;
+
+    // 当前上下文对应的源参数
+    int m_srcWidth = 0;
+    int m_srcHeight = 0;
+    AVPixelFormat m_srcFormat = AV_PIX_FMT_NONE;
+
+    QSize m_targetSize;
+    QSize m_outputSize;
+};
+
+#endif // FRAMECONVERTER_H
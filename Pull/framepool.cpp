@@ -0,0 +1,137 @@
+﻿#define LOG_MODULE Logger::VideoModule
+#include "framepool.h"
+#include <Logger.h>
+
+namespace {
+
+// 行对齐，与 av_frame_get_buffer(frame, 32) 一致
+const int kLineAlign = 32;
+
+// 超过该时间未使用的分级被回收
+const qint64 kIdleClassMs = 5000;
+
+} // namespace
+
+FramePool &FramePool::instance()
+{
+    static FramePool pool;
+    return pool;
+}
+
+FramePool::FramePool()
+{
+    m_clock.start();
+}
+
+FramePool::~FramePool()
+{
+    clear();
+}
+
+std::shared_ptr<AVFrame> FramePool::acquire(int width, int height, AVPixelFormat format)
+{
+    const int bufferSize = av_image_get_buffer_size(format, width, height, kLineAlign);
+    if (bufferSize <= 0) {
+        LogWarn << "Invalid frame pool request: " << width << "x" << height
+                << " " << av_get_pix_fmt_name(format);
+        return nullptr;
+    }
+
+    AVBufferRef *buffer = nullptr;
+    {
+        QMutexLocker locker(&m_mutex);
+        const qint64 nowMs = m_clock.elapsed();
+
+        SizeClass &sizeClass = m_classes[SizeKey{width, height, format}];
+        if (!sizeClass.pool) {
+            sizeClass.pool = av_buffer_pool_init2(bufferSize, this, &FramePool::allocBuffer, nullptr);
+            if (!sizeClass.pool) {
+                m_classes.erase(SizeKey{width, height, format});
+                return nullptr;
+            }
+        }
+        sizeClass.lastUsedMs = nowMs;
+        buffer = av_buffer_pool_get(sizeClass.pool);
+
+        trimLocked(nowMs);
+    }
+    m_acquired.fetch_add(1, std::memory_order_relaxed);
+
+    if (!buffer) {
+        LogWarn << "Failed to get buffer from frame pool";
+        return nullptr;
+    }
+
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) {
+        av_buffer_unref(&buffer);
+        return nullptr;
+    }
+
+    frame->format = format;
+    frame->width = width;
+    frame->height = height;
+    frame->buf[0] = buffer;
+    av_image_fill_arrays(frame->data, frame->linesize, buffer->data,
+                         format, width, height, kLineAlign);
+
+    return std::shared_ptr<AVFrame>(frame, [](AVFrame *f) {
+        if (f) av_frame_free(&f);
+    });
+}
+
+FramePool::Stats FramePool::stats() const
+{
+    Stats stats;
+    const quint64 acquired = m_acquired.load(std::memory_order_relaxed);
+    stats.misses = m_misses.load(std::memory_order_relaxed);
+    stats.hits = acquired > stats.misses ? acquired - stats.misses : 0;
+    stats.allocatedBytes = m_allocatedBytes.load(std::memory_order_relaxed);
+
+    QMutexLocker locker(&m_mutex);
+    stats.sizeClasses = static_cast<int>(m_classes.size());
+    return stats;
+}
+
+void FramePool::resetStats()
+{
+    m_acquired = 0;
+    m_misses = 0;
+    m_allocatedBytes = 0;
+}
+
+void FramePool::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    for (auto &entry : m_classes) {
+        // 使用中的缓冲归还时由FFmpeg释放，池在最后一个缓冲归还后销毁
+        av_buffer_pool_uninit(&entry.second.pool);
+    }
+    m_classes.clear();
+}
+
+AVBufferRef *FramePool::allocBuffer(void *opaque, int size)
+{
+    FramePool *self = static_cast<FramePool*>(opaque);
+    self->m_misses.fetch_add(1, std::memory_order_relaxed);
+    self->m_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    return av_buffer_alloc(size);
+}
+
+void FramePool::trimLocked(qint64 nowMs)
+{
+    if (nowMs - m_lastTrimMs < kIdleClassMs) {
+        return;
+    }
+    m_lastTrimMs = nowMs;
+
+    for (auto it = m_classes.begin(); it != m_classes.end();) {
+        if (nowMs - it->second.lastUsedMs > kIdleClassMs) {
+            LogDebug << "Frame pool class released: " << it->first.width << "x" << it->first.height;
+            av_buffer_pool_uninit(&it->second.pool);
+            it = m_classes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+﻿#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <QMutex>
+#include <QElapsedTimer>
+#include <atomic>
+#include <map>
+#include <memory>
+#include "DataStruct.h"
+
+/**
+ * @brief 视频帧缓冲池
+ *
+ * 按 分辨率+像素格式 分级，每级对应一个 AVBufferPool。取出的帧是普通的引用计数 AVFrame，
+ * 最后一个引用释放时（解码线程丢弃、显示组件换帧或 av_frame_ref 的副本释放）像素缓冲自动回到池中，
+ * 调用方无需归还。长时间未使用的分级（窗口缩放后的旧尺寸）会被回收。全局共享，线程安全。
+ */
+class FramePool
+{
+public:
+    struct Stats {
+        quint64 hits = 0;           // 复用池中缓冲
+        quint64 misses = 0;         // 新分配缓冲
+        qint64 allocatedBytes = 0;  // 累计新分配字节数
+        int sizeClasses = 0;        // 当前分级数
+    };
+
+    static FramePool &instance();
+
+    FramePool(const FramePool &) = delete;
+    FramePool &operator=(const FramePool &) = delete;
+
+    // 取出一帧（已分配像素缓冲，未设置时间戳等属性），失败返回nullptr
+    std::shared_ptr<AVFrame> acquire(int width, int height, AVPixelFormat format);
+
+    Stats stats() const;
+    void resetStats();
+
+    // 释放所有空闲缓冲（使用中的缓冲在归还时释放）
+    void clear();
+
+private:
+    FramePool();
+    ~FramePool();
+
+    struct SizeKey {
+        int width;
+        int height;
+        int format;
+        bool operator<(const SizeKey &other) const {
+            if (width != other.width) return width < other.width;
+            if (height != other.height) return height < other.height;
+            return format < other.format;
+        }
+    };
+
+    struct SizeClass {
+        AVBufferPool *pool = nullptr;
+        qint64 lastUsedMs = 0;
+    };
+
+    static AVBufferRef *allocBuffer(void *opaque, int size);
+    void trimLocked(qint64 nowMs);
+
+private:
+    mutable QMutex m_mutex;
+    std::map<SizeKey, SizeClass> m_classes;
+    QElapsedTimer m_clock;
+    qint64 m_lastTrimMs = 0;
+
+    std::atomic<quint64> m_acquired{0};
+    std::atomic<quint64> m_misses{0};
+    std::atomic<qint64> m_allocatedBytes{0};
+};
+
+#endif // FRAMEPOOL_H
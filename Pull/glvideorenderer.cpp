@@ -0,0 +1,341 @@
+﻿#define LOG_MODULE Logger::PlayerModule
+#include "glvideorenderer.h"
+#include "frameconverter.h"
+#include "pipelinemetrics.h"
+#include <QOpenGLContext>
+#include <QGenericMatrix>
+#include <QVector3D>
+#include <cstring>
+#include <Logger.h>
+
+namespace {
+
+const char *kVertexShader =
+    "attribute vec4 a_position;\n"
+    "attribute vec2 a_texCoord;\n"
+    "varying vec2 v_texCoord;\n"
+    "void main() {\n"
+    "    gl_Position = a_position;\n"
+    "    v_texCoord = a_texCoord;\n"
+    "}\n";
+
+// YUV420P：Y、U、V 三个平面各一张亮度纹理
+const char *kI420FragmentShader =
+    "#ifdef GL_ES\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "varying vec2 v_texCoord;\n"
+    "uniform sampler2D u_texY;\n"
+    "uniform sampler2D u_texU;\n"
+    "uniform sampler2D u_texV;\n"
+    "uniform mat3 u_yuvToRgb;\n"
+    "uniform vec3 u_offset;\n"
+    "void main() {\n"
+    "    vec3 yuv = vec3(texture2D(u_texY, v_texCoord).r,\n"
+    "                    texture2D(u_texU, v_texCoord).r,\n"
+    "                    texture2D(u_texV, v_texCoord).r) - u_offset;\n"
+    "    gl_FragColor = vec4(clamp(u_yuvToRgb * yuv, 0.0, 1.0), 1.0);\n"
+    "}\n";
+
+// NV12：Y 平面 + UV 交织平面（亮度-alpha纹理，U在r、V在a）
+const char *kNV12FragmentShader =
+    "#ifdef GL_ES\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "varying vec2 v_texCoord;\n"
+    "uniform sampler2D u_texY;\n"
+    "uniform sampler2D u_texUV;\n"
+    "uniform mat3 u_yuvToRgb;\n"
+    "uniform vec3 u_offset;\n"
+    "void main() {\n"
+    "    vec4 uv = texture2D(u_texUV, v_texCoord);\n"
+    "    vec3 yuv = vec3(texture2D(u_texY, v_texCoord).r, uv.r, uv.a) - u_offset;\n"
+    "    gl_FragColor = vec4(clamp(u_yuvToRgb * yuv, 0.0, 1.0), 1.0);\n"
+    "}\n";
+
+// 全屏四边形：位置(x, y) + 纹理坐标(s, t)，纹理行序自上而下
+const GLfloat kQuadVertices[] = {
+    -1.0f, -1.0f, 0.0f, 1.0f,
+     1.0f, -1.0f, 1.0f, 1.0f,
+    -1.0f,  1.0f, 0.0f, 0.0f,
+     1.0f,  1.0f, 1.0f, 0.0f,
+};
+
+} // namespace
+
+GLVideoRenderer::GLVideoRenderer(QWidget *parent)
+    : QOpenGLWidget(parent)
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+}
+
+GLVideoRenderer::~GLVideoRenderer()
+{
+    releaseGL();
+}
+
+bool GLVideoRenderer::isFormatSupported(int format)
+{
+    return FrameConverter::isDirectRenderable(format);
+}
+
+void GLVideoRenderer::setFrame(std::shared_ptr<AVFrame> frame)
+{
+    if (!frame || !isFormatSupported(frame->format)) {
+        return;
+    }
+    m_frame = std::move(frame);
+    m_frameDirty = true;
+    update();
+}
+
+void GLVideoRenderer::clearFrame()
+{
+    m_frame.reset();
+    m_frameDirty = false;
+    update();
+}
+
+void GLVideoRenderer::initializeGL()
+{
+    if (!context() || !context()->isValid()) {
+        LogWarn << "OpenGL context unavailable, falling back to raster rendering";
+        emit initializeFailed();
+        return;
+    }
+
+    initializeOpenGLFunctions();
+
+    if (!buildProgram(m_i420Program, kI420FragmentShader)
+            || !buildProgram(m_nv12Program, kNV12FragmentShader)) {
+        emit initializeFailed();
+        return;
+    }
+
+    if (!m_vertexBuffer.create()) {
+        LogWarn << "Failed to create vertex buffer";
+        emit initializeFailed();
+        return;
+    }
+    m_vertexBuffer.bind();
+    m_vertexBuffer.allocate(kQuadVertices, sizeof(kQuadVertices));
+    m_vertexBuffer.release();
+
+    glGenTextures(3, m_textures);
+    for (GLuint texture : m_textures) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // 桌面GL及ES3支持按行宽上传，ES2需要先紧凑排列
+    const QSurfaceFormat format = context()->format();
+    m_hasRowLength = !context()->isOpenGLES() || format.majorVersion() >= 3;
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    m_initialized = true;
+
+    LogInfo << "OpenGL renderer initialized: "
+            << reinterpret_cast<const char *>(glGetString(GL_RENDERER))
+            << " GL " << format.majorVersion() << "." << format.minorVersion()
+            << (context()->isOpenGLES() ? " ES" : "");
+}
+
+void GLVideoRenderer::resizeGL(int w, int h)
+{
+    Q_UNUSED(w);
+    Q_UNUSED(h);
+    // 视口在paintGL中按帧宽高比计算
+}
+
+void GLVideoRenderer::paintGL()
+{
+    const qreal dpr = devicePixelRatioF();
+    const int surfaceWidth = static_cast<int>(width() * dpr);
+    const int surfaceHeight = static_cast<int>(height() * dpr);
+
+    glViewport(0, 0, surfaceWidth, surfaceHeight);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    if (!m_initialized || !m_frame) {
+        return;
+    }
+
+    // 统计纹理上传与绘制命令提交（不含GPU执行）
+    MetricTimer timer(m_metrics, PipelineMetrics::Paint);
+
+    const AVFrame *frame = m_frame.get();
+    const bool nv12 = frame->format == AV_PIX_FMT_NV12;
+    const int chromaWidth = (frame->width + 1) / 2;
+    const int chromaHeight = (frame->height + 1) / 2;
+
+    // 仅在新帧到达时上传纹理，重绘（如窗口遮挡恢复）直接复用
+    if (m_frameDirty) {
+        uploadPlane(0, frame->data[0], frame->linesize[0],
+                    frame->width, frame->height, 1, GL_LUMINANCE);
+        if (nv12) {
+            uploadPlane(1, frame->data[1], frame->linesize[1],
+                        chromaWidth, chromaHeight, 2, GL_LUMINANCE_ALPHA);
+        } else {
+            uploadPlane(1, frame->data[1], frame->linesize[1],
+                        chromaWidth, chromaHeight, 1, GL_LUMINANCE);
+            uploadPlane(2, frame->data[2], frame->linesize[2],
+                        chromaWidth, chromaHeight, 1, GL_LUMINANCE);
+        }
+        m_frameDirty = false;
+    }
+
+    // 按帧宽高比居中，缩放由纹理采样完成
+    QSize fitSize = QSize(frame->width, frame->height)
+                        .scaled(surfaceWidth, surfaceHeight, Qt::KeepAspectRatio);
+    glViewport((surfaceWidth - fitSize.width()) / 2,
+               (surfaceHeight - fitSize.height()) / 2,
+               fitSize.width(), fitSize.height());
+
+    QOpenGLShaderProgram &program = nv12 ? m_nv12Program : m_i420Program;
+    program.bind();
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_textures[0]);
+    program.setUniformValue("u_texY", 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, m_textures[1]);
+    if (nv12) {
+        program.setUniformValue("u_texUV", 1);
+    } else {
+        program.setUniformValue("u_texU", 1);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, m_textures[2]);
+        program.setUniformValue("u_texV", 2);
+    }
+    applyColorMatrix(program, frame);
+
+    m_vertexBuffer.bind();
+    program.enableAttributeArray("a_position");
+    program.enableAttributeArray("a_texCoord");
+    program.setAttributeBuffer("a_position", GL_FLOAT, 0, 2, 4 * sizeof(GLfloat));
+    program.setAttributeBuffer("a_texCoord", GL_FLOAT, 2 * sizeof(GLfloat), 2, 4 * sizeof(GLfloat));
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    program.disableAttributeArray("a_position");
+    program.disableAttributeArray("a_texCoord");
+    m_vertexBuffer.release();
+    program.release();
+    glActiveTexture(GL_TEXTURE0);
+}
+
+bool GLVideoRenderer::buildProgram(QOpenGLShaderProgram &program, const char *fragmentSource)
+{
+    if (!program.addShaderFromSourceCode(QOpenGLShader::Vertex, kVertexShader)
+            || !program.addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentSource)) {
+        LogWarn << "Failed to compile video shader: " << program.log();
+        return false;
+    }
+
+    program.bindAttributeLocation("a_position", 0);
+    program.bindAttributeLocation("a_texCoord", 1);
+
+    if (!program.link()) {
+        LogWarn << "Failed to link video shader: " << program.log();
+        return false;
+    }
+    return true;
+}
+
+void GLVideoRenderer::uploadPlane(int index, const uint8_t *data, int linesize,
+                                  int width, int height, int bytesPerPixel, GLenum format)
+{
+    if (!data || width <= 0 || height <= 0) {
+        return;
+    }
+
+    const int rowBytes = width * bytesPerPixel;
+    const uint8_t *pixels = data;
+    bool rowLengthSet = false;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (linesize != rowBytes) {
+#ifdef GL_UNPACK_ROW_LENGTH
+        if (m_hasRowLength && linesize > 0) {
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize / bytesPerPixel);
+            rowLengthSet = true;
+        }
+#endif
+        if (!rowLengthSet) {
+            // 逐行紧凑拷贝
+            m_repackBuffer.resize(rowBytes * height);
+            uint8_t *dst = reinterpret_cast<uint8_t *>(m_repackBuffer.data());
+            for (int y = 0; y < height; ++y) {
+                memcpy(dst + y * rowBytes, data + y * linesize, rowBytes);
+            }
+            pixels = dst;
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, m_textures[index]);
+    if (m_planeSizes[index] != QSize(width, height)) {
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0,
+                     format, GL_UNSIGNED_BYTE, pixels);
+        m_planeSizes[index] = QSize(width, height);
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                        format, GL_UNSIGNED_BYTE, pixels);
+    }
+
+#ifdef GL_UNPACK_ROW_LENGTH
+    if (rowLengthSet) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
+#endif
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void GLVideoRenderer::applyColorMatrix(QOpenGLShaderProgram &program, const AVFrame *frame)
+{
+    // 色彩空间：未标注时按分辨率推断（高清默认BT.709）
+    bool bt709 = frame->colorspace == AVCOL_SPC_BT709;
+    if (frame->colorspace == AVCOL_SPC_UNSPECIFIED) {
+        bt709 = frame->height >= 720;
+    }
+    const bool fullRange = frame->color_range == AVCOL_RANGE_JPEG
+                           || frame->format == AV_PIX_FMT_YUVJ420P;
+
+    const float kr = bt709 ? 1.5748f : 1.402f;
+    const float gb = bt709 ? 0.187324f : 0.344136f;
+    const float gr = bt709 ? 0.468124f : 0.714136f;
+    const float kb = bt709 ? 1.8556f : 1.772f;
+
+    // 有限范围：Y 16-235、UV 16-240，归一化系数并入矩阵
+    const float ys = fullRange ? 1.0f : 255.0f / 219.0f;
+    const float cs = fullRange ? 1.0f : 255.0f / 224.0f;
+
+    const float values[] = {
+        ys, 0.0f,     kr * cs,
+        ys, -gb * cs, -gr * cs,
+        ys, kb * cs,  0.0f,
+    };
+    program.setUniformValue("u_yuvToRgb", QMatrix3x3(values));
+    program.setUniformValue("u_offset",
+                            QVector3D(fullRange ? 0.0f : 16.0f / 255.0f,
+                                      128.0f / 255.0f, 128.0f / 255.0f));
+}
+
+void GLVideoRenderer::releaseGL()
+{
+    if (!m_initialized || !context()) {
+        return;
+    }
+
+    makeCurrent();
+    glDeleteTextures(3, m_textures);
+    m_vertexBuffer.destroy();
+    m_i420Program.removeAllShaders();
+    m_nv12Program.removeAllShaders();
+    doneCurrent();
+
+    m_initialized = false;
+}
@@ -0,0 +1,76 @@
+﻿#ifndef GLVIDEORENDERER_H
+#define GLVIDEORENDERER_H
+
+#include <QOpenGLWidget>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLBuffer>
+#include <memory>
+#include "DataStruct.h"
+
+class PipelineMetrics;
+
+/**
+ * @brief YUV 直接渲染组件
+ *
+ * 将解码得到的 YUV420P / NV12 平面直接上传为亮度纹理，颜色转换与缩放在片元着色器中完成，
+ * 解码线程无需再做 sws_scale 到 RGBA。着色器只使用 GLSL 1.10 / ES 2.0 的公共子集，
+ * 可运行在 Mesa llvmpipe 等软件 GL 上。初始化失败时发出 initializeFailed()，
+ * 由 PlayImage 回退到 QPainter 绘制路径。
+ */
+class GLVideoRenderer : public QOpenGLWidget, protected QOpenGLFunctions
+{
+    Q_OBJECT
+public:
+    explicit GLVideoRenderer(QWidget *parent = nullptr);
+    ~GLVideoRenderer();
+
+    // 是否可直接渲染该像素格式
+    static bool isFormatSupported(int format);
+
+    // 设置当前显示帧（持有引用直到下一帧）
+    void setFrame(std::shared_ptr<AVFrame> frame);
+
+    // 清除画面
+    void clearFrame();
+
+    bool isInitialized() const { return m_initialized; }
+
+    // 设置流水线统计，记录绘制耗时，为空时不统计
+    void setMetrics(PipelineMetrics *metrics) { m_metrics = metrics; }
+
+signals:
+    // GL上下文或着色器初始化失败
+    void initializeFailed();
+
+protected:
+    void initializeGL() override;
+    void paintGL() override;
+    void resizeGL(int w, int h) override;
+
+private:
+    bool buildProgram(QOpenGLShaderProgram &program, const char *fragmentSource);
+    void uploadPlane(int index, const uint8_t *data, int linesize,
+                     int width, int height, int bytesPerPixel, GLenum format);
+    void applyColorMatrix(QOpenGLShaderProgram &program, const AVFrame *frame);
+    void releaseGL();
+
+private:
+    std::shared_ptr<AVFrame> m_frame;
+    bool m_frameDirty = false;
+
+    QOpenGLShaderProgram m_i420Program;
+    QOpenGLShaderProgram m_nv12Program;
+    QOpenGLBuffer m_vertexBuffer{QOpenGLBuffer::VertexBuffer};
+    GLuint m_textures[3] = {0, 0, 0};
+    QSize m_planeSizes[3];
+
+    // ES 2.0 不支持 GL_UNPACK_ROW_LENGTH，行宽与linesize不一致时先紧凑排列
+    QByteArray m_repackBuffer;
+    bool m_hasRowLength = false;
+
+    bool m_initialized = false;
+    PipelineMetrics *m_metrics = nullptr;
+};
+
+#endif // GLVIDEORENDERER_H
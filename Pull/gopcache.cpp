@@ -0,0 +1,163 @@
+﻿#define LOG_MODULE Logger::PullModule
+#include "gopcache.h"
+#include "packetring.h"
+#include <Logger.h>
+
+GopCache::GopCache(qint64 maxBytes)
+    : m_maxBytes(maxBytes)
+{
+
+}
+
+GopCache::~GopCache()
+{
+    clearLocked();
+}
+
+void GopCache::setMaxBytes(qint64 maxBytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxBytes = qMax<qint64>(0, maxBytes);
+    if (m_maxBytes == 0 || m_bytes > m_maxBytes) {
+        clearLocked();
+    }
+}
+
+qint64 GopCache::maxBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxBytes;
+}
+
+void GopCache::beginSession(std::shared_ptr<AVCodecParameters> params)
+{
+    QMutexLocker locker(&m_mutex);
+    m_params = std::move(params);
+    m_currentSession = false;
+    m_complete = false;
+}
+
+std::shared_ptr<AVCodecParameters> GopCache::codecParameters() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_params;
+}
+
+void GopCache::add(const AVPacket *packet)
+{
+    const bool keyframe = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+
+    QMutexLocker locker(&m_mutex);
+    if (m_maxBytes <= 0) {
+        return;
+    }
+
+    if (keyframe) {
+        // 单个关键帧超过上限时不缓存
+        clearLocked();
+        if (packet->size > m_maxBytes) {
+            return;
+        }
+        m_complete = true;
+        m_currentSession = true;
+        m_keyframeUs = av_gettime_relative();
+    } else if (!m_complete) {
+        return;
+    } else if (m_bytes + packet->size > m_maxBytes) {
+        // 超限后的包不再连续，保留已缓存的部分
+        m_complete = false;
+        LogDebug << "GOP cache full at " << m_packets.size() << " packets, "
+                 << m_bytes << " bytes";
+        return;
+    }
+
+    AVPacket *copy = av_packet_alloc();
+    if (!copy || av_packet_ref(copy, packet) < 0) {
+        av_packet_free(&copy);
+        m_complete = false;
+        return;
+    }
+    m_packets.push_back(copy);
+    m_bytes += packet->size;
+}
+
+void GopCache::markGap()
+{
+    QMutexLocker locker(&m_mutex);
+    m_complete = false;
+}
+
+void GopCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    clearLocked();
+}
+
+std::shared_ptr<AVPacket> GopCache::previewKeyframe(int maxAgeMs) const
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_packets.empty() || m_currentSession) {
+        return nullptr;
+    }
+    if (maxAgeMs > 0 && av_gettime_relative() - m_keyframeUs > int64_t(maxAgeMs) * 1000) {
+        return nullptr;
+    }
+
+    AVPacket *packet = av_packet_alloc();
+    if (!packet || av_packet_ref(packet, m_packets.front()) < 0) {
+        av_packet_free(&packet);
+        return nullptr;
+    }
+    return std::shared_ptr<AVPacket>(packet, [](AVPacket *p) {
+        av_packet_free(&p);
+    });
+}
+
+bool GopCache::canReplay() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_currentSession && !m_packets.empty();
+}
+
+int GopCache::replayTo(PacketRing *ring, bool *complete)
+{
+    QMutexLocker locker(&m_mutex);
+    bool all = m_complete;
+    int pushed = 0;
+    if (m_currentSession) {
+        for (const AVPacket *packet : m_packets) {
+            if (!ring->canAccept(packet) || !ring->push(packet, 0)) {
+                all = false;
+                break;
+            }
+            ++pushed;
+        }
+    }
+    if (complete) {
+        *complete = all && pushed > 0;
+    }
+    return pushed;
+}
+
+int GopCache::packetCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return static_cast<int>(m_packets.size());
+}
+
+qint64 GopCache::bytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bytes;
+}
+
+void GopCache::clearLocked()
+{
+    for (AVPacket *packet : m_packets) {
+        av_packet_free(&packet);
+    }
+    m_packets.clear();
+    m_bytes = 0;
+    m_complete = false;
+    m_currentSession = false;
+}
@@ -0,0 +1,71 @@
+﻿#ifndef GOPCACHE_H
+#define GOPCACHE_H
+
+#include <QMutex>
+#include <memory>
+#include <vector>
+#include "DataStruct.h"
+
+class PacketRing;
+
+/**
+ * @brief 单路视频源的GOP缓存（拉流层）
+ *
+ * 保存最近一个关键帧及其后读到的视频包（只增加引用，不拷贝数据），按字节数限制容量，
+ * 超限后停止追加，到下一个关键帧重新开始。新接入的解码器据此不必等待摄像机的下一个关键帧：
+ * 重新开始播放时先解码缓存的关键帧显示首帧，暂停后恢复解码时由拉流线程把本次连接的GOP
+ * 重放到包队列。写入与重放只在拉流线程进行，查询接口任意线程可调用。
+ */
+class GopCache
+{
+public:
+    explicit GopCache(qint64 maxBytes = 8 * 1024 * 1024);
+    ~GopCache();
+
+    GopCache(const GopCache &) = delete;
+    GopCache &operator=(const GopCache &) = delete;
+
+    // 字节上限，0表示不缓存
+    void setMaxBytes(qint64 maxBytes);
+    qint64 maxBytes() const;
+
+    // 新连接开始：记录编解码参数；已缓存的内容只作为预览，不再重放到新连接的包队列
+    void beginSession(std::shared_ptr<AVCodecParameters> params);
+    std::shared_ptr<AVCodecParameters> codecParameters() const;
+
+    // 追加视频包：关键帧开始新的GOP，尚未收到关键帧时忽略
+    void add(const AVPacket *packet);
+
+    // 之后读到的包与已缓存的部分不连续（解复用器跳过了非关键帧），到下一个关键帧前不再追加
+    void markGap();
+
+    void clear();
+
+    // 上次连接缓存的关键帧引用，用作首帧预览；缓存时间超过maxAgeMs（<=0不限）、
+    // 没有缓存或关键帧已属于当前连接（已在包队列中）时返回nullptr
+    std::shared_ptr<AVPacket> previewKeyframe(int maxAgeMs = 0) const;
+
+    // 是否有本次连接的GOP可重放
+    bool canReplay() const;
+
+    // 把本次连接缓存的GOP依次写入ring，返回写入的包数；complete返回是否已连续写到最新读出的包
+    int replayTo(PacketRing *ring, bool *complete);
+
+    int packetCount() const;
+    qint64 bytes() const;
+
+private:
+    void clearLocked();
+
+private:
+    mutable QMutex m_mutex;
+    std::vector<AVPacket*> m_packets;       // 首个为关键帧
+    qint64 m_bytes = 0;
+    qint64 m_maxBytes = 0;
+    bool m_complete = false;                // 关键帧之后读到的包都已缓存
+    bool m_currentSession = false;          // 关键帧属于当前连接
+    int64_t m_keyframeUs = 0;               // 关键帧缓存时刻（av_gettime_relative）
+    std::shared_ptr<AVCodecParameters> m_params;
+};
+
+#endif // GOPCACHE_H
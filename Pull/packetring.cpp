@@ -0,0 +1,451 @@
+﻿#define LOG_MODULE Logger::PullModule
+#include "packetring.h"
+#include <QDeadlineTimer>
+#include <Logger.h>
+
+PacketRing::PacketRing(int capacity)
+{
+    // 容量取2的幂，便于用掩码取槽位
+    m_capacity = 1;
+    while (m_capacity < qMax(2, capacity)) {
+        m_capacity <<= 1;
+    }
+    m_mask = static_cast<quint64>(m_capacity - 1);
+
+    m_slots.resize(m_capacity, nullptr);
+    m_arrivalUs.resize(m_capacity, 0);
+    m_timestamps.reset(new std::atomic<int64_t>[m_capacity]);
+    for (int i = 0; i < m_capacity; ++i) {
+        m_timestamps[i].store(AV_NOPTS_VALUE, std::memory_order_relaxed);
+    }
+    for (auto &slot : m_slots) {
+        slot = av_packet_alloc();
+        if (!slot) {
+            LogErr << "分配包队列槽位失败";
+        }
+    }
+}
+
+PacketRing::~PacketRing()
+{
+    for (auto &slot : m_slots) {
+        av_packet_free(&slot);
+    }
+    avcodec_parameters_free(&m_pendingParams);
+}
+
+bool PacketRing::push(const AVPacket *packet, int timeoutMs)
+{
+    return pushSlot(packet, 0, timeoutMs);
+}
+
+bool PacketRing::pushSlot(const AVPacket *packet, int markerFlags, int timeoutMs)
+{
+    const quint64 tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) >= static_cast<quint64>(m_capacity)) {
+        if (!waitForSpace(timeoutMs)) {
+            return false;
+        }
+    }
+
+    AVPacket *slot = m_slots[tail & m_mask];
+    if (!slot) {
+        return false;
+    }
+
+    // packet为空时槽位保持空包，作为标记
+    if (packet && av_packet_ref(slot, packet) < 0) {
+        LogWarn << "包引用失败";
+        return false;
+    }
+    if (!packet) {
+        slot->flags = markerFlags;
+    }
+    m_arrivalUs[tail & m_mask] = av_gettime_relative();
+    m_timestamps[tail & m_mask].store(packet ? packetTimestamp(packet) : AV_NOPTS_VALUE,
+                                      std::memory_order_relaxed);
+    if (packet) {
+        m_queuedBytes.fetch_add(packet->size, std::memory_order_relaxed);
+    }
+
+    m_tail.store(tail + 1, std::memory_order_release);
+
+    if (packet) {
+        const int64_t timestamp = packetTimestamp(packet);
+        if (timestamp != AV_NOPTS_VALUE) {
+            m_newestTimestamp.store(timestamp, std::memory_order_relaxed);
+        }
+        if (packet->flags & AV_PKT_FLAG_KEY) {
+            m_keyframesPushed.fetch_add(1, std::memory_order_release);
+        }
+    }
+    notifyConsumer();
+    return true;
+}
+
+bool PacketRing::pushEof(int timeoutMs)
+{
+    return pushSlot(nullptr, 0, timeoutMs);
+}
+
+bool PacketRing::pushDiscontinuity(const AVCodecParameters *newParams, AVRational timeBase, int timeoutMs)
+{
+    {
+        QMutexLocker locker(&m_paramsMutex);
+        avcodec_parameters_free(&m_pendingParams);
+        if (newParams) {
+            m_pendingParams = avcodec_parameters_alloc();
+            if (m_pendingParams && avcodec_parameters_copy(m_pendingParams, newParams) < 0) {
+                avcodec_parameters_free(&m_pendingParams);
+            }
+        }
+        m_pendingTimeBase = timeBase;
+    }
+    return pushSlot(nullptr, AV_PKT_FLAG_DISCARD, timeoutMs);
+}
+
+AVCodecParameters *PacketRing::takeCodecParameters(AVRational *timeBase)
+{
+    QMutexLocker locker(&m_paramsMutex);
+    if (timeBase) {
+        *timeBase = m_pendingTimeBase;
+    }
+    AVCodecParameters *params = m_pendingParams;
+    m_pendingParams = nullptr;
+    return params;
+}
+
+bool PacketRing::isEndOfStream(const AVPacket *packet)
+{
+    return packet->data == nullptr && packet->size == 0 && !(packet->flags & AV_PKT_FLAG_DISCARD);
+}
+
+bool PacketRing::isDiscontinuity(const AVPacket *packet)
+{
+    return packet->data == nullptr && packet->size == 0 && (packet->flags & AV_PKT_FLAG_DISCARD);
+}
+
+bool PacketRing::canAccept(const AVPacket *packet) const
+{
+    const quint64 tail = m_tail.load(std::memory_order_relaxed);
+    const quint64 head = m_head.load(std::memory_order_acquire);
+    if (tail - head >= static_cast<quint64>(m_capacity)) {
+        return false;
+    }
+    if (!packet) {
+        return true;
+    }
+
+    if (m_limits.maxBytes > 0
+            && m_queuedBytes.load(std::memory_order_relaxed) + packet->size > m_limits.maxBytes) {
+        return false;
+    }
+
+    // 时长：新包与队首包的时间戳差，队首槽位由生产者写入，此处读取无竞争
+    if (m_maxDuration > 0 && head != tail) {
+        const int64_t oldest = m_timestamps[head & m_mask].load(std::memory_order_relaxed);
+        const int64_t timestamp = packetTimestamp(packet);
+        if (oldest != AV_NOPTS_VALUE && timestamp != AV_NOPTS_VALUE
+                && timestamp - oldest > m_maxDuration) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PacketRing::recordDrop(const AVPacket *packet, bool newEvent)
+{
+    m_droppedPackets.fetch_add(1, std::memory_order_relaxed);
+    if (packet) {
+        m_droppedBytes.fetch_add(packet->size, std::memory_order_relaxed);
+    }
+    if (newEvent) {
+        m_dropEvents.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool PacketRing::pop(AVPacket *dst, int timeoutMs, int64_t *arrivalUs)
+{
+    if (!dst) {
+        return false;
+    }
+
+    const quint64 head = m_head.load(std::memory_order_relaxed);
+    if (m_tail.load(std::memory_order_acquire) == head) {
+        if (!waitForData(timeoutMs)) {
+            return false;
+        }
+    }
+
+    AVPacket *slot = m_slots[head & m_mask];
+    m_queuedBytes.fetch_sub(slot->size, std::memory_order_relaxed);
+    av_packet_move_ref(dst, slot);
+    if (arrivalUs) {
+        *arrivalUs = m_arrivalUs[head & m_mask];
+    }
+    if (dst->flags & AV_PKT_FLAG_KEY) {
+        ++m_keyframesPopped;
+    }
+
+    m_head.store(head + 1, std::memory_order_release);
+    notifyProducer();
+    return true;
+}
+
+int PacketRing::skipToKeyframe(AVPacket *dst, int64_t maxDelay, int64_t *arrivalUs)
+{
+    if (maxDelay <= 0 || (dst->data == nullptr && dst->size == 0)) {
+        return 0;
+    }
+
+    const int64_t timestamp = packetTimestamp(dst);
+    const int64_t newest = m_newestTimestamp.load(std::memory_order_relaxed);
+    if (timestamp == AV_NOPTS_VALUE || newest == AV_NOPTS_VALUE
+            || newest - timestamp <= maxDelay) {
+        return 0;
+    }
+
+    // 队列中没有关键帧时丢包只会造成花屏，等关键帧到达后再跳
+    if (!hasQueuedKeyframe()) {
+        return 0;
+    }
+
+    int dropped = 0;
+    av_packet_unref(dst);
+    while (pop(dst, 0, arrivalUs)) {
+        // 关键帧、流结束或不连续标记处停止
+        if ((dst->flags & AV_PKT_FLAG_KEY) || (dst->data == nullptr && dst->size == 0)) {
+            break;
+        }
+        av_packet_unref(dst);
+        ++dropped;
+    }
+    return dropped + 1;
+}
+
+int PacketRing::skipToLatest(AVPacket *dst, int64_t maxDelay, int64_t *arrivalUs)
+{
+    if (maxDelay <= 0) {
+        return 0;
+    }
+
+    const int64_t newest = m_newestTimestamp.load(std::memory_order_relaxed);
+    if (newest == AV_NOPTS_VALUE) {
+        return 0;
+    }
+
+    int dropped = 0;
+    while (!(dst->data == nullptr && dst->size == 0)) {
+        const int64_t timestamp = packetTimestamp(dst);
+        // 队列非空时出队必然成功，dst不会被替换为空包
+        if (timestamp == AV_NOPTS_VALUE || newest - timestamp <= maxDelay || isEmpty()) {
+            break;
+        }
+        av_packet_unref(dst);
+        pop(dst, 0, arrivalUs);
+        ++dropped;
+    }
+    return dropped;
+}
+
+bool PacketRing::hasQueuedKeyframe() const
+{
+    return m_keyframesPushed.load(std::memory_order_acquire) - m_keyframesPopped > 0;
+}
+
+int64_t PacketRing::packetTimestamp(const AVPacket *packet)
+{
+    return packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+}
+
+void PacketRing::clear()
+{
+    quint64 head = m_head.load(std::memory_order_relaxed);
+    const quint64 tail = m_tail.load(std::memory_order_acquire);
+    while (head != tail) {
+        AVPacket *slot = m_slots[head & m_mask];
+        if (slot->flags & AV_PKT_FLAG_KEY) {
+            ++m_keyframesPopped;
+        }
+        m_queuedBytes.fetch_sub(slot->size, std::memory_order_relaxed);
+        av_packet_unref(slot);
+        ++head;
+    }
+    m_head.store(head, std::memory_order_release);
+    notifyProducer();
+}
+
+int PacketRing::discardToLatestKeyframe()
+{
+    // 先读关键帧计数再读写位置，计数只会偏少，最多多保留一个较早的关键帧
+    qint64 queuedKeyframes = m_keyframesPushed.load(std::memory_order_acquire) - m_keyframesPopped;
+    quint64 head = m_head.load(std::memory_order_relaxed);
+    const quint64 tail = m_tail.load(std::memory_order_acquire);
+
+    // 流结束/不连续标记留给消费者处理：有标记时丢弃到第一个标记为止，
+    // 否则标记排在保留的GOP之后，暂停期间永远到不了队首
+    quint64 marker = tail;
+    for (quint64 pos = head; pos != tail; ++pos) {
+        const AVPacket *slot = m_slots[pos & m_mask];
+        if (slot->data == nullptr && slot->size == 0) {
+            marker = pos;
+            break;
+        }
+    }
+
+    int dropped = 0;
+    while (head != marker) {
+        AVPacket *slot = m_slots[head & m_mask];
+        if (slot->flags & AV_PKT_FLAG_KEY) {
+            if (marker == tail && queuedKeyframes <= 1) {
+                break;
+            }
+            --queuedKeyframes;
+            ++m_keyframesPopped;
+        }
+        m_queuedBytes.fetch_sub(slot->size, std::memory_order_relaxed);
+        av_packet_unref(slot);
+        ++head;
+        ++dropped;
+    }
+
+    if (dropped > 0) {
+        m_head.store(head, std::memory_order_release);
+        notifyProducer();
+    }
+    return dropped;
+}
+
+bool PacketRing::frontIsMarker() const
+{
+    const quint64 head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    const AVPacket *slot = m_slots[head & m_mask];
+    return slot->data == nullptr && slot->size == 0;
+}
+
+void PacketRing::wakeAll()
+{
+    QMutexLocker locker(&m_waitMutex);
+    m_dataAvailable.wakeAll();
+    m_spaceAvailable.wakeAll();
+}
+
+void PacketRing::setNotifier(std::function<void()> notifier)
+{
+    m_notifier = std::move(notifier);
+}
+
+void PacketRing::setLimits(const Limits &limits)
+{
+    m_limits = limits;
+    setTimeBase(m_timeBase);
+}
+
+void PacketRing::setTimeBase(AVRational timeBase)
+{
+    m_timeBase = timeBase;
+
+    // 时长限制换算为流时间基，时间基未知时不按时长限制
+    m_maxDuration = (m_limits.maxDurationMs > 0 && timeBase.num > 0 && timeBase.den > 0)
+                        ? av_rescale_q(m_limits.maxDurationMs, AVRational{1, 1000}, timeBase)
+                        : 0;
+}
+
+PacketRing::Stats PacketRing::stats() const
+{
+    Stats stats;
+    const quint64 head = m_head.load(std::memory_order_acquire);
+    const quint64 tail = m_tail.load(std::memory_order_acquire);
+    stats.packets = static_cast<int>(tail - head);
+    stats.bytes = m_queuedBytes.load(std::memory_order_relaxed);
+
+    if (head != tail && m_timeBase.num > 0) {
+        const int64_t oldest = m_timestamps[head & m_mask].load(std::memory_order_relaxed);
+        const int64_t newest = m_newestTimestamp.load(std::memory_order_relaxed);
+        if (oldest != AV_NOPTS_VALUE && newest != AV_NOPTS_VALUE && newest >= oldest) {
+            stats.durationMs = av_rescale_q(newest - oldest, m_timeBase, AVRational{1, 1000});
+        }
+    }
+
+    stats.droppedPackets = m_droppedPackets.load(std::memory_order_relaxed);
+    stats.droppedBytes = m_droppedBytes.load(std::memory_order_relaxed);
+    stats.dropEvents = m_dropEvents.load(std::memory_order_relaxed);
+    return stats;
+}
+
+int PacketRing::size() const
+{
+    const quint64 head = m_head.load(std::memory_order_acquire);
+    const quint64 tail = m_tail.load(std::memory_order_acquire);
+    return static_cast<int>(tail - head);
+}
+
+bool PacketRing::waitForData(int timeoutMs)
+{
+    if (timeoutMs <= 0) {
+        return false;
+    }
+
+    QDeadlineTimer deadline(timeoutMs);
+    QMutexLocker locker(&m_waitMutex);
+    while (isEmpty()) {
+        // 先声明等待再复查，与生产者的notifyConsumer构成Dekker式握手，避免丢失唤醒
+        m_consumerWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!isEmpty()) {
+            break;
+        }
+        if (!m_dataAvailable.wait(&m_waitMutex, deadline)) {
+            break;
+        }
+    }
+    m_consumerWaiting.store(false, std::memory_order_relaxed);
+    return !isEmpty();
+}
+
+bool PacketRing::waitForSpace(int timeoutMs)
+{
+    if (timeoutMs <= 0) {
+        return false;
+    }
+
+    QDeadlineTimer deadline(timeoutMs);
+    QMutexLocker locker(&m_waitMutex);
+    while (isFull()) {
+        m_producerWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!isFull()) {
+            break;
+        }
+        if (!m_spaceAvailable.wait(&m_waitMutex, deadline)) {
+            break;
+        }
+    }
+    m_producerWaiting.store(false, std::memory_order_relaxed);
+    return !isFull();
+}
+
+void PacketRing::notifyConsumer()
+{
+    if (m_notifier) {
+        m_notifier();
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_consumerWaiting.load(std::memory_order_relaxed)) {
+        QMutexLocker locker(&m_waitMutex);
+        m_dataAvailable.wakeOne();
+    }
+}
+
+void PacketRing::notifyProducer()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_producerWaiting.load(std::memory_order_relaxed)) {
+        QMutexLocker locker(&m_waitMutex);
+        m_spaceAvailable.wakeOne();
+    }
+}
@@ -0,0 +1,170 @@
+﻿#ifndef PACKETRING_H
+#define PACKETRING_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "DataStruct.h"
+
+/**
+ * @brief 拉流线程 -> 解码线程的单生产者/单消费者无锁包队列
+ *
+ * 槽位中的 AVPacket 在构造时一次性分配，入队时 av_packet_ref，出队时
+ * av_packet_move_ref，运行期间不再分配包结构。正常收发只走原子变量，
+ * 仅在队列空/满需要等待时才退化为互斥量+条件变量的阻塞等待。
+ * 空包（data == nullptr && size == 0）表示流结束；带 AV_PKT_FLAG_DISCARD 标志的空包
+ * 表示流不连续（重连），可附带新的编解码参数。
+ * 另外记录每个包的入队时间、最新入队包的时间戳与关键帧数量，供低延迟模式
+ * 计算排队时长并跳到最近的关键帧。
+ * 除槽位数外还可按字节数与排队时长限制容量，超限时由生产者按丢弃策略处理并计数。
+ */
+class PacketRing
+{
+public:
+    // 容量限制，0表示不限制
+    struct Limits {
+        qint64 maxBytes = 0;
+        int maxDurationMs = 0;
+    };
+
+    // 队列状态与丢弃统计
+    struct Stats {
+        int packets = 0;
+        qint64 bytes = 0;
+        qint64 durationMs = 0;
+        quint64 droppedPackets = 0;
+        qint64 droppedBytes = 0;
+        quint64 dropEvents = 0;         // 连续丢弃算一次
+    };
+
+    explicit PacketRing(int capacity = 256);
+    ~PacketRing();
+
+    PacketRing(const PacketRing &) = delete;
+    PacketRing &operator=(const PacketRing &) = delete;
+
+    // 生产者：引用packet入队，队列满时最多等待timeoutMs毫秒
+    bool push(const AVPacket *packet, int timeoutMs = 0);
+
+    // 生产者：写入流结束标记
+    bool pushEof(int timeoutMs = 0);
+
+    // 生产者：写入不连续标记（重连后），newParams非空表示编解码参数已变化，
+    // 消费者需按新参数重新打开解码器，否则只需刷新解码器
+    bool pushDiscontinuity(const AVCodecParameters *newParams, AVRational timeBase, int timeoutMs = 0);
+
+    // 消费者：取出不连续标记携带的新参数（调用方负责avcodec_parameters_free），无变化时返回nullptr
+    AVCodecParameters *takeCodecParameters(AVRational *timeBase);
+
+    static bool isEndOfStream(const AVPacket *packet);
+    static bool isDiscontinuity(const AVPacket *packet);
+
+    // 生产者：packet入队后是否仍在槽位数、字节数与时长限制内
+    bool canAccept(const AVPacket *packet) const;
+
+    // 生产者：记录一个被丢弃的包，newEvent表示开始新一轮丢弃
+    void recordDrop(const AVPacket *packet, bool newEvent);
+
+    // 消费者：出队到dst（dst必须为空包），队列空时最多等待timeoutMs毫秒
+    // arrivalUs非空时返回该包入队时刻（av_gettime_relative）
+    bool pop(AVPacket *dst, int timeoutMs = 0, int64_t *arrivalUs = nullptr);
+
+    // 消费者：dst为刚出队的包，若其与最新入队包的时间戳差（流时间基）超过maxDelay
+    // 且队列中有关键帧，则丢弃到该关键帧，dst替换为关键帧。返回丢弃的包数
+    int skipToKeyframe(AVPacket *dst, int64_t maxDelay, int64_t *arrivalUs = nullptr);
+
+    // 消费者：dst与最新入队包的时间戳差超过maxDelay时继续出队丢弃，直到差值不超过maxDelay、
+    // 队列只剩dst或遇到流结束/不连续标记为止。适用于每个包都可独立解码的音频，返回丢弃的包数
+    int skipToLatest(AVPacket *dst, int64_t maxDelay, int64_t *arrivalUs = nullptr);
+
+    // 消费者：队列中是否有关键帧
+    bool hasQueuedKeyframe() const;
+
+    // 消费者：丢弃所有排队的包
+    void clear();
+
+    // 消费者：丢弃到队列中最新的关键帧之前，只保留最近一个GOP；队列中有流结束/不连续标记时
+    // 改为丢弃到第一个标记之前，使标记到达队首。返回丢弃的包数。解码暂停时用于限制积压
+    int discardToLatestKeyframe();
+
+    // 消费者：队首是否为流结束或不连续标记
+    bool frontIsMarker() const;
+
+    // 消费者：阻塞等待数据到达，超时返回false
+    bool waitForData(int timeoutMs);
+
+    // 唤醒所有等待方（关闭时使用）
+    void wakeAll();
+
+    // 设置数据到达通知（线程池模式唤醒消费任务），仅在生产者停止时修改
+    void setNotifier(std::function<void()> notifier);
+
+    // 设置容量限制与包时间戳的时间基，仅在生产者停止时修改
+    void setLimits(const Limits &limits);
+    Limits limits() const { return m_limits; }
+    void setTimeBase(AVRational timeBase);
+
+    // 任意线程可调用，时长为近似值
+    Stats stats() const;
+
+    int size() const;
+    int capacity() const { return m_capacity; }
+    bool isEmpty() const { return size() == 0; }
+    bool isFull() const { return size() >= m_capacity; }
+
+private:
+    // packet为空时写入标记（markerFlags为0即流结束）
+    bool pushSlot(const AVPacket *packet, int markerFlags, int timeoutMs);
+    bool waitForSpace(int timeoutMs);
+    void notifyConsumer();
+    void notifyProducer();
+
+    // 包的解码顺序时间戳
+    static int64_t packetTimestamp(const AVPacket *packet);
+
+private:
+    std::vector<AVPacket*> m_slots;
+    std::vector<int64_t> m_arrivalUs;
+    std::unique_ptr<std::atomic<int64_t>[]> m_timestamps;   // 各槽位包的时间戳，统计时跨线程读取
+    int m_capacity = 0;
+    quint64 m_mask = 0;
+
+    // 读写位置分开缓存行，避免生产者与消费者伪共享
+    alignas(64) std::atomic<quint64> m_head{0};   // 消费者读位置
+    alignas(64) std::atomic<quint64> m_tail{0};   // 生产者写位置
+
+    // 生产者在发布写位置之后更新，消费者读到的关键帧都已可出队
+    std::atomic<qint64> m_keyframesPushed{0};
+    std::atomic<int64_t> m_newestTimestamp{AV_NOPTS_VALUE};
+    qint64 m_keyframesPopped = 0;                  // 仅消费者访问
+
+    // 容量限制
+    Limits m_limits;
+    AVRational m_timeBase{0, 1};
+    int64_t m_maxDuration = 0;                     // 流时间基
+    std::atomic<qint64> m_queuedBytes{0};
+
+    // 丢弃统计（生产者写）
+    std::atomic<quint64> m_droppedPackets{0};
+    std::atomic<qint64> m_droppedBytes{0};
+    std::atomic<quint64> m_dropEvents{0};
+
+    // 阻塞等待回退
+    std::atomic_bool m_consumerWaiting{false};
+    std::atomic_bool m_producerWaiting{false};
+    QMutex m_waitMutex;
+    QWaitCondition m_dataAvailable;
+    QWaitCondition m_spaceAvailable;
+
+    std::function<void()> m_notifier;
+
+    // 不连续标记携带的参数
+    QMutex m_paramsMutex;
+    AVCodecParameters *m_pendingParams = nullptr;
+    AVRational m_pendingTimeBase{0, 1};
+};
+
+#endif // PACKETRING_H
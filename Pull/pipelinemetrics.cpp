@@ -0,0 +1,149 @@
+﻿#include "pipelinemetrics.h"
+
+namespace {
+
+int bucketIndex(int64_t elapsedUs)
+{
+    int index = 0;
+    while (elapsedUs > 1 && index < PipelineMetrics::BucketCount - 1) {
+        elapsedUs >>= 1;
+        ++index;
+    }
+    return index;
+}
+
+} // namespace
+
+qint64 PipelineMetrics::StageSnapshot::percentileUs(double p) const
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    const quint64 target = static_cast<quint64>(qBound(0.0, p, 1.0) * count);
+    quint64 accumulated = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        accumulated += buckets[i];
+        if (accumulated > target) {
+            return qMin(qint64(1) << (i + 1), maxUs);
+        }
+    }
+    return maxUs;
+}
+
+PipelineMetrics::PipelineMetrics()
+{
+    m_startUs = av_gettime_relative();
+}
+
+void PipelineMetrics::record(Stage stage, int64_t elapsedUs)
+{
+    if (stage < 0 || stage >= StageCount) {
+        return;
+    }
+    if (elapsedUs < 0) {
+        elapsedUs = 0;
+    }
+
+    StageCounters &counters = m_stages[stage];
+    counters.count.fetch_add(1, std::memory_order_relaxed);
+    counters.totalUs.fetch_add(elapsedUs, std::memory_order_relaxed);
+    counters.buckets[bucketIndex(elapsedUs)].fetch_add(1, std::memory_order_relaxed);
+
+    qint64 currentMax = counters.maxUs.load(std::memory_order_relaxed);
+    while (elapsedUs > currentMax
+           && !counters.maxUs.compare_exchange_weak(currentMax, elapsedUs, std::memory_order_relaxed)) {
+    }
+}
+
+void PipelineMetrics::setAudioDeviceBuffer(int bufferedBytes, int bufferSize)
+{
+    m_audioDeviceBufferedBytes.store(bufferedBytes, std::memory_order_relaxed);
+    m_audioDeviceBufferSize.store(bufferSize, std::memory_order_relaxed);
+}
+
+PipelineMetrics::Snapshot PipelineMetrics::snapshot() const
+{
+    Snapshot snapshot;
+    for (int s = 0; s < StageCount; ++s) {
+        const StageCounters &counters = m_stages[s];
+        StageSnapshot &out = snapshot.stages[s];
+        out.count = counters.count.load(std::memory_order_relaxed);
+        out.totalUs = counters.totalUs.load(std::memory_order_relaxed);
+        out.maxUs = counters.maxUs.load(std::memory_order_relaxed);
+        for (int i = 0; i < BucketCount; ++i) {
+            out.buckets[i] = counters.buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    snapshot.elapsedMs = (av_gettime_relative() - m_startUs.load()) / 1000;
+    snapshot.videoFramesDecoded = m_videoFramesDecoded.load(std::memory_order_relaxed);
+    snapshot.videoFramesPresented = m_videoFramesPresented.load(std::memory_order_relaxed);
+    snapshot.videoFramesDropped = m_videoFramesDropped.load(std::memory_order_relaxed);
+    snapshot.audioFramesDecoded = m_audioFramesDecoded.load(std::memory_order_relaxed);
+    snapshot.audioDeviceBufferedBytes = m_audioDeviceBufferedBytes.load(std::memory_order_relaxed);
+    snapshot.audioDeviceBufferSize = m_audioDeviceBufferSize.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+void PipelineMetrics::reset()
+{
+    for (StageCounters &counters : m_stages) {
+        counters.count = 0;
+        counters.totalUs = 0;
+        counters.maxUs = 0;
+        for (auto &bucket : counters.buckets) {
+            bucket = 0;
+        }
+    }
+
+    m_videoFramesDecoded = 0;
+    m_videoFramesPresented = 0;
+    m_videoFramesDropped = 0;
+    m_audioFramesDecoded = 0;
+    m_startUs = av_gettime_relative();
+}
+
+const char *PipelineMetrics::stageName(Stage stage)
+{
+    switch (stage) {
+    case DemuxRead:         return "demux";
+    case VideoQueueWait:    return "vqueue";
+    case AudioQueueWait:    return "aqueue";
+    case VideoSendPacket:   return "vsend";
+    case VideoReceiveFrame: return "vreceive";
+    case AudioSendPacket:   return "asend";
+    case AudioReceiveFrame: return "areceive";
+    case VideoScale:        return "scale";
+    case AudioResample:     return "resample";
+    case Paint:             return "paint";
+    default:                return "unknown";
+    }
+}
+
+QString PipelineMetrics::format(const Snapshot &snapshot)
+{
+    QString text;
+    for (int s = 0; s < StageCount; ++s) {
+        const StageSnapshot &stage = snapshot.stages[s];
+        if (stage.count == 0) {
+            continue;
+        }
+        text += QString("%1 n=%2 avg=%3us p99=%4us max=%5us; ")
+                    .arg(stageName(static_cast<Stage>(s)))
+                    .arg(stage.count)
+                    .arg(stage.averageUs(), 0, 'f', 1)
+                    .arg(stage.percentileUs(0.99))
+                    .arg(stage.maxUs);
+    }
+
+    text += QString("queues v=%1(%2ms) a=%3(%4ms) dropped v=%5 a=%6; ")
+                .arg(snapshot.videoQueuePackets).arg(snapshot.videoQueueDurationMs)
+                .arg(snapshot.audioQueuePackets).arg(snapshot.audioQueueDurationMs)
+                .arg(snapshot.videoPacketsDropped).arg(snapshot.audioPacketsDropped);
+    text += QString("frames decoded=%1 presented=%2 dropped=%3 audio=%4; audio device %5%")
+                .arg(snapshot.videoFramesDecoded).arg(snapshot.videoFramesPresented)
+                .arg(snapshot.videoFramesDropped).arg(snapshot.audioFramesDecoded)
+                .arg(snapshot.audioDeviceFill() * 100.0, 0, 'f', 1);
+    return text;
+}
@@ -0,0 +1,150 @@
+﻿#ifndef PIPELINEMETRICS_H
+#define PIPELINEMETRICS_H
+
+#include <QString>
+#include <array>
+#include <atomic>
+#include "DataStruct.h"
+
+/**
+ * @brief 播放流水线各阶段的耗时与计数统计
+ *
+ * 每个阶段记录次数、累计/最大耗时和按2的幂分桶的耗时直方图，全部为原子变量，
+ * 拉流、解码、音频与界面线程可并发更新，不加锁；snapshot() 可在任意线程随时读取，
+ * 各字段分别原子读取，整体为近似一致的快照。
+ */
+class PipelineMetrics
+{
+public:
+    enum Stage {
+        DemuxRead,          // av_read_frame
+        VideoQueueWait,     // 视频包入队到出队
+        AudioQueueWait,     // 音频包入队到出队
+        VideoSendPacket,    // 视频 avcodec_send_packet
+        VideoReceiveFrame,  // 视频 avcodec_receive_frame（仅统计取到帧的调用）
+        AudioSendPacket,    // 音频 avcodec_send_packet
+        AudioReceiveFrame,  // 音频 avcodec_receive_frame（仅统计取到帧的调用）
+        VideoScale,         // sws_scale 转换与缩放
+        AudioResample,      // swr_convert
+        Paint,              // 画面绘制
+        StageCount
+    };
+
+    // 耗时直方图：第i个桶为[2^i, 2^(i+1))微秒，第0个桶含小于1微秒，最后一个桶不设上限
+    static constexpr int BucketCount = 22;
+
+    struct StageSnapshot {
+        quint64 count = 0;
+        qint64 totalUs = 0;
+        qint64 maxUs = 0;
+        std::array<quint64, BucketCount> buckets{};
+
+        double averageUs() const { return count > 0 ? double(totalUs) / count : 0.0; }
+        // 按直方图估算分位数（桶上界），p取0~1
+        qint64 percentileUs(double p) const;
+    };
+
+    struct Snapshot {
+        std::array<StageSnapshot, StageCount> stages;
+        qint64 elapsedMs = 0;           // 统计时长（自创建或上次reset）
+
+        // 队列深度（由会话在快照时填入）
+        int videoQueuePackets = 0;
+        int audioQueuePackets = 0;
+        qint64 videoQueueDurationMs = 0;
+        qint64 audioQueueDurationMs = 0;
+        quint64 videoPacketsDropped = 0;
+        quint64 audioPacketsDropped = 0;
+
+        // 帧计数
+        quint64 videoFramesDecoded = 0;
+        quint64 videoFramesPresented = 0;
+        quint64 videoFramesDropped = 0;   // 同步丢帧与低延迟跳帧
+        quint64 audioFramesDecoded = 0;
+
+        // 音频设备缓冲占用
+        int audioDeviceBufferedBytes = 0;
+        int audioDeviceBufferSize = 0;
+
+        const StageSnapshot &stage(Stage s) const { return stages[s]; }
+        double audioDeviceFill() const {
+            return audioDeviceBufferSize > 0
+                       ? double(audioDeviceBufferedBytes) / audioDeviceBufferSize : 0.0;
+        }
+    };
+
+    PipelineMetrics();
+
+    PipelineMetrics(const PipelineMetrics &) = delete;
+    PipelineMetrics &operator=(const PipelineMetrics &) = delete;
+
+    // 记录一次阶段耗时（微秒）
+    void record(Stage stage, int64_t elapsedUs);
+
+    // 帧计数
+    void addVideoFrameDecoded() { m_videoFramesDecoded.fetch_add(1, std::memory_order_relaxed); }
+    void addVideoFramePresented() { m_videoFramesPresented.fetch_add(1, std::memory_order_relaxed); }
+    void addVideoFramesDropped(int count) { m_videoFramesDropped.fetch_add(count, std::memory_order_relaxed); }
+    void addAudioFrameDecoded() { m_audioFramesDecoded.fetch_add(1, std::memory_order_relaxed); }
+
+    // 音频设备缓冲占用
+    void setAudioDeviceBuffer(int bufferedBytes, int bufferSize);
+
+    Snapshot snapshot() const;
+    void reset();
+
+    static const char *stageName(Stage stage);
+
+    // 单行文本摘要，便于日志输出
+    static QString format(const Snapshot &snapshot);
+
+private:
+    struct StageCounters {
+        std::atomic<quint64> count{0};
+        std::atomic<qint64> totalUs{0};
+        std::atomic<qint64> maxUs{0};
+        std::array<std::atomic<quint64>, BucketCount> buckets{};
+    };
+
+    std::array<StageCounters, StageCount> m_stages;
+    std::atomic<int64_t> m_startUs{0};
+
+    std::atomic<quint64> m_videoFramesDecoded{0};
+    std::atomic<quint64> m_videoFramesPresented{0};
+    std::atomic<quint64> m_videoFramesDropped{0};
+    std::atomic<quint64> m_audioFramesDecoded{0};
+
+    std::atomic<int> m_audioDeviceBufferedBytes{0};
+    std::atomic<int> m_audioDeviceBufferSize{0};
+};
+
+/**
+ * @brief 作用域计时：析构时记录到指定阶段，metrics为空时不计时
+ */
+class MetricTimer
+{
+public:
+    MetricTimer(PipelineMetrics *metrics, PipelineMetrics::Stage stage)
+        : m_metrics(metrics)
+        , m_stage(stage)
+        , m_startUs(metrics ? av_gettime_relative() : 0)
+    {
+    }
+
+    ~MetricTimer()
+    {
+        if (m_metrics) {
+            m_metrics->record(m_stage, av_gettime_relative() - m_startUs);
+        }
+    }
+
+    MetricTimer(const MetricTimer &) = delete;
+    MetricTimer &operator=(const MetricTimer &) = delete;
+
+private:
+    PipelineMetrics *m_metrics;
+    PipelineMetrics::Stage m_stage;
+    int64_t m_startUs;
+};
+
+#endif // PIPELINEMETRICS_H
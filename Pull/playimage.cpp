@@ -1,4 +1,7 @@
-﻿#include "playimage.h"
+﻿#define LOG_MODULE Logger::PlayerModule
+#include "playimage.h"
+#include "glvideorenderer.h"
+#include "pipelinemetrics.h"
 #include <QDebug>
 #include <QPainter>
 #include <QtMath>
@@ -27,21 +30,60 @@ PlayImage::PlayImage(QWidget *parent)
 }
 
 /**
- * @brief        FFMpegThread传入Qimage图片显示
+ * @brief        显示解码线程输出的RGBA帧
+ *               帧已按窗口尺寸缩放，QImage直接引用帧数据，不做拷贝
+ * @param frame
+ */
+void PlayImage::updateFrame(std::shared_ptr<AVFrame> frame)
+{
+    if(m_state == null)    return;
+    if(!frame) return;
+
+    // YUV帧交给GL组件直接渲染
+    if (m_glRenderer && GLVideoRenderer::isFormatSupported(frame->format)) {
+        if (m_glRenderer->isHidden()) {
+            m_glRenderer->setGeometry(rect());
+            m_glRenderer->show();
+            if (m_controlBar) {
+                m_controlBar->raise();
+            }
+        }
+        m_glRenderer->setFrame(std::move(frame));
+        return;
+    }
+
+    if (frame->format != AV_PIX_FMT_RGBA) return;
+    if (m_glRenderer && m_glRenderer->isVisible()) {
+        hideRenderer();
+    }
+
+    QImage image(frame->data[0], frame->width, frame->height,
+                 frame->linesize[0], QImage::Format_RGBA8888);
+    {
+        QMutexLocker locker(&m_mutex);
+        // 先替换图像再释放旧帧，保证图像始终引用有效数据
+        m_image = image;
+        m_frame = std::move(frame);
+        m_pixmap = QPixmap();
+    }
+    update();
+}
+
+/**
+ * @brief        传入QImage图片显示（隐式共享，不拷贝）
  * @param image
  */
 void PlayImage::updateImage(const QImage& image)
 {
     if(m_state == null)    return;
 
-    QSharedPointer<QImage> newImage = QSharedPointer<QImage>(new QImage(image.copy()));
-    if(!newImage.isNull()){
-        QSharedPointer<QPixmap> newPixmap = QSharedPointer<QPixmap>(new QPixmap(QPixmap::fromImage(*newImage.data())));
-        if(!newPixmap.isNull()){
-            updatePixmap(*newPixmap.data());
-        }
-
+    {
+        QMutexLocker locker(&m_mutex);
+        m_image = image;
+        m_frame.reset();
+        m_pixmap = QPixmap();
     }
+    update();
 }
 
 /**
@@ -53,10 +95,70 @@ void PlayImage::updatePixmap(const QPixmap &pixmap)
     {
         QMutexLocker locker(&m_mutex);
         m_pixmap = pixmap;
+        m_image = QImage();
+        m_frame.reset();
     }
     update();
 }
 
+void PlayImage::setRenderMode(RenderMode mode)
+{
+    if (mode == m_renderMode) return;
+
+    if (mode == OpenGLMode) {
+        m_glRenderer = new GLVideoRenderer(this);
+        m_glRenderer->setMetrics(m_metrics);
+        m_glRenderer->setGeometry(rect());
+        m_glRenderer->hide();
+        // 延迟处理，避免在initializeGL内部删除组件
+        connect(m_glRenderer, &GLVideoRenderer::initializeFailed,
+                this, &PlayImage::onRendererInitializeFailed, Qt::QueuedConnection);
+    } else if (m_glRenderer) {
+        m_glRenderer->deleteLater();
+        m_glRenderer = nullptr;
+    }
+
+    m_renderMode = mode;
+    emit renderModeChanged(m_renderMode);
+}
+
+PlayImage::RenderMode PlayImage::renderMode() const
+{
+    return m_renderMode;
+}
+
+void PlayImage::setMetrics(PipelineMetrics *metrics)
+{
+    m_metrics = metrics;
+    if (m_glRenderer) {
+        m_glRenderer->setMetrics(metrics);
+    }
+}
+
+void PlayImage::hideRenderer()
+{
+    if (m_glRenderer) {
+        m_glRenderer->clearFrame();
+        m_glRenderer->hide();
+    }
+}
+
+/**
+ * @brief        释放当前显示帧，缓冲立即回到帧池
+ */
+void PlayImage::releaseFrame()
+{
+    QMutexLocker locker(&m_mutex);
+    m_image = QImage();
+    m_frame.reset();
+}
+
+void PlayImage::onRendererInitializeFailed()
+{
+    LogWarn << "OpenGL渲染初始化失败，回退到QPainter绘制";
+    setRenderMode(RasterMode);
+}
+
 void PlayImage::onPlayState(PushState status,const QString &name)
 {
     if (name.isEmpty()) return;
@@ -66,6 +168,8 @@ void PlayImage::onPlayState(PushState status,const QString &name)
     switch (status) {
     case PushState::end:
         m_state = end;
+        hideRenderer();
+        releaseFrame();
         flushPlayState(0, name);
         StopTimer();
         update();  // 强制更新
@@ -78,12 +182,15 @@ void PlayImage::onPlayState(PushState status,const QString &name)
         break;
     case PushState::decode:
         m_state = decode;
+        hideRenderer();
         flushPlayState(1, name);
         InitTimer();
         update();  // 强制更新
         break;
     case PushState::error:
         m_state = error;
+        hideRenderer();
+        releaseFrame();
         flushPlayState(-1, name);
         StopTimer();
         update();  // 强制更新
@@ -142,14 +249,29 @@ void PlayImage::DrawPlayStatus()
     QPainter painter(this);
     painter.setRenderHint(QPainter::Antialiasing,true); // 设置反锯齿
     painter.setRenderHint(QPainter::TextAntialiasing,true); // 设置文本反锯齿
-    QPixmap pixmap;
-    {
-        QMutexLocker locker(&m_mutex);
-        pixmap = m_pixmap.scaled(this->size(), Qt::KeepAspectRatio);
+    QMutexLocker locker(&m_mutex);
+    if (!m_image.isNull()) {
+        // 解码线程已按窗口尺寸缩放，尺寸吻合时原样绘制；
+        // 窗口刚调整、新尺寸的帧还未到达时才由绘制过程临时缩放
+        QSize fitSize = m_image.size().scaled(this->size(), Qt::KeepAspectRatio);
+        if (qAbs(fitSize.width() - m_image.width()) <= 1
+                && qAbs(fitSize.height() - m_image.height()) <= 1) {
+            fitSize = m_image.size();
+        }
+        QRect target(QPoint((this->width() - fitSize.width()) / 2,
+                            (this->height() - fitSize.height()) / 2), fitSize);
+        if (fitSize == m_image.size()) {
+            painter.drawImage(target.topLeft(), m_image);
+        } else {
+            painter.drawImage(target, m_image);
+        }
+        return;
     }
-    int x = (this->width() - pixmap.width()) / 2;
-    int y = (this->height() - pixmap.height()) / 2;
-    painter.drawPixmap(x, y, pixmap);
+
+    QSize fitSize = m_pixmap.size().scaled(this->size(), Qt::KeepAspectRatio);
+    QRect target(QPoint((this->width() - fitSize.width()) / 2,
+                        (this->height() - fitSize.height()) / 2), fitSize);
+    painter.drawPixmap(target, m_pixmap);
 }
 
 void PlayImage::InitTimer()
@@ -235,7 +357,8 @@ void PlayImage::DrawErrorStatus()
  */
 void PlayImage::paintEvent(QPaintEvent *event)
 {
-    if (m_state == play && !m_pixmap.isNull()) {
+    if (m_state == play && (!m_image.isNull() || !m_pixmap.isNull())) {
+        MetricTimer timer(m_metrics, PipelineMetrics::Paint);
         DrawPlayStatus();
     } else if (m_state == null || m_state == end || m_state == error) {
         DrawNoPlayStatus();
@@ -258,6 +381,10 @@ void PlayImage::mouseDoubleClickEvent(QMouseEvent *event)
 void PlayImage::resizeEvent(QResizeEvent *event)
 {
     emit updatePlayWindowSize(this->geometry().size());//发出窗口大小改变信号
+    emit displaySizeChanged(this->size());
+    if (m_glRenderer) {
+        m_glRenderer->setGeometry(rect());
+    }
     updateControlBarPosition();
     QWidget::resizeEvent(event);
 }
@@ -338,6 +465,7 @@ void PlayImage::setupControlBar()
             emit closed();
             resetLabel();
             m_state = end;
+            hideRenderer();
             update();
         }
 
@@ -392,6 +520,8 @@ bool PlayImage::eventFilter(QObject *watched, QEvent *event)
 {
     if (event->type() == QEvent::MouseMove) {
         showControlBar();
+    } else if (event->type() == QEvent::WindowStateChange && watched == m_watchedWindow) {
+        updateVideoVisible();
     }
     return QWidget::eventFilter(watched, event);
 }
@@ -400,7 +530,53 @@ bool PlayImage::eventFilter(QObject *watched, QEvent *event)
 void PlayImage::showEvent(QShowEvent *event)
 {
     updateControlBarPosition();
+    watchWindow();
     QWidget::showEvent(event);
+    updateVideoVisible();
+}
+
+void PlayImage::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    updateVideoVisible();
+}
+
+bool PlayImage::isVideoVisible() const
+{
+    const QWidget *topLevel = window();
+    return isVisible() && !m_occluded && !(topLevel && topLevel->isMinimized());
+}
+
+void PlayImage::setOccluded(bool occluded)
+{
+    if (m_occluded == occluded) {
+        return;
+    }
+    m_occluded = occluded;
+    updateVideoVisible();
+}
+
+void PlayImage::updateVideoVisible()
+{
+    const bool visible = isVideoVisible();
+    if (visible != m_videoVisible) {
+        m_videoVisible = visible;
+        emit visibilityChanged(visible);
+    }
+}
+
+void PlayImage::watchWindow()
+{
+    // 最小化不会改变子控件的isVisible，需监听顶层窗口的状态变化；重新挂到其他窗口时切换监听对象
+    QWidget *topLevel = window();
+    if (topLevel == m_watchedWindow) {
+        return;
+    }
+    if (m_watchedWindow && m_watchedWindow != this) {
+        m_watchedWindow->removeEventFilter(this);
+    }
+    m_watchedWindow = topLevel;
+    m_watchedWindow->installEventFilter(this);
 }
 
 void PlayImage::setUrl(const QString &url)
@@ -10,6 +10,11 @@
 #include <QHBoxLayout>
 #include "DataStruct.h"
 #include <QTimer>
+#include <QPointer>
+#include <memory>
+
+class GLVideoRenderer;
+class PipelineMetrics;
 
 class PlayImage : public QWidget
 {
@@ -22,14 +27,33 @@ public:
         end,
         error
     };
+    // 渲染方式：QPainter绘制RGBA / OpenGL直接渲染YUV
+    enum RenderMode{
+        RasterMode,
+        OpenGLMode
+    };
     explicit PlayImage(QWidget *parent = nullptr);
 
+    // 设置渲染方式，OpenGL初始化失败时自动回退到RasterMode
+    void setRenderMode(RenderMode mode);
+    RenderMode renderMode() const;
+
+    // 设置流水线统计，记录绘制耗时，为空时不统计
+    void setMetrics(PipelineMetrics *metrics);
+
     bool isEnlarge() const;
+
+    // 画面是否可见：已显示、所在窗口未最小化且未被遮挡
+    bool isVideoVisible() const;
+    // 被其他画面遮挡（如画面墙中另一画面放大铺满时），由容器设置
+    void setOccluded(bool occluded);
     void setUrl(const QString &url);
     void setupControlBar();//设置浮动控制栏，支持放大和关闭
     void resetLabel();//重置标题
     void setStatus(const int state);//设置加载动画
 public slots:
+    // 直接显示解码线程输出的RGBA帧（零拷贝，持有帧引用直到下一帧）
+    void updateFrame(std::shared_ptr<AVFrame> frame);
     void updateImage(const QImage& image);
     void updatePixmap(const QPixmap& pixmap);
     void onPlayState(PushState status,const QString &name);
@@ -44,27 +68,47 @@ private:
     void updateControlBarPosition();
     void showControlBar();
     void hideControlBar();
+    void hideRenderer();
+    void releaseFrame();
+    void onRendererInitializeFailed();
+    void updateVideoVisible();
+    void watchWindow();
 signals:
     void flushPlayState(int state,QString objName);
     void updatePlayWindowSize(const QSize &size);
+    // 显示区域尺寸变化，解码线程据此确定输出尺寸
+    void displaySizeChanged(const QSize &size);
+    // 渲染方式变化（含OpenGL失败回退）
+    void renderModeChanged(PlayImage::RenderMode mode);
     void enlargePlayWindow(const QString &objectName,const bool &isEnlarge);
+    // 可见性变化（显示/隐藏、窗口最小化/还原、遮挡），解码线程据此暂停或恢复解码
+    void visibilityChanged(bool visible);
     void closed();
 protected:
     void enterEvent(QEvent *event) override;
     void leaveEvent(QEvent *event) override;
     bool eventFilter(QObject *watched, QEvent *event) override;
     void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
     void paintEvent(QPaintEvent *event) override;
     void mouseDoubleClickEvent(QMouseEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
 
 private:
     QPixmap m_pixmap;
-    QImage m_image;
+    QImage m_image;                      // 引用m_frame数据的图像，不拷贝
+    std::shared_ptr<AVFrame> m_frame;    // 当前显示帧
     QMutex m_mutex;
     State m_state = null;
     bool m_isFirst = true;
     bool m_isEnlarge = false;//界面是否扩大
+    bool m_occluded = false;             // 被其他画面遮挡
+    bool m_videoVisible = false;         // 最近一次通知的可见性
+    QPointer<QWidget> m_watchedWindow;   // 监听最小化的顶层窗口
+
+    RenderMode m_renderMode = RasterMode;
+    GLVideoRenderer *m_glRenderer = nullptr;
+    PipelineMetrics *m_metrics = nullptr;
 
     QWidget *m_controlBar = nullptr;
     QLabel *m_urlLabel = nullptr;
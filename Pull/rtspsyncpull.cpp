@@ -1,11 +1,20 @@
-﻿#include "rtspsyncpull.h"
+﻿#define LOG_MODULE Logger::PullModule
+#include "rtspsyncpull.h"
 #include "streampullthread.h"
 #include "audiodecodethread.h"
 #include "videodecodethread.h"
 #include "audioplayer.h"
 #include "playimage.h"
+#include "packetring.h"
+#include "decodescheduler.h"
 #include "Logger.h"
-#include <QImage>
+
+namespace {
+
+// 重新开始播放时，缓存超过该时长的关键帧不再作为首帧预览
+const int kPreviewMaxAgeMs = 30000;
+
+} // namespace
 
 RTSPSyncPull::RTSPSyncPull(QObject *parent)
     : QObject{parent}
@@ -13,18 +22,42 @@ RTSPSyncPull::RTSPSyncPull(QObject *parent)
     , m_audioDecodeThread(nullptr)
     , m_videoDecodeThread(nullptr)
     , m_audioPlayer(nullptr)
-    , m_videoOutput(nullptr)
-    , m_audioClock(0)
-    , m_videoClock(0)
 {
     // 创建线程对象
     m_pullThread = new StreamPullThread(this);
-    m_pullThread->setHardwareDecoding(false);
     m_audioDecodeThread = new AudioDecodeThread(this);
 
     m_videoDecodeThread = new VideoDecodeThread(this);
-    m_videoDecodeThread->setTargetSize(QSize(1280, 720));
+    m_videoDecodeThread->setSyncEngine(&m_syncEngine);
     m_audioPlayer = new AudioPlayer(this);
+
+    // 各阶段写入同一份统计
+    m_pullThread->setMetrics(&m_metrics);
+    m_videoDecodeThread->setMetrics(&m_metrics);
+    m_audioDecodeThread->setMetrics(&m_metrics);
+    m_audioPlayer->setMetrics(&m_metrics);
+
+    // 拉流线程直接写入解码线程的包队列
+    m_pullThread->setPacketRings(m_videoDecodeThread->packetRing(),
+                                 m_audioDecodeThread->packetRing());
+
+    // 暂停后恢复解码时由拉流线程重放缓存的GOP
+    StreamPullThread *pullThread = m_pullThread;
+    m_videoDecodeThread->setGopReplayHandler([pullThread]() {
+        pullThread->requestGopReplay();
+    });
+
+    // 默认队列上限：视频32MB/3秒，音频1MB/3秒
+    PacketRing::Limits videoLimits;
+    videoLimits.maxBytes = 32 * 1024 * 1024;
+    videoLimits.maxDurationMs = 3000;
+    setVideoQueueLimits(videoLimits);
+
+    PacketRing::Limits audioLimits;
+    audioLimits.maxBytes = 1024 * 1024;
+    audioLimits.maxDurationMs = 3000;
+    setAudioQueueLimits(audioLimits);
+
     // 连接信号槽
     connectSignals();
 }
@@ -32,9 +65,14 @@ RTSPSyncPull::RTSPSyncPull(QObject *parent)
 RTSPSyncPull::~RTSPSyncPull()
 {
     stop();
+    for (const VideoOutputEntry &entry : m_videoOutputs) {
+        if (entry.view) {
+            entry.view->setMetrics(nullptr);
+        }
+    }
 }
 
-void RTSPSyncPull::start(const QString &rtspUrl)
+void RTSPSyncPull::start(const QString &rtspUrl, LatencyProfile profile)
 {
     if (rtspUrl.isEmpty()) {
         emit errorOccurred("RTSP URL 不能为空");
@@ -47,13 +85,56 @@ void RTSPSyncPull::start(const QString &rtspUrl)
     emit stateChanged(PushState::decode,this->objectName());
     // 设置拉流参数
     m_pullThread->setTimeout(3000); // 10秒超时
-    m_pullThread->setHardwareDecoding(true); // 启用硬件解码
 
-    // 打开RTSP流
+    // 延迟配置需在打开流和初始化解码器之前设置
+    m_profile = profile;
+    const bool lowLatency = (profile == LiveLowLatency);
+    m_pullThread->setLowLatency(lowLatency);
+    m_videoDecodeThread->setLowLatency(lowLatency, m_targetLatencyMs);
+    m_videoDecodeThread->setHardwareDecoding(m_hardwareDecoding);
+    m_videoDecodeThread->setHardwareDeviceTypes(m_hwDeviceTypes);
+    m_audioDecodeThread->setTargetLatency(lowLatency ? m_targetLatencyMs : 0);
+    if (lowLatency) {
+        LogInfo << "Live low-latency profile, target latency " << m_targetLatencyMs << "ms";
+    }
+
+    // 输出方式需在初始化播放器和启动解码之前确定；极速空视频不经过同步等待
+    const bool maxSpeed = (m_sinkPace == MaxSpeedPace);
+    m_audioPlayer->setDeviceMode(!m_nullAudio ? AudioPlayer::DefaultDevice
+                                 : maxSpeed ? AudioPlayer::NullMaxSpeed
+                                            : AudioPlayer::NullRealtime);
+    m_videoDecodeThread->setNullOutput(m_nullVideo);
+    m_videoDecodeThread->setSyncEngine(m_nullVideo && maxSpeed ? nullptr : &m_syncEngine);
+
+    // 每次播放重新建立时钟
+    m_syncEngine.reset();
+
+    // 上次stop断开了信号，重新连接
+    if (!m_signalsConnected) {
+        connectSignals();
+    }
+
+    // 异步打开RTSP流，连接成功后在onStreamOpened中初始化解码与播放
+    m_decodersReady = false;
+
+    // 线程池模式下解码注册为调度任务，需在拉流线程开始写包之前设置好唤醒回调
+    if (m_scheduler) {
+        startScheduledTasks(rtspUrl);
+    }
+
     if (!m_pullThread->open(rtspUrl)) {
+        stopScheduledTasks();
         emit errorOccurred("无法打开RTSP流: " + rtspUrl);
         return;
     }
+}
+
+void RTSPSyncPull::onStreamOpened()
+{
+    // 打开期间已被stop
+    if (!m_signalsConnected) {
+        return;
+    }
 
     // 初始化解码器
     if (!initializeDecoders()) {
@@ -72,10 +153,26 @@ void RTSPSyncPull::start(const QString &rtspUrl)
 
     emit stateChanged(PushState::play,this->objectName());
 
-    // 启动线程
-    m_pullThread->start();
-    m_audioDecodeThread->start();
-    m_videoDecodeThread->start();
+    // 没有的媒体视为已结束
+    m_videoEnded = m_pullThread->videoStreamIndex() < 0;
+    m_audioEnded = m_pullThread->audioStreamIndex() < 0;
+
+    // 启动解码（线程池模式下唤醒已注册的解码任务）
+    if (m_scheduler) {
+        m_audioDecodeThread->startExternal();
+        m_videoDecodeThread->startExternal();
+        m_decodersReady = true;
+        if (m_videoTask) {
+            m_videoTask->notify();
+        }
+        if (m_audioTask) {
+            m_audioTask->notify();
+        }
+    } else {
+        m_decodersReady = true;
+        m_audioDecodeThread->start();
+        m_videoDecodeThread->start();
+    }
     m_audioPlayer->start();
 
     emit playbackStarted();
@@ -87,7 +184,7 @@ void RTSPSyncPull::stop()
     // 断开信号连接
     disconnectSignals();
 
-    // 停止线程
+    // 先停拉流线程，不再写包和调用队列的唤醒回调
     if (m_pullThread) {
         m_pullThread->close();
         if (m_pullThread->isRunning()) {
@@ -96,6 +193,10 @@ void RTSPSyncPull::stop()
         }
     }
 
+    // 再移除调度任务，确保close时不再有工作线程执行step
+    stopScheduledTasks();
+    m_decodersReady = false;
+
     if (m_audioDecodeThread) {
         m_audioDecodeThread->close();
         if (m_audioDecodeThread->isRunning()) {
@@ -118,9 +219,7 @@ void RTSPSyncPull::stop()
     }
 
     // 重置时钟
-    QMutexLocker locker(&m_clockMutex);
-    m_audioClock = 0;
-    m_videoClock = 0;
+    m_syncEngine.reset();
 
     emit playbackStopped();
 }
@@ -135,10 +234,8 @@ void RTSPSyncPull::pause()
         m_audioDecodeThread->setPaused(true);
     }
 
-    if (m_videoDecodeThread) {
-        // 视频解码线程需要实现暂停功能
-        // m_videoDecodeThread->setPaused(true);
-    }
+    // 冻结时钟，视频帧停在当前位置等待
+    m_syncEngine.setPaused(true);
 }
 
 void RTSPSyncPull::resume()
@@ -151,21 +248,226 @@ void RTSPSyncPull::resume()
         m_audioDecodeThread->setPaused(false);
     }
 
-    if (m_videoDecodeThread) {
-        // 视频解码线程需要实现恢复功能
-//         m_videoDecodeThread->setPaused(false);
-    }
+    m_syncEngine.setPaused(false);
 }
 
 void RTSPSyncPull::setVideoOutput(PlayImage *videoOutput)
 {
-    m_videoOutput = videoOutput;
+    addVideoOutput(videoOutput);
+}
+
+void RTSPSyncPull::addVideoOutput(PlayImage *videoOutput)
+{
+    if (!videoOutput) {
+        return;
+    }
+    for (const VideoOutputEntry &entry : m_videoOutputs) {
+        if (entry.view == videoOutput) {
+            return;
+        }
+    }
+
+    // 解码输出尺寸跟随显示区域，缩放只在解码线程做一次；
+    // OpenGL渲染时解码线程跳过RGBA转换，直接输出YUV帧
+    VideoOutputEntry entry;
+    entry.view = videoOutput;
+    entry.outputId = m_videoDecodeThread->addOutput(
+        videoOutput->size(), videoOutput->renderMode() == PlayImage::OpenGLMode);
+    m_videoOutputs.append(entry);
+
+    videoOutput->setMetrics(&m_metrics);
     this->setObjectName("Plauer");
-    connect(this,&RTSPSyncPull::stateChanged,m_videoOutput,&PlayImage::onPlayState);
+    connect(this,&RTSPSyncPull::stateChanged,videoOutput,&PlayImage::onPlayState);
+
+    const int outputId = entry.outputId;
+    VideoDecodeThread *decoder = m_videoDecodeThread;
+    connect(videoOutput, &PlayImage::displaySizeChanged,
+            this, [decoder, outputId](const QSize &size) {
+                decoder->setOutputTargetSize(outputId, size);
+            }, Qt::DirectConnection);
+    connect(videoOutput, &PlayImage::renderModeChanged,
+            this, [decoder, outputId](PlayImage::RenderMode mode) {
+                decoder->setOutputYuvPassthrough(outputId, mode == PlayImage::OpenGLMode);
+            });
+
+    // 放大时立即恢复全画质、全帧率解码，不等窗口尺寸变化
+    setOutputEnlarged(outputId, videoOutput->isEnlarge());
+    connect(videoOutput, &PlayImage::enlargePlayWindow,
+            this, [this, outputId](const QString &, const bool &isEnlarge) {
+                setOutputEnlarged(outputId, isEnlarge);
+            });
+
+    // 隐藏、最小化或被遮挡时暂停该输出，所有输出都不可见时解码线程停止解码
+    decoder->setOutputVisible(outputId, videoOutput->isVideoVisible());
+    connect(videoOutput, &PlayImage::visibilityChanged,
+            this, [decoder, outputId](bool visible) {
+                decoder->setOutputVisible(outputId, visible);
+            }, Qt::DirectConnection);
+
+    // 显示组件先于会话销毁时自动移除
+    connect(videoOutput, &QObject::destroyed, this, [this, outputId]() {
+        for (int i = 0; i < m_videoOutputs.size(); ++i) {
+            if (m_videoOutputs[i].outputId == outputId) {
+                m_videoDecodeThread->removeOutput(outputId);
+                m_videoOutputs.removeAt(i);
+                updateKeyframeOnly();
+                break;
+            }
+        }
+    });
+
+    // 已在播放时把当前画面尺寸告诉新的显示组件
+    const QSize videoSize = m_videoDecodeThread->videoSize();
+    if (videoSize.isValid() && !videoSize.isEmpty()) {
+        emit videoOutput->updatePlayWindowSize(videoSize);
+    }
+}
+
+void RTSPSyncPull::removeVideoOutput(PlayImage *videoOutput)
+{
+    for (int i = 0; i < m_videoOutputs.size(); ++i) {
+        if (m_videoOutputs[i].view == videoOutput) {
+            m_videoDecodeThread->removeOutput(m_videoOutputs[i].outputId);
+            m_videoOutputs.removeAt(i);
+            updateKeyframeOnly();
+            break;
+        }
+    }
+
+    if (videoOutput) {
+        disconnect(videoOutput, nullptr, this, nullptr);
+        disconnect(this, nullptr, videoOutput, nullptr);
+        videoOutput->setMetrics(nullptr);
+    }
+}
+
+void RTSPSyncPull::setNullAudioOutput(bool enable)
+{
+    m_nullAudio = enable;
+}
+
+void RTSPSyncPull::setNullVideoOutput(bool enable)
+{
+    m_nullVideo = enable;
+}
+
+void RTSPSyncPull::setSinkPace(SinkPace pace)
+{
+    m_sinkPace = pace;
+}
+
+void RTSPSyncPull::setDecodeThreads(int threadCount, int threadType)
+{
+    m_videoDecodeThread->setDecodeThreads(threadCount, threadType);
+}
+
+DecodeThreadingPolicy::Settings RTSPSyncPull::decodeThreads() const
+{
+    return m_videoDecodeThread->decodeThreads();
+}
+
+void RTSPSyncPull::setHardwareDecoding(bool enable, const QList<AVHWDeviceType> &deviceTypes)
+{
+    m_hardwareDecoding = enable;
+    m_hwDeviceTypes = deviceTypes;
+}
+
+void RTSPSyncPull::setKeyframeOnly(bool enable)
+{
+    m_keyframeOnly = enable;
+    updateKeyframeOnly();
+}
+
+void RTSPSyncPull::setOutputEnlarged(int outputId, bool enlarged)
+{
+    for (VideoOutputEntry &entry : m_videoOutputs) {
+        if (entry.outputId == outputId) {
+            entry.enlarged = enlarged;
+        }
+    }
+    m_videoDecodeThread->setOutputFullQuality(outputId, enlarged);
+    updateKeyframeOnly();
+}
+
+void RTSPSyncPull::updateKeyframeOnly()
+{
+    // 任一显示组件放大（操作员关注该画面）时恢复全帧率
+    bool enlarged = false;
+    for (const VideoOutputEntry &entry : m_videoOutputs) {
+        enlarged = enlarged || entry.enlarged;
+    }
+
+    const bool keyframeOnly = m_keyframeOnly && !enlarged;
+    m_pullThread->setVideoKeyframeOnly(keyframeOnly);
+    m_videoDecodeThread->setKeyframeOnly(keyframeOnly);
+}
+
+void RTSPSyncPull::setTileAwareDecoding(bool enable)
+{
+    m_videoDecodeThread->setTileAwareDecoding(enable);
+}
+
+QString RTSPSyncPull::videoDecoderName() const
+{
+    return m_videoDecodeThread->activeDecoderName();
+}
+
+void RTSPSyncPull::setScheduler(DecodeScheduler *scheduler)
+{
+    if (m_videoTask || m_audioTask) {
+        LogWarn << "Cannot change scheduler while playing";
+        return;
+    }
+    m_scheduler = scheduler;
+}
+
+void RTSPSyncPull::startScheduledTasks(const QString &name)
+{
+    // 拉流始终在独立线程中进行（读包会阻塞到超时），调度器只执行解码；
+    // 解码器在流打开后才就绪，之前保持挂起
+    m_videoTask = m_scheduler->addTask(name + " video", [this]() {
+        return m_decodersReady ? m_videoDecodeThread->step() : StepResult::idle();
+    });
+    m_audioTask = m_scheduler->addTask(name + " audio", [this]() {
+        return m_decodersReady ? m_audioDecodeThread->step() : StepResult::idle();
+    });
+
+    // 包入队时唤醒对应的解码任务，需在拉流线程启动前设置
+    std::weak_ptr<PipelineTask> videoTask = m_videoTask;
+    m_videoDecodeThread->packetRing()->setNotifier([videoTask]() {
+        if (auto task = videoTask.lock()) {
+            task->notify();
+        }
+    });
+    std::weak_ptr<PipelineTask> audioTask = m_audioTask;
+    m_audioDecodeThread->packetRing()->setNotifier([audioTask]() {
+        if (auto task = audioTask.lock()) {
+            task->notify();
+        }
+    });
+}
+
+void RTSPSyncPull::stopScheduledTasks()
+{
+    if (!m_scheduler) {
+        return;
+    }
+
+    m_scheduler->removeTask(m_videoTask);
+    m_scheduler->removeTask(m_audioTask);
+    m_videoTask.reset();
+    m_audioTask.reset();
+
+    m_videoDecodeThread->packetRing()->setNotifier(nullptr);
+    m_audioDecodeThread->packetRing()->setNotifier(nullptr);
 }
 
 void RTSPSyncPull::handleAudioDecoded(std::shared_ptr<AVFrame> frame) {
-    if (!frame) return;
+    // 空帧表示音频解码结束
+    if (!frame) {
+        markMediaEnded(false);
+        return;
+    }
 
     // 首次收到音频帧时确保播放器已启动
     static bool firstFrame = true;
@@ -174,25 +476,42 @@ void RTSPSyncPull::handleAudioDecoded(std::shared_ptr<AVFrame> frame) {
         firstFrame = false;
     }
 
-    // 更新时钟和发送帧...
-    if (frame->pts != AV_NOPTS_VALUE) {
-        QMutexLocker locker(&m_clockMutex);
-        m_audioClock = frame->pts;
-        qDebug() << "[AUDIO] pts:" << frame->pts << "ms";
-    }
-
+    // 音频时钟由播放器按实际播放位置更新
     if (m_audioPlayer) {
         m_audioPlayer->onAudioFrameReady(frame);
     }
 }
 
-void RTSPSyncPull::handleVideoDecoded(const QImage &image)
+void RTSPSyncPull::handleVideoDecoded(int outputId, std::shared_ptr<AVFrame> frame)
 {
-    if (image.isNull()) return;
+    // 空帧表示视频解码结束
+    if (!frame) {
+        markMediaEnded(true);
+        return;
+    }
 
-    // 将视频帧显示到界面
-    if (m_videoOutput) {
-        m_videoOutput->updateImage(image);
+    // 将视频帧显示到对应的界面（已移除的输出残留在队列中的帧直接丢弃）
+    for (const VideoOutputEntry &entry : m_videoOutputs) {
+        if (entry.outputId == outputId) {
+            if (entry.view) {
+                entry.view->updateFrame(std::move(frame));
+            }
+            return;
+        }
+    }
+}
+
+void RTSPSyncPull::markMediaEnded(bool video)
+{
+    bool &ended = video ? m_videoEnded : m_audioEnded;
+    if (ended) {
+        return;
+    }
+    ended = true;
+
+    if (m_videoEnded && m_audioEnded) {
+        LogInfo << "Playback finished: " << this->objectName();
+        emit playbackFinished();
     }
 }
 
@@ -200,9 +519,9 @@ bool RTSPSyncPull::initializeDecoders()
 {
     // 初始化音频解码器
     if (m_pullThread->audioStreamIndex() >= 0) {
-        AVCodecParameters* audioParams = m_pullThread->audioCodecParameters();
+        std::shared_ptr<AVCodecParameters> audioParams = m_pullThread->audioCodecParameters();
         if (audioParams) {
-            if (!m_audioDecodeThread->init(audioParams)) {
+            if (!m_audioDecodeThread->init(audioParams.get(), m_pullThread->audioTimeBase())) {
                 LogErr << "音频解码器初始化失败";
                 return false;
             }
@@ -224,19 +543,23 @@ bool RTSPSyncPull::initializeDecoders()
 
     // 初始化视频解码器
     if (m_pullThread->videoStreamIndex() >= 0) {
-        AVCodecParameters* videoParams = m_pullThread->videoCodecParameters();
+        std::shared_ptr<AVCodecParameters> videoParams = m_pullThread->videoCodecParameters();
         if (videoParams) {
-            if (!m_videoDecodeThread->init(videoParams)) {
+            if (!m_videoDecodeThread->init(videoParams.get(), m_pullThread->videoTimeBase())) {
                 LogErr << "视频解码器初始化失败";
                 return false;
             }
 
-            // 启用硬件解码
-            m_videoDecodeThread->setHardwareDecoding(false);
+            // 按各显示组件的当前尺寸输出
+            for (const VideoOutputEntry &entry : m_videoOutputs) {
+                if (entry.view) {
+                    m_videoDecodeThread->setOutputTargetSize(entry.outputId, entry.view->size());
+                }
+            }
 
-            // 设置目标尺寸（可选）
-            if (m_videoOutput) {
-                m_videoDecodeThread->setTargetSize(m_videoOutput->size());
+            // 同一路源重新开始播放时先解码缓存的关键帧，不必等摄像机的下一个关键帧才出画面
+            if (!m_nullVideo) {
+                m_videoDecodeThread->setPreviewPacket(m_pullThread->cachedVideoKeyframe(kPreviewMaxAgeMs));
             }
         }
     }
@@ -257,8 +580,12 @@ bool RTSPSyncPull::initializeAudioPlayer()
 
     LogInfo << "初始化音频播放器: " << sampleRate << "Hz, " << channels << "ch";
 
-    // 增加缓冲区大小，改善播放稳定性
-    m_audioPlayer->setMaxBufferSize(6144);
+    // 增加缓冲时长，改善播放稳定性；低延迟模式按目标延迟限制
+    if (m_profile == LiveLowLatency) {
+        m_audioPlayer->setMaxBufferMs(qMax(80, m_targetLatencyMs));
+    } else {
+        m_audioPlayer->setMaxBufferMs(2000);
+    }
 
     // 使用正确的采样率初始化音频播放器
     if (!m_audioPlayer->initialize(sampleRate, channels, 16)) {
@@ -266,50 +593,64 @@ bool RTSPSyncPull::initializeAudioPlayer()
         return false;
     }
 
+    m_audioPlayer->setTimeBase(m_pullThread->audioTimeBase());
     m_audioPlayer->setVolume(0.5f);
+
+    // 解码线程重采样后直接写入播放器的环形缓冲，不再逐帧经过事件队列
+    m_audioDecodeThread->setAudioOutput(m_audioPlayer);
     LogInfo << "音频播放器初始化成功";
     return true;
 }
 
 void RTSPSyncPull::connectSignals()
 {
-    // 拉流线程信号连接
-    connect(m_pullThread, &StreamPullThread::videoPacketReady,
-            m_videoDecodeThread, &VideoDecodeThread::onVideoPacketReceived,
+    // 拉流线程信号连接（数据包经由包队列传递，不走信号）
+    connect(m_pullThread, &StreamPullThread::errorOccurred,
+            this, &RTSPSyncPull::errorOccurred,
             Qt::QueuedConnection);
 
-    connect(m_pullThread, &StreamPullThread::audioPacketReady,
-            m_audioDecodeThread, &AudioDecodeThread::onAudioPacketReceived,
+    // 连接与重连状态
+    connect(m_pullThread, &StreamPullThread::opened,
+            this, &RTSPSyncPull::onStreamOpened,
             Qt::QueuedConnection);
 
-    connect(m_pullThread, &StreamPullThread::errorOccurred,
-            this, &RTSPSyncPull::errorOccurred,
+    connect(m_pullThread, &StreamPullThread::connectionLost,
+        this, [this](const QString &reason) {
+            LogWarn << "连接中断: " << reason;
+            emit stateChanged(PushState::decode, this->objectName());
+        }, Qt::QueuedConnection);
+
+    connect(m_pullThread, &StreamPullThread::reconnecting,
+            this, &RTSPSyncPull::reconnecting,
             Qt::QueuedConnection);
 
+    connect(m_pullThread, &StreamPullThread::reconnected,
+        this, [this](bool codecChanged) {
+            LogInfo << "重连成功" << (codecChanged ? "，解码器已按新参数重建" : "");
+            emit stateChanged(PushState::play, this->objectName());
+            emit reconnected();
+        }, Qt::QueuedConnection);
+
     connect(m_pullThread, &StreamPullThread::streamInfoReady,
         this, [this](int width, int height, double frameRate) {
             LogInfo << QString("流信息: %1x%2 @%3fps")
                            .arg(width).arg(height).arg(frameRate);
-            if (m_videoOutput) {
-                emit m_videoOutput->updatePlayWindowSize(QSize(width, height));
+            for (const VideoOutputEntry &entry : m_videoOutputs) {
+                if (entry.view) {
+                    emit entry.view->updatePlayWindowSize(QSize(width, height));
+                }
             }
             if(m_videoDecodeThread){
                 m_videoDecodeThread->setFrameRate(frameRate);
             }
         }, Qt::QueuedConnection);
 
-    // 音频解码线程信号连接
+    // 解码线程信号连接
     qRegisterMetaType<std::shared_ptr<AVFrame>>("std::shared_ptr<AVFrame>");
     connect(m_audioDecodeThread, &AudioDecodeThread::audioFrameDecoded,
             this, &RTSPSyncPull::handleAudioDecoded,
             Qt::QueuedConnection);
 
-    connect(m_audioDecodeThread, &AudioDecodeThread::audioClockUpdated,
-        this, [this](qint64 pts) {
-            QMutexLocker locker(&m_clockMutex);
-            m_audioClock = pts;
-        }, Qt::QueuedConnection);
-
     connect(m_audioDecodeThread, &AudioDecodeThread::errorOccurred,
             this, &RTSPSyncPull::errorOccurred,
             Qt::QueuedConnection);
@@ -334,16 +675,13 @@ void RTSPSyncPull::connectSignals()
             this, &RTSPSyncPull::errorOccurred,
             Qt::QueuedConnection);
 
+    // 播放位置直接写入同步引擎（线程安全），不经过事件队列以免引入额外延迟
     connect(m_audioPlayer, &AudioPlayer::audioClockUpdated,
         this, [this](qint64 pts) {
-            QMutexLocker locker(&m_clockMutex);
-            m_audioClock = pts;
-            // 通知视频解码线程音频时钟更新
-            if (m_videoDecodeThread) {
-                LogDebug << "pts："<<pts;
-                m_videoDecodeThread->updateAudioClock(pts);
-            }
-        }, Qt::QueuedConnection);
+            m_syncEngine.updateAudioClock(pts / 1000.0);
+        }, Qt::DirectConnection);
+
+    m_signalsConnected = true;
 }
 
 void RTSPSyncPull::disconnectSignals()
@@ -351,8 +689,6 @@ void RTSPSyncPull::disconnectSignals()
     // 断开所有信号连接
     if (m_pullThread) {
         disconnect(m_pullThread, nullptr, this, nullptr);
-        disconnect(m_pullThread, nullptr, m_audioDecodeThread, nullptr);
-        disconnect(m_pullThread, nullptr, m_videoDecodeThread, nullptr);
     }
 
     if (m_audioDecodeThread) {
@@ -368,18 +704,90 @@ void RTSPSyncPull::disconnectSignals()
         disconnect(m_audioPlayer, nullptr, this, nullptr);
         disconnect(m_audioPlayer, nullptr, m_videoDecodeThread, nullptr);
     }
+
+    m_signalsConnected = false;
 }
 
 qint64 RTSPSyncPull::getAudioClock()
 {
-    QMutexLocker locker(&m_clockMutex);
-    return m_audioClock;
+    double clock = m_syncEngine.audioClock();
+    return std::isnan(clock) ? 0 : static_cast<qint64>(clock * 1000.0);
 }
 
 qint64 RTSPSyncPull::getVideoClock()
 {
-    QMutexLocker locker(&m_clockMutex);
-    return m_videoClock;
+    double clock = m_syncEngine.videoClock();
+    return std::isnan(clock) ? 0 : static_cast<qint64>(clock * 1000.0);
+}
+
+void RTSPSyncPull::setSyncMaster(AVSyncEngine::MasterClock master)
+{
+    m_syncEngine.setMasterClock(master);
+}
+
+AVSyncEngine::MasterClock RTSPSyncPull::syncMaster() const
+{
+    return m_syncEngine.masterClock();
+}
+
+AVSyncEngine::Stats RTSPSyncPull::syncStats() const
+{
+    return m_syncEngine.stats();
+}
+
+void RTSPSyncPull::setTargetLatency(int latencyMs)
+{
+    m_targetLatencyMs = qMax(0, latencyMs);
+}
+
+VideoDecodeThread::LatencyStats RTSPSyncPull::latencyStats() const
+{
+    return m_videoDecodeThread->latencyStats();
+}
+
+void RTSPSyncPull::setVideoQueueLimits(const PacketRing::Limits &limits)
+{
+    m_videoDecodeThread->packetRing()->setLimits(limits);
+}
+
+void RTSPSyncPull::setAudioQueueLimits(const PacketRing::Limits &limits)
+{
+    m_audioDecodeThread->packetRing()->setLimits(limits);
+}
+
+void RTSPSyncPull::setGopCacheLimit(qint64 maxBytes)
+{
+    m_pullThread->setGopCacheLimit(maxBytes);
+}
+
+PacketRing::Stats RTSPSyncPull::videoQueueStats() const
+{
+    return m_videoDecodeThread->packetRing()->stats();
+}
+
+PacketRing::Stats RTSPSyncPull::audioQueueStats() const
+{
+    return m_audioDecodeThread->packetRing()->stats();
+}
+
+PipelineMetrics::Snapshot RTSPSyncPull::metrics() const
+{
+    PipelineMetrics::Snapshot snapshot = m_metrics.snapshot();
+
+    const PacketRing::Stats videoQueue = videoQueueStats();
+    const PacketRing::Stats audioQueue = audioQueueStats();
+    snapshot.videoQueuePackets = videoQueue.packets;
+    snapshot.videoQueueDurationMs = videoQueue.durationMs;
+    snapshot.videoPacketsDropped = videoQueue.droppedPackets;
+    snapshot.audioQueuePackets = audioQueue.packets;
+    snapshot.audioQueueDurationMs = audioQueue.durationMs;
+    snapshot.audioPacketsDropped = audioQueue.droppedPackets;
+    return snapshot;
+}
+
+void RTSPSyncPull::resetMetrics()
+{
+    m_metrics.reset();
 }
 
 bool RTSPSyncPull::isPlaying() const
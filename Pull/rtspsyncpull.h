@@ -3,32 +3,121 @@
 
 #include <QObject>
 #include <QMutex>
+#include <QPointer>
+#include <atomic>
 #include <memory>
 #include "DataStruct.h"
+#include "avsyncengine.h"
+#include "videodecodethread.h"
+#include "packetring.h"
+#include "pipelinemetrics.h"
 
 class PlayImage;
 class StreamPullThread;
 class AudioDecodeThread;
-class VideoDecodeThread;
 class AudioPlayer;
+class DecodeScheduler;
+class PipelineTask;
 
 class RTSPSyncPull : public QObject
 {
     Q_OBJECT
 public:
+    // 播放配置
+    enum LatencyProfile {
+        StandardLatency,    // 平滑优先
+        LiveLowLatency      // 延迟优先：最小探测、不缓存、超过目标延迟跳到关键帧
+    };
+
+    // 空输出的消费节奏
+    enum SinkPace {
+        RealtimePace,       // 按时间戳实时消费，与正常播放的调度一致
+        MaxSpeedPace        // 不等待时钟，解码多快消费多快（压测吞吐）
+    };
+
     explicit RTSPSyncPull(QObject *parent = nullptr);
     ~RTSPSyncPull();
 
-    void start(const QString &rtspUrl);
+    // 异步启动：连接成功后发出playbackStarted，断线时自动重连
+    void start(const QString &rtspUrl, LatencyProfile profile = StandardLatency);
     void stop();
     void pause();
     void resume();
+
+    // 添加/移除显示组件：同一路流解码一次，按各显示组件的尺寸与渲染方式分别输出
+    void addVideoOutput(PlayImage *videoOutput);
+    void removeVideoOutput(PlayImage *videoOutput);
+    int videoOutputCount() const { return m_videoOutputs.size(); }
+
+    // 兼容旧接口，等同于addVideoOutput
     void setVideoOutput(PlayImage *videoOutput);
 
-    // 获取时钟信息
+    // 使用共享线程池调度解码（需在start前设置，拉流始终在独立线程），为空时解码也使用独立线程
+    void setScheduler(DecodeScheduler *scheduler);
+
+    // 空音频/视频输出（需在start前设置）：不打开声卡、不绘制，拉流→解码→同步照常运行并计入统计，
+    // 用于无声卡、无显示的录像/分析节点与无头压测
+    void setNullAudioOutput(bool enable);
+    void setNullVideoOutput(bool enable);
+
+    // 空输出的消费节奏（需在start前设置），对声卡与PlayImage输出无效
+    void setSinkPace(SinkPace pace);
+
+    // 本路视频解码线程数，threadCount<0 时按全局 DecodeThreadingPolicy 分配（默认）；
+    // 播放中修改在下一个关键帧生效
+    void setDecodeThreads(int threadCount, int threadType = FF_THREAD_FRAME | FF_THREAD_SLICE);
+    DecodeThreadingPolicy::Settings decodeThreads() const;
+
+    // 硬件解码（默认开启，下次start生效）：按deviceTypes顺序尝试，为空时使用平台默认顺序，
+    // 全部不可用或运行中出错时回退到软件解码
+    void setHardwareDecoding(bool enable, const QList<AVHWDeviceType> &deviceTypes = QList<AVHWDeviceType>());
+
+    // 实际使用的视频解码方式（硬件设备类型名或 "software"）
+    QString videoDecoderName() const;
+
+    // 按显示尺寸降低解码画质（默认开启），画面放大或变大时自动恢复
+    void setTileAwareDecoding(bool enable);
+
+    // 预览模式：视频只拉取、解码关键帧（约每GOP一帧），用于上百路的画面墙；
+    // 任一显示组件放大时自动恢复全帧率，缩小后回到预览。可随时切换
+    void setKeyframeOnly(bool enable);
+    bool isKeyframeOnly() const { return m_keyframeOnly; }
+
+    // 获取时钟信息（流PTS，毫秒）
     qint64 getAudioClock() ;
     qint64 getVideoClock() ;
 
+    // 音视频同步主时钟，默认以音频为准
+    void setSyncMaster(AVSyncEngine::MasterClock master);
+    AVSyncEngine::MasterClock syncMaster() const;
+
+    // 同步偏差与丢帧统计
+    AVSyncEngine::Stats syncStats() const;
+
+    // 低延迟模式的目标延迟（毫秒，下次start生效）
+    void setTargetLatency(int latencyMs);
+    int targetLatency() const { return m_targetLatencyMs; }
+
+    // 实际延迟统计（数据包入队到画面发出）
+    VideoDecodeThread::LatencyStats latencyStats() const;
+
+    // 解码包队列的字节数与时长上限（需在start前设置）；
+    // 超限时视频丢弃到下一个关键帧，音频丢弃整包
+    void setVideoQueueLimits(const PacketRing::Limits &limits);
+    void setAudioQueueLimits(const PacketRing::Limits &limits);
+
+    // 视频GOP缓存的字节上限（默认8MB，0为关闭）：保留最近一个关键帧起的视频包，
+    // 重新开始播放时立即显示缓存的关键帧，暂停解码后恢复时从缓存的GOP解码
+    void setGopCacheLimit(qint64 maxBytes);
+
+    // 队列占用与丢弃统计
+    PacketRing::Stats videoQueueStats() const;
+    PacketRing::Stats audioQueueStats() const;
+
+    // 流水线各阶段耗时、队列深度与帧计数快照（任意线程可调用）
+    PipelineMetrics::Snapshot metrics() const;
+    void resetMetrics();
+
     // 获取播放状态
     bool isPlaying() const;
 
@@ -36,11 +125,20 @@ signals:
     void errorOccurred(const QString &error);
     void playbackStarted();
     void playbackStopped();
+    // 本地文件等有限输入已播放到结尾（各路媒体均已解码完毕）
+    void playbackFinished();
+    // 断线后等待delayMs毫秒进行第attempt次重连
+    void reconnecting(int attempt, int delayMs);
+    void reconnected();
     void stateChanged(PushState state,const QString &objName);
 
 public slots:
     void handleAudioDecoded(std::shared_ptr<AVFrame> frame);
-    void handleVideoDecoded(const QImage& image);
+    void handleVideoDecoded(int outputId, std::shared_ptr<AVFrame> frame);
+
+private slots:
+    // 流已打开，初始化解码器与播放器并开始播放
+    void onStreamOpened();
 
 private:
     // 初始化方法
@@ -51,17 +149,61 @@ private:
     void connectSignals();
     void disconnectSignals();
 
+    // 某路媒体解码到结尾，全部结束时发出playbackFinished
+    void markMediaEnded(bool video);
+
+    // 显示组件放大状态变化，更新解码画质与仅关键帧模式
+    void setOutputEnlarged(int outputId, bool enlarged);
+    void updateKeyframeOnly();
+
+    // 线程池模式下注册/移除本路流的解码任务
+    void startScheduledTasks(const QString &name);
+    void stopScheduledTasks();
+
 private:
     StreamPullThread *m_pullThread;      // 拉流线程
     AudioDecodeThread *m_audioDecodeThread; // 音频解码线程
     VideoDecodeThread *m_videoDecodeThread; // 视频解码线程
     AudioPlayer *m_audioPlayer;          // 音频播放器
-    PlayImage *m_videoOutput;            // 视频显示组件
+
+    // 视频显示组件及其在解码线程中的输出序号
+    struct VideoOutputEntry {
+        QPointer<PlayImage> view;
+        int outputId = 0;
+        bool enlarged = false;
+    };
+    QList<VideoOutputEntry> m_videoOutputs;
+
+    // 线程池调度
+    DecodeScheduler *m_scheduler = nullptr;
+    std::shared_ptr<PipelineTask> m_videoTask;
+    std::shared_ptr<PipelineTask> m_audioTask;
+    std::atomic_bool m_decodersReady{false};
+    bool m_signalsConnected = false;
+    bool m_videoEnded = false;
+    bool m_audioEnded = false;
 
     // 同步控制
-    qint64 m_audioClock = 0;             // 音频时钟 (主时钟)
-    qint64 m_videoClock = 0;             // 视频时钟
-    QMutex m_clockMutex;
+    AVSyncEngine m_syncEngine;
+
+    // 流水线统计
+    PipelineMetrics m_metrics;
+
+    // 输出方式
+    bool m_nullAudio = false;
+    bool m_nullVideo = false;
+    SinkPace m_sinkPace = RealtimePace;
+
+    // 硬件解码
+    bool m_hardwareDecoding = true;
+    QList<AVHWDeviceType> m_hwDeviceTypes;
+
+    // 预览模式（只解码关键帧）
+    bool m_keyframeOnly = false;
+
+    // 延迟配置
+    LatencyProfile m_profile = StandardLatency;
+    int m_targetLatencyMs = 300;
 
 };
 
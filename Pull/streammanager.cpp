@@ -0,0 +1,135 @@
+﻿#define LOG_MODULE Logger::PullModule
+#include "streammanager.h"
+#include "decodescheduler.h"
+#include <Logger.h>
+
+StreamManager::StreamManager(int threadCount, QObject *parent)
+    : QObject{parent}
+    , m_scheduler(std::make_unique<DecodeScheduler>(threadCount))
+{
+
+}
+
+StreamManager::~StreamManager()
+{
+    // 流必须先于线程池销毁
+    stopAll();
+}
+
+RTSPSyncPull *StreamManager::addStream(const QString &url, PlayImage *videoOutput,
+                                       RTSPSyncPull::LatencyProfile profile)
+{
+    // 已打开的URL共享会话，只增加显示输出
+    auto it = m_registry.find(url);
+    if (it != m_registry.end()) {
+        it->refCount++;
+        if (profile != it->profile) {
+            LogWarn << "Stream " << url << " already opened with latency profile "
+                    << it->profile << ", requested profile " << profile << " ignored";
+        }
+        if (videoOutput) {
+            it->stream->addVideoOutput(videoOutput);
+        }
+        LogInfo << "Stream shared: " << url << ", viewers " << it->refCount;
+        return it->stream;
+    }
+
+    RTSPSyncPull *stream = new RTSPSyncPull(this);
+    stream->setScheduler(m_scheduler.get());
+    if (videoOutput) {
+        stream->addVideoOutput(videoOutput);
+    }
+
+    // 流异步打开，连接失败时自动重连，错误只转发不移除
+    connect(stream, &RTSPSyncPull::errorOccurred,
+            this, [this, url](const QString &error) {
+                emit errorOccurred(url, error);
+            });
+
+    stream->start(url, profile);
+
+    SharedStream shared;
+    shared.stream = stream;
+    shared.profile = profile;
+    shared.refCount = 1;
+    m_registry.insert(url, shared);
+    m_streams.append(stream);
+    LogInfo << "Stream added: " << url << ", total " << m_streams.size();
+    emit streamCountChanged(m_streams.size());
+    return stream;
+}
+
+void StreamManager::removeViewer(const QString &url, PlayImage *videoOutput)
+{
+    auto it = m_registry.find(url);
+    if (it == m_registry.end()) {
+        return;
+    }
+
+    RTSPSyncPull *stream = it->stream;
+    if (videoOutput) {
+        stream->removeVideoOutput(videoOutput);
+    }
+    if (--it->refCount > 0) {
+        LogInfo << "Stream viewer removed: " << url << ", viewers " << it->refCount;
+        return;
+    }
+
+    // 最后一个观看者，停止拉流与解码
+    m_registry.erase(it);
+    m_streams.removeOne(stream);
+    releaseStream(stream);
+    LogInfo << "Stream closed: " << url << ", total " << m_streams.size();
+    emit streamCountChanged(m_streams.size());
+}
+
+void StreamManager::removeStream(RTSPSyncPull *stream)
+{
+    if (!stream || !m_streams.removeOne(stream)) {
+        return;
+    }
+
+    for (auto it = m_registry.begin(); it != m_registry.end(); ++it) {
+        if (it->stream == stream) {
+            m_registry.erase(it);
+            break;
+        }
+    }
+
+    releaseStream(stream);
+    emit streamCountChanged(m_streams.size());
+}
+
+RTSPSyncPull *StreamManager::stream(const QString &url) const
+{
+    auto it = m_registry.constFind(url);
+    return it != m_registry.constEnd() ? it->stream : nullptr;
+}
+
+int StreamManager::viewerCount(const QString &url) const
+{
+    auto it = m_registry.constFind(url);
+    return it != m_registry.constEnd() ? it->refCount : 0;
+}
+
+void StreamManager::releaseStream(RTSPSyncPull *stream)
+{
+    stream->stop();
+    stream->deleteLater();
+}
+
+void StreamManager::stopAll()
+{
+    if (m_streams.isEmpty()) {
+        return;
+    }
+
+    const QList<RTSPSyncPull*> streams = m_streams;
+    m_streams.clear();
+    m_registry.clear();
+    for (RTSPSyncPull *stream : streams) {
+        stream->stop();
+        delete stream;
+    }
+    emit streamCountChanged(0);
+}
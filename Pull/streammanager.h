@@ -0,0 +1,74 @@
+﻿#ifndef STREAMMANAGER_H
+#define STREAMMANAGER_H
+
+#include <QObject>
+#include <QList>
+#include <QHash>
+#include <memory>
+#include "rtspsyncpull.h"
+
+class PlayImage;
+class DecodeScheduler;
+
+/**
+ * @brief 多路流管理
+ *
+ * 持有一组 RTSPSyncPull 会话，所有会话的解码共享一个固定大小的工作窃取线程池，
+ * 解码线程数与流数量无关（64路画面也只占用CPU核数个工作线程）。读包会阻塞到网络超时，
+ * 每路流的拉流仍在各自的读包线程中进行，只写入包队列。
+ * 会话按URL登记：同一URL再次添加时复用已有会话（一路RTSP连接、一次解码），
+ * 只把新的显示组件加入其输出列表，各显示组件按自己的尺寸输出；
+ * 会话按观看者计数，最后一个观看者移除时停止并释放。
+ */
+class StreamManager : public QObject
+{
+    Q_OBJECT
+public:
+    // threadCount <= 0 时使用CPU核数
+    explicit StreamManager(int threadCount = 0, QObject *parent = nullptr);
+    ~StreamManager();
+
+    // 添加一个观看者：URL未打开时新建会话并开始异步连接播放，已打开时共享该会话；
+    // videoOutput可为空（只计数不显示）。连接错误通过errorOccurred通知。
+    // 共享时沿用会话创建时的延迟配置，profile与之不同时忽略并告警
+    RTSPSyncPull *addStream(const QString &url, PlayImage *videoOutput,
+                            RTSPSyncPull::LatencyProfile profile = RTSPSyncPull::StandardLatency);
+
+    // 移除一个观看者，会话没有其他观看者时停止并释放
+    void removeViewer(const QString &url, PlayImage *videoOutput);
+
+    // 停止并移除一路流（不论观看者数量）
+    void removeStream(RTSPSyncPull *stream);
+
+    // 已打开的会话，未打开时返回nullptr
+    RTSPSyncPull *stream(const QString &url) const;
+    int viewerCount(const QString &url) const;
+
+    // 停止并移除所有流
+    void stopAll();
+
+    int streamCount() const { return m_streams.size(); }
+    const QList<RTSPSyncPull*> &streams() const { return m_streams; }
+    DecodeScheduler *scheduler() const { return m_scheduler.get(); }
+
+signals:
+    void streamCountChanged(int count);
+    void errorOccurred(const QString &url, const QString &error);
+
+private:
+    struct SharedStream {
+        RTSPSyncPull *stream = nullptr;
+        RTSPSyncPull::LatencyProfile profile = RTSPSyncPull::StandardLatency;
+        int refCount = 0;
+    };
+
+    // 释放一路会话（已从登记中移除）
+    void releaseStream(RTSPSyncPull *stream);
+
+private:
+    std::unique_ptr<DecodeScheduler> m_scheduler;
+    QList<RTSPSyncPull*> m_streams;
+    QHash<QString, SharedStream> m_registry;
+};
+
+#endif // STREAMMANAGER_H
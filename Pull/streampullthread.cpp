@@ -1,8 +1,66 @@
-﻿#include "streampullthread.h"
+﻿#define LOG_MODULE Logger::PullModule
+#include "streampullthread.h"
+#include "packetring.h"
+#include "pipelinemetrics.h"
 #include <QElapsedTimer>
 #include <QCoreApplication>
+#include <cstring>
 #include <Logger.h>
 
+namespace {
+
+// 重连退避：首次0.5秒，逐次翻倍，最长30秒
+constexpr int kReconnectBaseDelayMs = 500;
+constexpr int kReconnectMaxDelayMs = 30000;
+
+// 允许的最大连续读错误数
+constexpr int kMaxConsecutiveErrors = 50;
+
+std::shared_ptr<AVCodecParameters> copyCodecParameters(const AVCodecParameters *src)
+{
+    AVCodecParameters *params = avcodec_parameters_alloc();
+    if (!params) {
+        return nullptr;
+    }
+    if (avcodec_parameters_copy(params, src) < 0) {
+        avcodec_parameters_free(&params);
+        return nullptr;
+    }
+    return std::shared_ptr<AVCodecParameters>(params, [](AVCodecParameters *p) {
+        avcodec_parameters_free(&p);
+    });
+}
+
+bool sameExtradata(const AVCodecParameters *a, const AVCodecParameters *b)
+{
+    if (a->extradata_size != b->extradata_size) {
+        return false;
+    }
+    return a->extradata_size == 0
+           || memcmp(a->extradata, b->extradata, a->extradata_size) == 0;
+}
+
+// 解码器能否继续沿用：编码、尺寸/采样参数与头信息均未变化
+bool sameCodecParameters(const AVCodecParameters *a, const AVCodecParameters *b)
+{
+    if (a->codec_id != b->codec_id || a->format != b->format || !sameExtradata(a, b)) {
+        return false;
+    }
+    if (a->codec_type == AVMEDIA_TYPE_VIDEO) {
+        return a->width == b->width && a->height == b->height;
+    }
+    return a->sample_rate == b->sample_rate && a->channels == b->channels;
+}
+
+QString errorString(int errnum)
+{
+    char error[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(errnum, error, sizeof(error));
+    return QString::fromUtf8(error);
+}
+
+} // namespace
+
 StreamPullThread::StreamPullThread(QObject *parent)
     : QThread{parent}
 {
@@ -17,41 +75,51 @@ StreamPullThread::~StreamPullThread()
 //    avformat_network_deinit();
 }
 
-bool StreamPullThread::open(const QString &url, int timeoutMs)
+bool StreamPullThread::open(const QString &url)
 {
     if (m_running) {
         LogWarn << "StreamPullThread is already running";
         return true;
     }
 
-    m_timeoutMs = timeoutMs;
-
-    // 打开输入流
-    if (!openInput(url)) {
-        cleanup();
-        LogErr << "打开输入流失败";
+    m_readPacket = av_packet_alloc();
+    if (!m_readPacket) {
+        emit errorOccurred("Failed to allocate packet");
         return false;
     }
 
-    // 查找流信息
-    if (!findStreamInfo()) {
-        cleanup();
-        LogErr << "查找流信息失败";
-        return false;
+    // 换了地址，缓存的画面不再有用
+    if (url != m_url) {
+        m_gopCache.clear();
     }
 
-    // 启动线程
+    m_url = url;
+    m_state = Connecting;
+    m_everOpened = false;
+    m_reconnectAttempt = 0;
+    m_endOfStream = false;
+    m_videoMarker = PendingMarker();
+    m_audioMarker = PendingMarker();
+    {
+        QMutexLocker locker(&m_mutex);
+        m_videoParams.reset();
+        m_audioParams.reset();
+        m_videoTimeBase = AVRational{0, 1};
+        m_audioTimeBase = AVRational{0, 1};
+    }
+
+    // 连接与读包都在拉流线程中进行（线程池模式下也是，调度器只驱动解码）
     m_running = true;
     start();
 
     return true;
-
 }
 
 void StreamPullThread::close()
 {
     if (!m_running) return;
 
+    // 中断回调检测到m_running为false后立即中止阻塞中的网络操作
     m_running = false;
 
     // 等待线程结束
@@ -76,82 +144,345 @@ void StreamPullThread::setTimeout(int timeoutMs)
     m_timeoutMs = timeoutMs;
 }
 
-AVCodecParameters* StreamPullThread::videoCodecParameters() const
+void StreamPullThread::setLowLatency(bool enable)
+{
+    m_lowLatency = enable;
+}
+
+void StreamPullThread::setVideoKeyframeOnly(bool enable)
+{
+    m_videoKeyframeOnly = enable;
+}
+
+void StreamPullThread::setGopCacheLimit(qint64 maxBytes)
+{
+    m_gopCache.setMaxBytes(maxBytes);
+}
+
+std::shared_ptr<AVPacket> StreamPullThread::cachedVideoKeyframe(int maxAgeMs) const
+{
+    return m_gopCache.previewKeyframe(maxAgeMs);
+}
+
+void StreamPullThread::requestGopReplay()
+{
+    m_gopReplayRequested = true;
+}
+
+void StreamPullThread::setAutoReconnect(bool enable)
+{
+    m_autoReconnect = enable;
+}
+
+void StreamPullThread::setPacketRings(PacketRing *videoRing, PacketRing *audioRing)
 {
-    if (m_videoStreamIndex >= 0 && m_formatContext) {
-        return m_formatContext->streams[m_videoStreamIndex]->codecpar;
+    m_videoRing = videoRing;
+    m_audioRing = audioRing;
+}
+
+void StreamPullThread::setMetrics(PipelineMetrics *metrics)
+{
+    m_metrics = metrics;
+}
+
+std::shared_ptr<AVCodecParameters> StreamPullThread::videoCodecParameters() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_videoParams;
+}
+
+std::shared_ptr<AVCodecParameters> StreamPullThread::audioCodecParameters() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_audioParams;
+}
+
+AVRational StreamPullThread::videoTimeBase() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_videoTimeBase;
+}
+
+AVRational StreamPullThread::audioTimeBase() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_audioTimeBase;
+}
+
+void StreamPullThread::run()
+{
+    while (m_running) {
+        StepResult result = step();
+        if (result.status == StepResult::Finished) {
+            break;
+        }
+        if (result.status == StepResult::Wait) {
+            QThread::msleep(static_cast<unsigned long>(result.waitMs));
+        }
+    }
+}
+
+StepResult StreamPullThread::step()
+{
+    if (!m_running || !m_readPacket) {
+        return StepResult::finished();
+    }
+
+    // 流结束标记未写完
+    if (m_endOfStream) {
+        return finishStream();
+    }
+
+    switch (m_state) {
+    case Connecting:
+        return stepConnect();
+    case Backoff: {
+        // 分段等待，便于及时响应关闭
+        const int64_t remainingUs = m_reconnectAtUs - av_gettime_relative();
+        if (remainingUs > 0) {
+            return StepResult::wait(static_cast<int>(qMin<int64_t>(remainingUs / 1000 + 1, 100)));
+        }
+        m_state = Connecting;
+        return StepResult::progress();
+    }
+    case Streaming:
+        break;
     }
-    return nullptr;
+
+    return stepRead();
 }
 
-AVCodecParameters* StreamPullThread::audioCodecParameters() const
+StepResult StreamPullThread::stepConnect()
 {
-    if (m_audioStreamIndex >= 0 && m_formatContext) {
-        return m_formatContext->streams[m_audioStreamIndex]->codecpar;
+    if (!openInput(m_url) || !findStreamInfo()) {
+        closeInput();
+        return scheduleReconnect(m_everOpened ? "Reconnect failed" : "Failed to open input");
+    }
+
+    const bool reconnect = m_everOpened;
+    const bool codecChanged = updateStreamParameters(reconnect);
+
+    // GOP缓存按连接分段，编解码参数变化后旧内容无法解码
+    if (m_videoStreamIndex >= 0) {
+        std::shared_ptr<AVCodecParameters> params =
+            copyCodecParameters(m_formatContext->streams[m_videoStreamIndex]->codecpar);
+        std::shared_ptr<AVCodecParameters> cached = m_gopCache.codecParameters();
+        if (!params || !cached || !sameCodecParameters(cached.get(), params.get())) {
+            m_gopCache.clear();
+        }
+        m_gopCache.beginSession(params);
+    } else {
+        m_gopCache.clear();
     }
-    return nullptr;
+
+    m_consecutiveErrors = 0;
+    m_dropVideoUntilKeyframe = false;
+    m_droppingAudio = false;
+    m_localInput = !isNetworkInput();
+    m_packetHeld = false;
+    m_appliedVideoDiscard = -1;
+    m_lastPacketUs = av_gettime_relative();
+
+    m_state = Streaming;
+    if (reconnect) {
+        LogInfo << "Reconnected to " << m_url << " after " << m_reconnectAttempt
+                << " attempts" << (codecChanged ? ", codec parameters changed" : "");
+        m_reconnectAttempt = 0;
+        emit reconnected(codecChanged);
+    } else {
+        m_everOpened = true;
+        m_reconnectAttempt = 0;
+        emit opened();
+    }
+    return StepResult::progress();
 }
 
-void StreamPullThread::run()
+StepResult StreamPullThread::stepRead()
 {
-    AVPacket *packet = av_packet_alloc();
-    if (!packet) {
-        emit errorOccurred("Failed to allocate packet");
-        return;
+    // 重连的不连续标记需在新连接的数据包之前入队，队列满时稍后重试
+    if (!flushMarkers()) {
+        return StepResult::wait(5);
+    }
+
+    // 本地输入：上次读出的包因队列超限暂存，先重新尝试入队
+    if (m_packetHeld) {
+        if (!processPacket(m_readPacket)) {
+            return StepResult::wait(5);
+        }
+        m_packetHeld = false;
+        av_packet_unref(m_readPacket);
     }
 
-    // 增加错误计数器
-    int consecutiveErrors = 0;
-    const int maxConsecutiveErrors = 50; // 允许的最大连续错误数
+    // 背压：视频包队列已满时暂不读取，等待解码消费
+    if (m_videoRing && m_videoStreamIndex >= 0 && m_videoRing->isFull()) {
+        m_lastPacketUs = av_gettime_relative();
+        return StepResult::wait(10);
+    }
 
-    while (m_running) {
-        int ret = av_read_frame(m_formatContext, packet);
-        if (ret < 0) {
-            // 处理读取结束或错误
-            if (ret == AVERROR_EOF) {
-                LogInfo << "End of stream reached";
-                break;
+    if (m_gopReplayRequested.exchange(false)) {
+        replayGop();
+    }
+
+    // 仅关键帧模式切换后更新视频流的discard
+    if (m_videoStreamIndex >= 0) {
+        const int discard = m_videoKeyframeOnly ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+        if (discard != m_appliedVideoDiscard) {
+            // 解复用器跳过的非关键帧不在缓存中，当前GOP到此不再连续
+            if (m_appliedVideoDiscard == AVDISCARD_NONKEY) {
+                m_gopCache.markGap();
             }
-            // 增加错误计数
-            consecutiveErrors++;
+            m_formatContext->streams[m_videoStreamIndex]->discard = static_cast<AVDiscard>(discard);
+            m_appliedVideoDiscard = discard;
+        }
+    }
 
-            if (consecutiveErrors > maxConsecutiveErrors) {
-                emit errorOccurred("Too many consecutive read errors");
-                break;
+    armDeadline();
+    const int64_t readStartUs = av_gettime_relative();
+    int ret = av_read_frame(m_formatContext, m_readPacket);
+    if (ret >= 0 && m_metrics) {
+        m_metrics->record(PipelineMetrics::DemuxRead, av_gettime_relative() - readStartUs);
+    }
+    if (ret < 0) {
+        // 部分输入（如采集设备）暂无数据时返回EAGAIN，超过超时时间仍无数据视为断线
+        if (ret == AVERROR(EAGAIN)) {
+            if (av_gettime_relative() - m_lastPacketUs > int64_t(m_timeoutMs) * 1000) {
+                return handleConnectionLost("Read timeout");
             }
-            continue;
+            return StepResult::wait(5);
+        }
+        // 中断回调触发（读包超时）
+        if (ret == AVERROR_EXIT) {
+            return handleConnectionLost("Read timeout");
         }
-        // 重置错误计数器
-        consecutiveErrors = 0;
-        // 处理数据包
-        processPacket(packet);
+        // 处理读取结束或错误：网络流意外结束按断线处理
+        if (ret == AVERROR_EOF) {
+            if (isNetworkInput() && m_autoReconnect) {
+                return handleConnectionLost("Stream ended unexpectedly");
+            }
+            LogInfo << "End of stream reached";
+            return finishStream();
+        }
+        // 增加错误计数
+        m_consecutiveErrors++;
 
-        // 重置数据包
-        av_packet_unref(packet);
+        if (m_consecutiveErrors > kMaxConsecutiveErrors) {
+            return handleConnectionLost("Too many consecutive read errors: " + errorString(ret));
+        }
+        return StepResult::progress();
     }
+    // 重置错误计数器
+    m_consecutiveErrors = 0;
+    m_lastPacketUs = av_gettime_relative();
 
-    // 修改结束包发送（动态分配）
-    if (m_running) {
-        // 视频结束包
-        AVPacket *videoEof = av_packet_alloc();
-        if (videoEof) {
-            videoEof->data = nullptr;
-            videoEof->size = 0;
-            videoEof->stream_index = m_videoStreamIndex;
-            emit videoPacketReady(videoEof);
+    // 缓存在入队之前进行，超限或仅关键帧模式丢弃的包也保留在GOP中；暂存重试的包不重复缓存
+    if (m_readPacket->stream_index == m_videoStreamIndex) {
+        m_gopCache.add(m_readPacket);
+    }
+    // 处理数据包，本地输入队列超限时暂存，等待解码消费
+    if (!processPacket(m_readPacket)) {
+        m_packetHeld = true;
+        return StepResult::wait(5);
+    }
+
+    // 重置数据包
+    av_packet_unref(m_readPacket);
+    return StepResult::progress();
+}
+
+StepResult StreamPullThread::handleConnectionLost(const QString &reason)
+{
+    if (!m_running) {
+        return StepResult::finished();
+    }
+
+    LogWarn << "Connection lost (" << reason << "): " << m_url;
+    closeInput();
+    emit connectionLost(reason);
+    return scheduleReconnect(reason);
+}
+
+StepResult StreamPullThread::scheduleReconnect(const QString &reason)
+{
+    if (!m_running) {
+        return StepResult::finished();
+    }
+
+    if (!m_autoReconnect) {
+        emit errorOccurred(reason);
+        return finishStream();
+    }
+
+    const int shift = qMin(m_reconnectAttempt, 16);
+    const int delayMs = static_cast<int>(qMin<qint64>(qint64(kReconnectBaseDelayMs) << shift,
+                                                      kReconnectMaxDelayMs));
+    ++m_reconnectAttempt;
+    m_reconnectAtUs = av_gettime_relative() + int64_t(delayMs) * 1000;
+    m_state = Backoff;
+
+    LogInfo << "Reconnect attempt " << m_reconnectAttempt << " in " << delayMs << "ms: " << m_url;
+    emit reconnecting(m_reconnectAttempt, delayMs);
+    return StepResult::wait(qMin(delayMs, 100));
+}
+
+StepResult StreamPullThread::finishStream()
+{
+    if (!m_running) {
+        return StepResult::finished();
+    }
+
+    if (!m_endOfStream) {
+        m_endOfStream = true;
+        if (m_videoRing && m_videoStreamIndex >= 0) {
+            m_videoMarker.pending = true;
+            m_videoMarker.endOfStream = true;
         }
+        if (m_audioRing && m_audioStreamIndex >= 0) {
+            m_audioMarker.pending = true;
+            m_audioMarker.endOfStream = true;
+        }
+    }
 
-        // 音频结束包
-        AVPacket *audioEof = av_packet_alloc();
-        if (audioEof) {
-            audioEof->data = nullptr;
-            audioEof->size = 0;
-            audioEof->stream_index = m_audioStreamIndex;
-            emit audioPacketReady(audioEof);
+    // 队列满时不阻塞，等解码线程消费后重试
+    return flushMarkers() ? StepResult::finished() : StepResult::wait(10);
+}
+
+bool StreamPullThread::flushMarkers()
+{
+    auto pushMarker = [](PacketRing *ring, PendingMarker &marker) {
+        if (!marker.pending || !ring) {
+            return true;
+        }
+        const bool pushed = marker.endOfStream
+                                ? ring->pushEof(0)
+                                : ring->pushDiscontinuity(marker.params.get(), marker.timeBase, 0);
+        if (pushed) {
+            marker = PendingMarker();
         }
+        return pushed;
+    };
+    const bool videoDone = pushMarker(m_videoRing, m_videoMarker);
+    const bool audioDone = pushMarker(m_audioRing, m_audioMarker);
+    return videoDone && audioDone;
+}
+
+void StreamPullThread::armDeadline()
+{
+    m_ioDeadlineUs = av_gettime_relative() + int64_t(m_timeoutMs) * 1000;
+}
+
+int StreamPullThread::interruptCallback(void *opaque)
+{
+    auto *self = static_cast<StreamPullThread*>(opaque);
+    if (!self->m_running) {
+        return 1;
     }
+    const int64_t deadline = self->m_ioDeadlineUs.load();
+    return (deadline > 0 && av_gettime_relative() > deadline) ? 1 : 0;
+}
 
-    av_packet_free(&packet);
+bool StreamPullThread::isNetworkInput() const
+{
+    return m_url.contains("://") && !m_url.startsWith("file:", Qt::CaseInsensitive);
 }
 
 bool StreamPullThread::openInput(const QString &url)
@@ -159,27 +490,40 @@ bool StreamPullThread::openInput(const QString &url)
 
     //设置输入上下文的参数配置
     av_dict_set(&m_options, "rtsp_transport", "tcp", 0);
-    av_dict_set(&m_options, "max_delay", "500", 0);
+    if (m_lowLatency) {
+        // 低延迟：不等待乱序包，最小探测量与探测时长
+        av_dict_set(&m_options, "max_delay", "0", 0);
+        av_dict_set(&m_options, "probesize", "32768", 0);
+        av_dict_set(&m_options, "analyzeduration", "100000", 0);
+    } else {
+        av_dict_set(&m_options, "max_delay", "500", 0);
+    }
 //    av_dict_set(&m_options, "timeout", QString::number(m_timeoutMs).toUtf8(), 0);
     av_dict_set(&m_options, "stimeout", "30000000", 0); // 30秒心跳
     // 分配格式上下文
     m_formatContext = avformat_alloc_context();
     if (!m_formatContext) {
-        emit errorOccurred("Failed to allocate format context");
         LogErr << "分配格式上下文失败";
         return false;
     }
 
+    // 阻塞操作超时或关闭时中断
+    m_formatContext->interrupt_callback.callback = &StreamPullThread::interruptCallback;
+    m_formatContext->interrupt_callback.opaque = this;
+
+    // 低延迟：探测阶段读到的包不在解复用层缓存
+    if (m_lowLatency) {
+        m_formatContext->flags |= AVFMT_FLAG_NOBUFFER;
+    }
+
     // 打开输入流
+    armDeadline();
     int ret = avformat_open_input(&m_formatContext, url.toUtf8().constData(), nullptr, &m_options);
     // 释放参数字典
     if(m_options)
         av_dict_free(&m_options);
     if (ret < 0) {
-        char error[AV_ERROR_MAX_STRING_SIZE] = {0};
-        av_strerror(ret, error, sizeof(error));
-        emit errorOccurred(QString("Failed to open input: %1").arg(error));
-        LogErr << "打开输入流失败";
+        LogErr << "打开输入流失败: " << errorString(ret);
         return false;
     }
 
@@ -190,11 +534,10 @@ bool StreamPullThread::findStreamInfo()
 {
 
     // 查找流信息
+    armDeadline();
     int ret = avformat_find_stream_info(m_formatContext, nullptr);
     if (ret < 0) {
-        char error[AV_ERROR_MAX_STRING_SIZE] = {0};
-        av_strerror(ret, error, sizeof(error));
-        emit errorOccurred(QString("Failed to find stream info: %1").arg(error));
+        LogErr << "查找流信息失败: " << errorString(ret);
         return false;
     }
 
@@ -202,64 +545,212 @@ bool StreamPullThread::findStreamInfo()
     av_dump_format(m_formatContext, 0, m_formatContext->url, 0);
 
     // 查找视频流和音频流
-    m_videoStreamIndex = -1;
-    m_audioStreamIndex = -1;
+    int videoStreamIndex = -1;
+    int audioStreamIndex = -1;
 
     for (unsigned int i = 0; i < m_formatContext->nb_streams; i++) {
         AVStream *stream = m_formatContext->streams[i];
         AVCodecParameters *codecpar = stream->codecpar;
 
-        if (codecpar->codec_type == AVMEDIA_TYPE_VIDEO && m_videoStreamIndex < 0) {
-            m_videoStreamIndex = i;
+        if (codecpar->codec_type == AVMEDIA_TYPE_VIDEO && videoStreamIndex < 0) {
+            videoStreamIndex = i;
             // 发送视频流信息
             double frameRate = av_q2d(stream->avg_frame_rate);
             if (frameRate <= 0) frameRate = av_q2d(stream->r_frame_rate);
             emit streamInfoReady(codecpar->width, codecpar->height, frameRate);
         }
-        else if (codecpar->codec_type == AVMEDIA_TYPE_AUDIO && m_audioStreamIndex < 0) {
-            m_audioStreamIndex = i;
+        else if (codecpar->codec_type == AVMEDIA_TYPE_AUDIO && audioStreamIndex < 0) {
+            audioStreamIndex = i;
         }
     }
 
-    if (m_videoStreamIndex < 0 && m_audioStreamIndex < 0) {
-        emit errorOccurred("No video or audio streams found");
+    if (videoStreamIndex < 0 && audioStreamIndex < 0) {
+        LogErr << "No video or audio streams found";
         return false;
     }
 
+    m_videoStreamIndex = videoStreamIndex;
+    m_audioStreamIndex = audioStreamIndex;
     return true;
 }
 
-void StreamPullThread::processPacket(AVPacket *packet)
+bool StreamPullThread::updateStreamParameters(bool reconnect)
+{
+    const AVStream *videoStream = m_videoStreamIndex >= 0
+                                      ? m_formatContext->streams[m_videoStreamIndex] : nullptr;
+    const AVStream *audioStream = m_audioStreamIndex >= 0
+                                      ? m_formatContext->streams[m_audioStreamIndex] : nullptr;
+
+    if (!reconnect) {
+        QMutexLocker locker(&m_mutex);
+        m_videoParams = videoStream ? copyCodecParameters(videoStream->codecpar) : nullptr;
+        m_audioParams = audioStream ? copyCodecParameters(audioStream->codecpar) : nullptr;
+        m_videoTimeBase = videoStream ? videoStream->time_base : AVRational{0, 1};
+        m_audioTimeBase = audioStream ? audioStream->time_base : AVRational{0, 1};
+    } else {
+        // 解码器按首次连接的流创建，重连后新出现的流不处理
+        if (!m_videoParams) {
+            videoStream = nullptr;
+            m_videoStreamIndex = -1;
+        }
+        if (!m_audioParams) {
+            audioStream = nullptr;
+            m_audioStreamIndex = -1;
+        }
+    }
+
+    // 队列按流时间基计算排队时长
+    if (m_videoRing && videoStream) {
+        m_videoRing->setTimeBase(videoStream->time_base);
+    }
+    if (m_audioRing && audioStream) {
+        m_audioRing->setTimeBase(audioStream->time_base);
+    }
+
+    if (!reconnect) {
+        return false;
+    }
+
+    // 重连：参数不变时解码器只需刷新，变化时携带新参数重建解码器
+    bool changed = false;
+    auto markDiscontinuity = [this, &changed](PacketRing *ring, const AVStream *stream,
+                                             std::shared_ptr<AVCodecParameters> &saved,
+                                             AVRational &savedTimeBase, PendingMarker &marker) {
+        if (!ring || !stream) {
+            return;
+        }
+        const bool same = sameCodecParameters(saved.get(), stream->codecpar);
+        if (!same) {
+            QMutexLocker locker(&m_mutex);
+            saved = copyCodecParameters(stream->codecpar);
+            savedTimeBase = stream->time_base;
+            changed = true;
+        }
+        // 标记在读包前由flushMarkers写入，队列满时不阻塞；
+        // 上一次重连的标记尚未写入时合并，保留其携带的参数变化
+        if (!marker.pending || marker.endOfStream) {
+            marker.params.reset();
+        }
+        if (!same) {
+            marker.params = saved;
+        }
+        marker.pending = true;
+        marker.endOfStream = false;
+        marker.timeBase = stream->time_base;
+    };
+    markDiscontinuity(m_videoRing, videoStream, m_videoParams, m_videoTimeBase, m_videoMarker);
+    markDiscontinuity(m_audioRing, audioStream, m_audioParams, m_audioTimeBase, m_audioMarker);
+    return changed;
+}
+
+bool StreamPullThread::processPacket(AVPacket *packet)
 {
     if (packet->stream_index == m_videoStreamIndex) {
-        // 复制视频包
-        AVPacket *videoPacket = av_packet_alloc();
-        av_packet_ref(videoPacket, packet);
-        emit videoPacketReady(videoPacket);
+        if (!m_videoRing) {
+            return true;
+        }
+
+        // 仅关键帧模式，解复用器未跳过的非关键帧在此丢弃（不计入超限丢包）
+        const bool keyframe = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+        if (m_videoKeyframeOnly && !keyframe) {
+            return true;
+        }
+
+        if (m_localInput && !m_videoRing->canAccept(packet)) {
+            return false;
+        }
+
+        // 超限后整段丢弃到下一个关键帧，已入队的数据保持完整可解码
+        if (m_dropVideoUntilKeyframe && !keyframe) {
+            m_videoRing->recordDrop(packet, false);
+            return true;
+        }
+
+        if (!m_videoRing->canAccept(packet) || !m_videoRing->push(packet, 0)) {
+            if (!m_dropVideoUntilKeyframe) {
+                PacketRing::Stats stats = m_videoRing->stats();
+                LogWarn << "Video packet queue over limit (" << stats.packets << " packets, "
+                        << stats.bytes << " bytes, " << stats.durationMs
+                        << "ms), dropping until next keyframe";
+            }
+            m_videoRing->recordDrop(packet, !m_dropVideoUntilKeyframe);
+            m_dropVideoUntilKeyframe = true;
+            return true;
+        }
+
+        if (m_dropVideoUntilKeyframe) {
+            LogInfo << "Video queue resumed at keyframe";
+            m_dropVideoUntilKeyframe = false;
+        }
     }
     else if (packet->stream_index == m_audioStreamIndex) {
-        // 复制音频包
-        AVPacket *audioPacket = av_packet_alloc();
-        av_packet_ref(audioPacket, packet);
-        emit audioPacketReady(audioPacket);
+        if (!m_audioRing) {
+            return true;
+        }
+        if (m_localInput && !m_audioRing->canAccept(packet)) {
+            return false;
+        }
 
+        // 音频包相互独立，超限时丢弃整包；时间轴空缺由播放器按PTS校正音频时钟
+        if (!m_audioRing->canAccept(packet) || !m_audioRing->push(packet, 0)) {
+            if (!m_droppingAudio) {
+                LogWarn << "Audio packet queue over limit, dropping packets";
+            }
+            m_audioRing->recordDrop(packet, !m_droppingAudio);
+            m_droppingAudio = true;
+            return true;
+        }
+        m_droppingAudio = false;
     }
+    return true;
 }
 
-void StreamPullThread::cleanup() {
-    // 清理格式上下文
+void StreamPullThread::replayGop()
+{
+    if (!m_videoRing || m_videoStreamIndex < 0 || !m_gopCache.canReplay()) {
+        return;
+    }
+
+    // 不连续标记让解码器刷新参考帧并重置同步时钟，随后从缓存的关键帧开始解码
+    const AVRational timeBase = m_formatContext->streams[m_videoStreamIndex]->time_base;
+    if (!m_videoRing->pushDiscontinuity(nullptr, timeBase, 0)) {
+        LogWarn << "Video packet queue full, GOP replay skipped";
+        return;
+    }
+
+    bool complete = false;
+    const int replayed = m_gopCache.replayTo(m_videoRing, &complete);
+
+    // 未能连续写到最新的包时，之后的包缺少参考帧，丢弃到下一个关键帧
+    m_dropVideoUntilKeyframe = !complete;
+    LogInfo << "Replayed " << replayed << " cached video packets"
+            << (complete ? "" : ", dropping until next keyframe");
+}
+
+void StreamPullThread::closeInput()
+{
     if (m_formatContext) {
         avformat_close_input(&m_formatContext);
         m_formatContext = nullptr;
     }
 
-    // 清理选项
     if (m_options) {
         av_dict_free(&m_options);
         m_options = nullptr;
     }
+}
+
+void StreamPullThread::cleanup() {
+    // 清理格式上下文与选项
+    closeInput();
+
+    // 释放读取包
+    if (m_readPacket) {
+        av_packet_free(&m_readPacket);
+    }
 
     // 重置流索引
     m_videoStreamIndex = -1;
     m_audioStreamIndex = -1;
+    m_state = Connecting;
 }
@@ -3,10 +3,23 @@
 
 #include <QThread>
 #include <QMutex>
+#include <memory>
 #include "DataStruct.h"
-
-
-
+#include "gopcache.h"
+
+class PacketRing;
+class PipelineMetrics;
+
+/**
+ * @brief 拉流线程：连接、探测与读包都在本线程中进行
+ *
+ * open() 只记录地址并启动，不阻塞调用线程；连接成功后发出 opened()。
+ * 所有阻塞的网络操作受中断回调的超时保护。读包超时、读错误过多或网络流意外结束时
+ * 视为断线，按指数退避自动重连；重连后编解码参数不变则解码器只刷新、继续复用，
+ * 变化时通过包队列的不连续标记通知解码线程按新参数重新打开解码器。
+ * 线程池模式下拉流同样在本线程进行，只有解码由调度器驱动：av_read_frame等网络读取会阻塞到
+ * 超时，不能占用解码工作线程。写入包队列的标记不阻塞，队列满时下一步重试。
+ */
 class StreamPullThread : public QThread
 {
     Q_OBJECT
@@ -14,54 +27,132 @@ public:
     explicit StreamPullThread(QObject *parent = nullptr);
     ~StreamPullThread();
 
-    bool open(const QString &url, int timeoutMs = 5000);
+    // 异步打开，连接结果通过opened()/reconnecting()/errorOccurred()通知
+    bool open(const QString &url);
     void close();
     // 设置硬件解码
     void setHardwareDecoding(bool enable);
 
-    // 设置超时时间
+    // 设置单次网络操作（连接、探测、读包）的超时时间
     void setTimeout(int timeoutMs);
 
+    // 低延迟直播模式（需在open前设置）：最小探测、不缓存、关闭重排等待
+    void setLowLatency(bool enable);
+
+    // 断线自动重连（默认开启），关闭时断线即结束
+    void setAutoReconnect(bool enable);
+
+    // 视频只保留关键帧（可随时切换）：解复用器设置AVDISCARD_NONKEY（MP4/MKV等在读包时即跳过），
+    // 不支持的解复用器（RTSP等）读出后在入队前丢弃
+    void setVideoKeyframeOnly(bool enable);
+
+    // 视频GOP缓存的字节上限（默认8MB，0为关闭）。同一地址重新open时保留上次的缓存，
+    // 编解码参数不变时可作为首帧预览
+    void setGopCacheLimit(qint64 maxBytes);
+
+    // 上次连接缓存的视频关键帧（缓存时间不超过maxAgeMs），opened之后调用，没有时返回nullptr
+    std::shared_ptr<AVPacket> cachedVideoKeyframe(int maxAgeMs) const;
+
+    // 请求把本次连接缓存的GOP重放到视频包队列（任意线程调用，拉流线程下一步执行）：
+    // 先写入不连续标记让解码器清空状态，再从关键帧写到最新的包
+    void requestGopReplay();
+
     // 获取视频流信息
     int videoStreamIndex() const { return m_videoStreamIndex; }
 
     // 获取音频流信息
     int audioStreamIndex() const { return m_audioStreamIndex; }
 
-    // 获取编解码参数
-    AVCodecParameters* videoCodecParameters() const;
-    AVCodecParameters* audioCodecParameters() const;
+    // 获取编解码参数副本（opened之后有效）
+    std::shared_ptr<AVCodecParameters> videoCodecParameters() const;
+    std::shared_ptr<AVCodecParameters> audioCodecParameters() const;
 
-    // 获取格式上下文
+    // 获取流时间基（数据包与解码帧的时间戳单位）
+    AVRational videoTimeBase() const;
+    AVRational audioTimeBase() const;
+
+    // 获取格式上下文（仅限拉流线程内使用，重连时会重建）
     AVFormatContext* formatContext() const { return m_formatContext; }
-signals:
-    // 视频包就绪信号
-    void videoPacketReady(AVPacket *packet);
 
-    // 音频包就绪信号
-    void audioPacketReady(AVPacket *packet);
+    // 设置解码线程的包队列，拉流线程直接写入，不经过信号转发
+    void setPacketRings(PacketRing *videoRing, PacketRing *audioRing);
 
+    // 设置流水线统计（需在open前设置），为空时不统计
+    void setMetrics(PipelineMetrics *metrics);
+
+signals:
     // 错误信号
     void errorOccurred(const QString &error);
 
     // 流信息就绪信号
     void streamInfoReady(int width, int height, double frameRate);
 
+    // 首次连接成功，流索引与编解码参数可用
+    void opened();
+
+    // 连接中断
+    void connectionLost(const QString &reason);
+
+    // 等待delayMs毫秒后进行第attempt次重连
+    void reconnecting(int attempt, int delayMs);
+
+    // 重连成功，codecChanged表示编解码参数已变化（解码线程将重新打开解码器）
+    void reconnected(bool codecChanged);
+
 protected:
     void run() override;
 
 private:
+    enum ConnectionState {
+        Connecting,     // 待连接
+        Streaming,      // 读包中
+        Backoff         // 等待重连
+    };
+
     // 初始化FFmpeg
     void initFFmpeg();
 
+    // 执行一步：连接/等待重连，或读取并分发一个数据包
+    StepResult step();
+
+    // 连接并读取数据包
+    StepResult stepConnect();
+    StepResult stepRead();
+
     // 打开输入流
     bool openInput(const QString &url);
 
     // 查找流信息
     bool findStreamInfo();
 
-    // 处理数据包
-    void processPacket(AVPacket *packet);
+    // 保存/比较编解码参数，返回参数是否变化
+    bool updateStreamParameters(bool reconnect);
+
+    // 断线处理：关闭输入，按退避策略安排重连
+    StepResult handleConnectionLost(const QString &reason);
+    StepResult scheduleReconnect(const QString &reason);
+
+    // 处理数据包：网络输入超限时丢弃；本地输入超限时返回false，由调用方暂存后重试（背压）
+    bool processPacket(AVPacket *packet);
+
+    // 写入流结束标记后结束，队列满时返回wait稍后重试
+    StepResult finishStream();
+
+    // 写入待发送的流结束/不连续标记（不阻塞），全部写入时返回true
+    bool flushMarkers();
+
+    // 执行GOP重放请求
+    void replayGop();
+
+    // 设置下一次阻塞操作的截止时间
+    void armDeadline();
+    static int interruptCallback(void *opaque);
+
+    // 网络流（文件结束不重连）
+    bool isNetworkInput() const;
+
+    // 关闭输入流
+    void closeInput();
 
     // 清理资源
     void cleanup();
@@ -70,13 +161,64 @@ private:
     AVFormatContext *m_formatContext = nullptr;
     AVDictionary *m_options = nullptr;
 
-    int m_audioStreamIndex = -1;
-    int m_videoStreamIndex = -1;
+    std::atomic<int> m_audioStreamIndex{-1};
+    std::atomic<int> m_videoStreamIndex{-1};
+
+    // 解码线程的包队列（不持有）
+    PacketRing *m_videoRing = nullptr;
+    PacketRing *m_audioRing = nullptr;
+    PipelineMetrics *m_metrics = nullptr;
+
+    // 读取用数据包
+    AVPacket *m_readPacket = nullptr;
+    int m_consecutiveErrors = 0;
+
+    // 队列超限丢弃状态
+    bool m_dropVideoUntilKeyframe = false;
+    bool m_droppingAudio = false;
+
+    // 待写入包队列的标记，队列满时保留到下一步重试
+    struct PendingMarker {
+        bool pending = false;
+        bool endOfStream = false;                       // 否则为不连续标记
+        std::shared_ptr<AVCodecParameters> params;      // 不连续标记携带的新参数，未变化时为空
+        AVRational timeBase{0, 1};
+    };
+    PendingMarker m_videoMarker;
+    PendingMarker m_audioMarker;
+    bool m_endOfStream = false;
+
+    // 视频GOP缓存，重放请求由拉流线程执行
+    GopCache m_gopCache;
+    std::atomic_bool m_gopReplayRequested{false};
+
+    // 本地文件读取远快于播放，超限时暂停读取而不是丢包；m_readPacket中暂存未入队的包
+    bool m_localInput = false;
+    bool m_packetHeld = false;
+
+    // 连接状态（仅拉流线程访问）
+    QString m_url;
+    ConnectionState m_state = Connecting;
+    bool m_everOpened = false;
+    int m_reconnectAttempt = 0;
+    int64_t m_reconnectAtUs = 0;
+    int64_t m_lastPacketUs = 0;
+    std::atomic<int64_t> m_ioDeadlineUs{0};
+
+    // 首次连接时的编解码参数与时间基，重连时据此判断是否需要重建解码器
+    std::shared_ptr<AVCodecParameters> m_videoParams;
+    std::shared_ptr<AVCodecParameters> m_audioParams;
+    AVRational m_videoTimeBase{0, 1};
+    AVRational m_audioTimeBase{0, 1};
 
     std::atomic_bool m_running{false};
     std::atomic_bool m_hardwareDecoding{false};
+    std::atomic_bool m_lowLatency{false};
+    std::atomic_bool m_autoReconnect{true};
+    std::atomic_bool m_videoKeyframeOnly{false};
+    int m_appliedVideoDiscard = -1;     // 已设置到视频流的discard（拉流线程访问），-1为未设置
     int m_timeoutMs = 5000;
-    QMutex m_mutex;
+    mutable QMutex m_mutex;
 };
 
 #endif // STREAMPULLTHREAD_H
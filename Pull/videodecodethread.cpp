@@ -1,7 +1,19 @@
-﻿#include "videodecodethread.h"
+﻿#define LOG_MODULE Logger::VideoModule
+#include "videodecodethread.h"
+#include "avsyncengine.h"
+#include "pipelinemetrics.h"
 
 #include <Logger.h>
-#include <QElapsedTimer>
+
+namespace {
+
+// 连续出错达到该次数时放弃硬件解码
+const int kMaxHardwareErrors = 3;
+
+// 暂停解码期间检查队列的间隔
+const int kSuspendedPollMs = 40;
+
+} // namespace
 
 VideoDecodeThread::VideoDecodeThread(QObject *parent)
     : QThread{parent}
@@ -12,9 +24,38 @@ VideoDecodeThread::VideoDecodeThread(QObject *parent)
 VideoDecodeThread::~VideoDecodeThread()
 {
     close();
+    unregisterThreading();
+}
+
+bool VideoDecodeThread::init(const AVCodecParameters *codecParams, AVRational timeBase) {
+    // 先注册再打开，自动线程分配把本路计入活动解码器
+    if (m_threadingId < 0) {
+        m_threadingId = DecodeThreadingPolicy::instance().addDecoder([this]() {
+            m_threadSettingsChanged = true;
+        });
+    }
+    m_threadSettingsChanged = false;
+    m_reopenRequested = false;
+    m_hwFailed = false;
+
+    if (!openCodec(codecParams, timeBase)) {
+        unregisterThreading();
+        return false;
+    }
+
+    // 创建包和帧
+    m_packet = av_packet_alloc();
+    m_frame = av_frame_alloc();
+    m_hwFrame = av_frame_alloc();
+    if (!m_packet || !m_frame || !m_hwFrame) {
+        emit errorOccurred("Failed to allocate frames");
+        return false;
+    }
+
+    return true;
 }
 
-bool VideoDecodeThread::init(AVCodecParameters *codecParams) {
+bool VideoDecodeThread::openCodec(const AVCodecParameters *codecParams, AVRational timeBase) {
     if (!codecParams) {
         emit errorOccurred("Invalid codec parameters");
         return false;
@@ -43,17 +84,29 @@ bool VideoDecodeThread::init(AVCodecParameters *codecParams) {
         return false;
     }
 
+    // 帧时间戳沿用数据包的流时间基
+    m_timeBase = timeBase;
+    m_codecContext->pkt_timebase = timeBase;
+    m_sourceSize = QSize(codecParams->width, codecParams->height);
+
     // 设置解码选项
     m_codecContext->flags2 |= AV_CODEC_FLAG2_FAST;
+    if (m_lowLatency) {
+        // 不缓存重排帧
+        m_codecContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    }
 
-    // 尝试硬件解码
-    if (m_hardwareDecoding) {
+    // 尝试硬件解码，失败时保留软件解码器上下文继续
+    if (m_hardwareDecoding && !m_hwFailed) {
         if (!initHardwareDecoder()) {
-            LogWarn << "Hardware decoding initialization failed, falling back to software";
-            m_hardwareDecoding = false;
+            LogWarn << "Hardware decoding unavailable, falling back to software";
+            m_hwFailed = true;
         }
     }
 
+    applyThreadSettings();
+    applyDecodeQuality(desiredDecodeQuality());
+
     // 打开解码器
     ret = avcodec_open2(m_codecContext, m_codec, nullptr);
     if (ret < 0) {
@@ -63,40 +116,199 @@ bool VideoDecodeThread::init(AVCodecParameters *codecParams) {
         return false;
     }
 
-    // 创建帧
-    m_frame = av_frame_alloc();
-    m_hwFrame = av_frame_alloc();
-    if (!m_frame || !m_hwFrame) {
-        emit errorOccurred("Failed to allocate frames");
-        return false;
-    }
-
-    // 保存视频信息
-    m_videoSize = QSize(m_codecContext->width, m_codecContext->height);
-    if (m_targetSize.isEmpty()) {
-        m_targetSize = m_videoSize;
-    }
+    // 保存视频信息（原始分辨率，lowres解码时输出帧更小）
+    m_videoSize = m_sourceSize;
 
     LogInfo << "Video decoder initialized: "
             << "Codec: " << m_codec->name
             << " Size: " << m_videoSize.width() << "x" << m_videoSize.height()
             << " Frame rate: " << m_frameRate
-            << " HW decoding: " << (m_hardwareDecoding ? "enabled" : "disabled");
+            << " Decoder: " << activeDecoderName()
+            << " Threads: " << m_codecContext->thread_count
+            << (m_codecContext->active_thread_type == FF_THREAD_FRAME ? " (frame)"
+                : m_codecContext->active_thread_type == FF_THREAD_SLICE ? " (slice)" : "");
 
     emit videoInfoUpdated(m_videoSize.width(), m_videoSize.height(), m_frameRate);
 
     return true;
 }
 
-void VideoDecodeThread::setTargetSize(const QSize &size) {
-    if (size.isValid()) {
-        m_targetSize = size;
-        LogInfo << "Target size set to: " << size.width() << "x" << size.height();
+int VideoDecodeThread::addOutput(const QSize &targetSize, bool yuvPassthrough) {
+    VideoOutput output;
+    output.targetSize = targetSize;
+    output.yuvPassthrough = yuvPassthrough;
+    output.converter = std::make_unique<FrameConverter>();
+
+    QMutexLocker locker(&m_outputsMutex);
+    output.id = m_nextOutputId++;
+    m_outputs.push_back(std::move(output));
+    m_qualityChanged = true;
+    m_outputsAdded = true;
+    updateSuspended();
+    LogInfo << "Video output " << m_outputs.back().id << " added, "
+            << m_outputs.size() << " outputs";
+    return m_outputs.back().id;
+}
+
+void VideoDecodeThread::removeOutput(int outputId) {
+    QMutexLocker locker(&m_outputsMutex);
+    for (auto it = m_outputs.begin(); it != m_outputs.end(); ++it) {
+        if (it->id == outputId) {
+            m_outputs.erase(it);
+            m_qualityChanged = true;
+            updateSuspended();
+            LogInfo << "Video output " << outputId << " removed, "
+                    << m_outputs.size() << " outputs";
+            return;
+        }
+    }
+}
+
+int VideoDecodeThread::outputCount() const {
+    QMutexLocker locker(&m_outputsMutex);
+    return static_cast<int>(m_outputs.size());
+}
+
+void VideoDecodeThread::setOutputTargetSize(int outputId, const QSize &size) {
+    if (!size.isValid()) {
+        return;
+    }
+
+    // 只记录尺寸，转换上下文由解码线程在下一帧重建
+    QMutexLocker locker(&m_outputsMutex);
+    for (VideoOutput &output : m_outputs) {
+        if (output.id == outputId && output.targetSize != size) {
+            output.targetSize = size;
+            output.sizeChanged = true;
+            m_qualityChanged = true;
+            LogInfo << "Output " << outputId << " target size set to: "
+                    << size.width() << "x" << size.height();
+        }
+    }
+}
+
+void VideoDecodeThread::setOutputFullQuality(int outputId, bool enable) {
+    QMutexLocker locker(&m_outputsMutex);
+    for (VideoOutput &output : m_outputs) {
+        if (output.id == outputId) {
+            output.fullQuality = enable;
+            m_qualityChanged = true;
+        }
+    }
+}
+
+void VideoDecodeThread::setOutputVisible(int outputId, bool visible) {
+    QMutexLocker locker(&m_outputsMutex);
+    for (VideoOutput &output : m_outputs) {
+        if (output.id == outputId && output.visible != visible) {
+            output.visible = visible;
+            updateSuspended();
+        }
+    }
+}
+
+void VideoDecodeThread::updateSuspended() {
+    // 没有输出时保持解码（空输出测试、尚未绑定显示组件）
+    bool anyVisible = m_outputs.empty();
+    for (const VideoOutput &output : m_outputs) {
+        anyVisible = anyVisible || output.visible;
+    }
+    m_suspended = !anyVisible;
+}
+
+void VideoDecodeThread::setPreviewPacket(std::shared_ptr<AVPacket> packet) {
+    m_previewPacket = std::move(packet);
+}
+
+void VideoDecodeThread::setGopReplayHandler(std::function<void()> handler) {
+    m_gopReplayHandler = std::move(handler);
+}
+
+void VideoDecodeThread::setKeyframeOnly(bool enable) {
+    m_keyframeOnly = enable;
+}
+
+void VideoDecodeThread::setTileAwareDecoding(bool enable) {
+    m_tileAwareDecoding = enable;
+    m_qualityChanged = true;
+}
 
-        // 重新创建SWS上下文
-        if (m_swsContext) {
-            sws_freeContext(m_swsContext);
-            m_swsContext = nullptr;
+VideoDecodeThread::DecodeQuality VideoDecodeThread::desiredDecodeQuality() const {
+    DecodeQuality quality;
+    if (!m_tileAwareDecoding || m_nullOutput || m_sourceSize.isEmpty()) {
+        return quality;
+    }
+
+    // 以最大的输出为准，任一输出要求全画质或尺寸未知时完整解码
+    QSize largest;
+    {
+        QMutexLocker locker(&m_outputsMutex);
+        if (m_outputs.empty()) {
+            return quality;
+        }
+        for (const VideoOutput &output : m_outputs) {
+            if (output.fullQuality || output.targetSize.isEmpty()) {
+                return quality;
+            }
+            largest = largest.expandedTo(output.targetSize);
+        }
+    }
+
+    const QSize fitted = m_sourceSize.scaled(largest, Qt::KeepAspectRatio);
+    const double scale = double(fitted.width()) / m_sourceSize.width();
+    if (scale > 0.5) {
+        return quality;
+    }
+
+    // 只在非参考帧上跳过，误差不会传播：参考帧跳过环路滤波会累积漂移，放大恢复全画质后
+    // 一直持续到下一个关键帧，因此两级都不跳过参考帧，1/4以下的小画面仅靠lowres进一步降低开销
+    const bool minimal = scale <= 0.25;
+    quality.level = minimal ? MinimalQuality : ReducedQuality;
+    quality.skipLoopFilter = AVDISCARD_NONREF;
+    quality.skipIdct = AVDISCARD_NONREF;
+
+    // lowres只有部分解码器支持（如MJPEG），硬件解码不支持
+    const int maxLowres = (m_codec && !m_hwDeviceContext) ? m_codec->max_lowres : 0;
+    quality.lowres = qMin(maxLowres, minimal ? 2 : 1);
+    return quality;
+}
+
+void VideoDecodeThread::applyDecodeQuality(const DecodeQuality &quality) {
+    m_codecContext->lowres = quality.lowres;
+    m_codecContext->skip_loop_filter = quality.skipLoopFilter;
+    m_codecContext->skip_idct = quality.skipIdct;
+    m_decodeQuality = quality;
+    m_qualityLevel = quality.level;
+}
+
+void VideoDecodeThread::updateDecodeQuality() {
+    const DecodeQuality quality = desiredDecodeQuality();
+    if (quality.level == m_decodeQuality.level && quality.lowres == m_decodeQuality.lowres) {
+        return;
+    }
+
+    // 跳过选项可在解码中直接修改，lowres改变输出尺寸，需重新打开
+    const int currentLowres = m_codecContext->lowres;
+    m_codecContext->skip_loop_filter = quality.skipLoopFilter;
+    m_codecContext->skip_idct = quality.skipIdct;
+    m_decodeQuality = quality;
+    m_decodeQuality.lowres = currentLowres;
+    m_qualityLevel = quality.level;
+    if (quality.lowres != currentLowres) {
+        m_lowresChanged = true;
+    }
+
+    LogInfo << "Video decode quality: "
+            << (quality.level == FullQuality ? "full"
+                : quality.level == ReducedQuality ? "reduced" : "minimal")
+            << ", lowres " << quality.lowres;
+}
+
+void VideoDecodeThread::setOutputYuvPassthrough(int outputId, bool enable) {
+    QMutexLocker locker(&m_outputsMutex);
+    for (VideoOutput &output : m_outputs) {
+        if (output.id == outputId) {
+            output.yuvPassthrough = enable;
         }
     }
 }
@@ -105,13 +317,153 @@ void VideoDecodeThread::setHardwareDecoding(const bool &enable) {
     m_hardwareDecoding = enable;
 }
 
-void VideoDecodeThread::close() {
-    if (!m_running) return;
+void VideoDecodeThread::setHardwareDeviceTypes(const QList<AVHWDeviceType> &types) {
+    m_hwDeviceTypes = types;
+}
+
+QList<AVHWDeviceType> VideoDecodeThread::defaultHardwareDeviceTypes() {
+#if defined(Q_OS_WIN)
+    return {AV_HWDEVICE_TYPE_D3D11VA, AV_HWDEVICE_TYPE_DXVA2, AV_HWDEVICE_TYPE_CUDA};
+#elif defined(Q_OS_MACOS)
+    return {AV_HWDEVICE_TYPE_VIDEOTOOLBOX};
+#else
+    return {AV_HWDEVICE_TYPE_VAAPI, AV_HWDEVICE_TYPE_VDPAU, AV_HWDEVICE_TYPE_CUDA};
+#endif
+}
+
+QList<AVHWDeviceType> VideoDecodeThread::parseHardwareDeviceTypes(const QString &names) {
+    QList<AVHWDeviceType> types;
+    for (const QString &name : names.split(',', QString::SkipEmptyParts)) {
+        const QString trimmed = name.trimmed().toLower();
+        if (trimmed == "auto") {
+            types.append(defaultHardwareDeviceTypes());
+            continue;
+        }
+        const AVHWDeviceType type = av_hwdevice_find_type_by_name(trimmed.toUtf8().constData());
+        if (type == AV_HWDEVICE_TYPE_NONE) {
+            LogWarn << "Unknown hardware device type: " << trimmed;
+            continue;
+        }
+        if (!types.contains(type)) {
+            types.append(type);
+        }
+    }
+    return types;
+}
+
+QString VideoDecodeThread::activeDecoderName() const {
+    QMutexLocker locker(&m_statsMutex);
+    return m_hwDeviceType != AV_HWDEVICE_TYPE_NONE
+               ? QString(av_hwdevice_get_type_name(m_hwDeviceType))
+               : QString("software");
+}
+
+void VideoDecodeThread::setNullOutput(bool enable) {
+    m_nullOutput = enable;
+}
+
+void VideoDecodeThread::setLowLatency(bool enable, int targetLatencyMs) {
+    m_lowLatency = enable;
+    m_targetLatencyMs = enable ? qMax(0, targetLatencyMs) : 0;
+}
+
+void VideoDecodeThread::setDecodeThreads(int threadCount, int threadType) {
+    m_threadCountOverride = threadCount;
+    m_threadTypeOverride = threadType;
+    m_threadSettingsChanged = true;
+}
+
+DecodeThreadingPolicy::Settings VideoDecodeThread::decodeThreads() const {
+    QMutexLocker locker(&m_statsMutex);
+    return m_threadSettings;
+}
+
+DecodeThreadingPolicy::Settings VideoDecodeThread::desiredThreadSettings() const {
+    DecodeThreadingPolicy::Settings settings;
+    if (m_hwDeviceContext) {
+        // 硬件解码由GPU完成，多线程只增加延迟
+        settings.threadCount = 1;
+    } else if (m_threadCountOverride >= 0) {
+        settings.threadCount = m_threadCountOverride;
+        settings.threadType = m_lowLatency ? FF_THREAD_SLICE : m_threadTypeOverride.load();
+    } else {
+        settings = DecodeThreadingPolicy::instance().resolve(
+            m_codecContext->width, m_codecContext->height, m_lowLatency);
+    }
+    return settings;
+}
+
+void VideoDecodeThread::applyThreadSettings() {
+    const DecodeThreadingPolicy::Settings settings = desiredThreadSettings();
+    m_codecContext->thread_count = settings.threadCount;
+    m_codecContext->thread_type = settings.threadType;
+
+    QMutexLocker locker(&m_statsMutex);
+    m_threadSettings = settings;
+}
 
+void VideoDecodeThread::reopenCodec() {
+    const bool fallback = m_reopenRequested.exchange(false);
+    const bool lowresChanged = m_lowresChanged;
+    m_threadSettingsChanged = false;
+    m_lowresChanged = false;
+    if (!fallback && !lowresChanged && desiredThreadSettings() == m_threadSettings) {
+        return;
+    }
+
+    AVCodecParameters *params = avcodec_parameters_alloc();
+    if (!params || avcodec_parameters_from_context(params, m_codecContext) < 0) {
+        avcodec_parameters_free(&params);
+        return;
+    }
+    // lowres解码时上下文中是缩小后的尺寸
+    params->width = m_sourceSize.width();
+    params->height = m_sourceSize.height();
+
+    // 帧级多线程的解码器内缓存着若干帧，先全部取出放入待显示队列（硬件已失败时不再取）
+    if (!fallback) {
+        decodePacket(nullptr);
+    }
+
+    const int oldThreads = m_threadSettings.threadCount;
+    releaseCodec();
+    if (!openCodec(params, m_timeBase)) {
+        LogErr << "Failed to reopen video decoder";
+        m_running = false;
+    } else {
+        LogInfo << "Video decoder reopened: " << activeDecoderName()
+                << ", threads " << oldThreads << " -> " << m_threadSettings.threadCount
+                << ", lowres " << m_codecContext->lowres;
+    }
+    avcodec_parameters_free(&params);
+}
+
+void VideoDecodeThread::unregisterThreading() {
+    if (m_threadingId >= 0) {
+        DecodeThreadingPolicy::instance().removeDecoder(m_threadingId);
+        m_threadingId = -1;
+    }
+}
+
+VideoDecodeThread::LatencyStats VideoDecodeThread::latencyStats() const {
+    QMutexLocker locker(&m_statsMutex);
+    return m_latencyStats;
+}
+
+void VideoDecodeThread::setSyncEngine(AVSyncEngine *syncEngine) {
+    m_syncEngine = syncEngine;
+}
+
+void VideoDecodeThread::setMetrics(PipelineMetrics *metrics) {
+    m_metrics = metrics;
+}
+
+void VideoDecodeThread::close() {
+    // 未启动（init后启动前失败）时也要释放解码器并注销，cleanup可重复调用
     m_running = false;
 
     // 唤醒等待的线程
-    m_queueCondition.wakeAll();
+    m_packetRing.wakeAll();
 
     // 等待线程结束
     if (isRunning()) {
@@ -125,194 +477,357 @@ void VideoDecodeThread::close() {
     cleanup();
 }
 
-void VideoDecodeThread::onVideoPacketReceived(AVPacket *packet) {
-    if (!m_running || !packet) {
-        LogErr << "音频包数据为空";
-        return;
-    }
+void VideoDecodeThread::startExternal() {
+    prepareDecoding();
+}
+
+void VideoDecodeThread::prepareDecoding() {
+    m_running = true;
+    m_flushing = false;
+    m_pendingFrames.clear();
+    m_suspendedActive = false;
+    m_presentNextImmediately = false;
 
-    QMutexLocker locker(&m_queueMutex);
+    QMutexLocker locker(&m_statsMutex);
+    m_latencyStats = LatencyStats();
+}
 
-    // 空包表示流结束
-    if (packet->size == 0 && packet->data == nullptr) {
-        m_flushing = true;
-        av_packet_free(&packet);
-        m_queueCondition.wakeAll();
-        return;
+void VideoDecodeThread::run() {
+    prepareDecoding();
+
+    while (m_running) {
+        StepResult result = step();
+        if (result.status == StepResult::Finished) {
+            break;
+        }
+        if (result.status == StepResult::Idle) {
+            // 队列为空时阻塞等待，超时后重新检查运行状态
+            m_packetRing.waitForData(100);
+        } else if (result.status == StepResult::Wait) {
+            QThread::msleep(static_cast<unsigned long>(result.waitMs));
+        }
     }
 
-    // 添加到队列
-    m_packetQueue.enqueue(packet);
-    m_queueCondition.wakeOne();
+    LogInfo << "Video decoding thread stopped";
 }
 
-void VideoDecodeThread::updateAudioClock(qint64 clock) {
-    m_audioClock = clock;
-}
+StepResult VideoDecodeThread::step() {
+    if (!m_running || !m_packet) {
+        return StepResult::finished();
+    }
 
-void VideoDecodeThread::run() {
-    m_running = true;
-    m_flushing = false;
+    // 所有输出都不可见时暂停解码
+    StepResult suspendedResult = StepResult::progress();
+    if (!handleSuspension(&suspendedResult)) {
+        return suspendedResult;
+    }
 
-    QElapsedTimer frameTimer;
-    frameTimer.start();
+    // 新加入的输出（共享同一路流的显示组件）先显示最近一帧，仅关键帧模式下下一帧可能要等一个GOP
+    if (m_outputsAdded.exchange(false) && m_lastFrame) {
+        presentFrame(m_lastFrame, true);
+    }
 
-    qint64 lastFrameTime = 0;
-    qint64 frameNumber = 0;
+    // 先显示已解码的帧，未到显示时间时等待，不继续解码
+    if (!m_pendingFrames.empty()) {
+        StepResult result = presentPendingFrames();
+        if (result.status != StepResult::Progress || !m_pendingFrames.empty()) {
+            return result;
+        }
+    }
 
-    while (m_running || !m_flushing) {
-        AVPacket *packet = nullptr;
+    // 流结束且剩余帧已全部显示
+    if (m_flushing) {
+        emit videoFrameDecoded(-1, nullptr);
+        LogInfo << "Video stream reached end";
+        return StepResult::finished();
+    }
 
-        {
-            QMutexLocker locker(&m_queueMutex);
-            if (m_packetQueue.isEmpty()) {
-                if (m_flushing) {
-                    break;
-                }
-                m_queueCondition.wait(&m_queueMutex, 100);
-                continue;
-            }
-            packet = m_packetQueue.dequeue();
-        }
+    if (m_previewPacket) {
+        decodePreviewPacket();
+        return StepResult::progress();
+    }
 
-        if (packet) {
-            if (!decodePacket(packet)) {
-                av_packet_free(&packet);
-                continue;
-            }
-            av_packet_free(&packet);
+    int64_t arrivalUs = 0;
+    if (!m_packetRing.pop(m_packet, 0, &arrivalUs)) {
+        return StepResult::idle();
+    }
+
+    if (m_targetLatencyMs > 0) {
+        skipStalePackets(&arrivalUs);
+    }
+
+    if (m_metrics && arrivalUs > 0) {
+        m_metrics->record(PipelineMetrics::VideoQueueWait, av_gettime_relative() - arrivalUs);
+    }
+
+    // 重连后的不连续标记
+    if (PacketRing::isDiscontinuity(m_packet)) {
+        handleDiscontinuity();
+        return StepResult::progress();
+    }
+
+    // 空包表示流结束，刷新解码器取出剩余帧
+    if (PacketRing::isEndOfStream(m_packet)) {
+        m_flushing = true;
+        decodePacket(nullptr);
+        return StepResult::progress();
+    }
+
+    // 显示尺寸变化时调整解码画质
+    if (m_qualityChanged.exchange(false)) {
+        updateDecodeQuality();
+    }
+
+    // 线程设置变化（活动流数量或策略变化）、lowres变化与硬件回退在关键帧处生效，不破坏参考帧
+    if ((m_threadSettingsChanged || m_lowresChanged || m_reopenRequested)
+            && (m_packet->flags & AV_PKT_FLAG_KEY)) {
+        reopenCodec();
+        if (!m_running) {
+            av_packet_unref(m_packet);
+            return StepResult::finished();
         }
+    }
+
+    // 仅关键帧模式切换
+    if (m_keyframeOnly != m_keyframeOnlyActive) {
+        m_keyframeOnlyActive = m_keyframeOnly;
+        m_waitForKeyframe = !m_keyframeOnlyActive;
+        LogInfo << "Video keyframe-only decoding " << (m_keyframeOnlyActive ? "enabled" : "disabled");
+    }
 
-        // 改进的帧率控制和音视频同步
-        if (m_frameRate > 0) {
-            qint64 currentTime = frameTimer.elapsed();
-            qint64 expectedTime = static_cast<qint64>((frameNumber * 1000.0) / m_frameRate);
+    const bool keyframe = (m_packet->flags & AV_PKT_FLAG_KEY) != 0;
+    if ((m_keyframeOnlyActive || m_waitForKeyframe) && !keyframe) {
+        av_packet_unref(m_packet);
+        return StepResult::progress();
+    }
+    m_waitForKeyframe = false;
 
-            // 音视频同步：如果有音频时钟，尝试与其同步
-            qint64 syncTarget = expectedTime;
-            qint64 audioClock = m_audioClock.load();
-            if (audioClock > 0) {
-                // 计算当前帧应该显示的时间戳
-                qint64 videoTime = static_cast<qint64>((frameNumber * 1000.0) / m_frameRate);
+    // 入队时刻随帧带出，用于统计延迟
+    m_codecContext->reordered_opaque = arrivalUs;
+    decodePacket(m_packet);
+    av_packet_unref(m_packet);
 
-                qint64 diff = videoTime - audioClock;
-                qDebug() << "[SYNC] videoTime:" << videoTime << "ms, audioClock:" << audioClock << "ms, diff:" << diff << "ms";
+    // 仅关键帧模式下立即取出该帧（不等重排窗口与帧级多线程的后续包），再复位解码器接收下一个关键帧
+    if (m_keyframeOnlyActive) {
+        decodePacket(nullptr);
+        avcodec_flush_buffers(m_codecContext);
+    }
+    return StepResult::progress();
+}
 
-                if (diff > 40) {  // 超前40ms以上
-                    QThread::msleep(static_cast<unsigned long>(qMin(diff / 2, 100LL)));
-                }
-                // 如果视频落后音频太多，跳帧
-                else if (diff < -100) {  // 落后100ms以上
-                    LogDebug << "跳帧同步: 视频落后音频" << -diff << "ms";
-                    frameNumber++; // 跳过此帧
-                    continue;
-                }
+bool VideoDecodeThread::handleSuspension(StepResult *result) {
+    if (m_suspended != m_suspendedActive) {
+        m_suspendedActive = m_suspended;
+        if (m_suspendedActive) {
+            // 待显示帧已无人观看，参考帧在丢包后也会失效
+            if (m_metrics) {
+                m_metrics->addVideoFramesDropped(static_cast<int>(m_pendingFrames.size()));
             }
-
-            // 基本帧率控制
-            qint64 waitTime = expectedTime - currentTime;
-            if (waitTime > 0 && waitTime < 200) {  // 最多等待200ms
-                QThread::msleep(static_cast<unsigned long>(waitTime));
+            m_pendingFrames.clear();
+            if (m_codecContext) {
+                avcodec_flush_buffers(m_codecContext);
+            }
+            LogInfo << "Video decoding suspended, all outputs hidden";
+        } else {
+            // 从队列中保留的关键帧开始解码，第一帧立即显示，之后由同步引擎丢掉落后的帧追上
+            m_waitForKeyframe = true;
+            m_presentNextImmediately = true;
+            LogInfo << "Video decoding resumed";
+
+            // 积压超限时关键帧可能已被丢弃，改由拉流层重放缓存的GOP
+            if (m_gopReplayHandler && !m_packetRing.hasQueuedKeyframe()) {
+                m_gopReplayHandler();
             }
-
-            frameNumber++;
         }
     }
 
+    if (!m_suspendedActive) {
+        return true;
+    }
+
+    const int dropped = m_packetRing.discardToLatestKeyframe();
+    if (dropped > 0) {
+        LogDebug << "Video suspended, discarded " << dropped << " packets before latest keyframe or marker";
+    }
+
+    // 流结束/不连续标记照常处理，其余情况定时检查（不用idle：队列非空时会立即被再次调度）
+    if (m_packetRing.frontIsMarker()) {
+        return true;
+    }
+    *result = StepResult::wait(kSuspendedPollMs);
+    return false;
+}
+
+void VideoDecodeThread::decodePreviewPacket() {
+    std::shared_ptr<AVPacket> packet = std::move(m_previewPacket);
+    m_previewPacket.reset();
+
+    // 与仅关键帧模式相同：送入后立即取出该帧再复位解码器；预览帧不计入延迟统计
+    m_codecContext->reordered_opaque = 0;
+    decodePacket(packet.get());
     decodePacket(nullptr);
-    emit videoFrameDecoded(QImage());
-    LogInfo << "Video decoding thread stopped";
+    avcodec_flush_buffers(m_codecContext);
+
+    m_presentNextImmediately = true;
+    m_waitForKeyframe = true;
+    LogInfo << "Decoded cached keyframe for first-frame preview";
 }
 
-bool VideoDecodeThread::initHardwareDecoder() {
-    if (!m_codec) return false;
+StepResult VideoDecodeThread::presentPendingFrames() {
+    while (!m_pendingFrames.empty()) {
+        const std::shared_ptr<AVFrame> frame = m_pendingFrames.front();
 
-    // 查找支持的硬件配置
-    AVHWDeviceType hwType = AV_HWDEVICE_TYPE_NONE;
-    bool hwSupported = false;
-
-    for (int i = 0;; i++) {
-        const AVCodecHWConfig *config = avcodec_get_hw_config(m_codec, i);
-        if (!config) break;
-
-        if (config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) {
-            // 优先选择D3D11VA和DXVA2
-            if (config->device_type == AV_HWDEVICE_TYPE_D3D11VA ||
-                config->device_type == AV_HWDEVICE_TYPE_DXVA2) {
-                hwType = config->device_type;
-                m_hwPixelFormat = config->pix_fmt;
-                hwSupported = true;
-                break;
+        if (m_syncEngine && !m_presentNextImmediately) {
+            AVSyncEngine::Schedule schedule =
+                m_syncEngine->schedule(framePts(frame.get()), frameDuration(frame.get()));
+            if (schedule.decision == AVSyncEngine::Wait) {
+                // 等待交给调用方（独立线程sleep / 线程池定时重排），不阻塞工作线程
+                return StepResult::wait(schedule.waitMs);
+            }
+            if (schedule.decision == AVSyncEngine::Drop) {
+                // 显示时丢帧，已解码的参考帧不受影响，也省去了转换
+                m_pendingFrames.pop_front();
+                if (m_metrics) {
+                    m_metrics->addVideoFramesDropped(1);
+                }
+                continue;
             }
         }
-    }
 
-    if (!hwSupported) {
-        LogWarn << "No suitable hardware decoder found";
-        return false;
+        m_pendingFrames.pop_front();
+        m_presentNextImmediately = false;
+        presentFrame(frame);
+        recordLatency(frame.get());
+        break;
     }
 
-    // 创建硬件设备上下文
-    int ret = av_hwdevice_ctx_create(&m_hwDeviceContext, hwType, nullptr, nullptr, 0);
-    if (ret < 0) {
-        char error[AV_ERROR_MAX_STRING_SIZE] = {0};
-        av_strerror(ret, error, sizeof(error));
-        LogWarn << "Failed to create hardware device context: " << error;
-        return false;
+    return StepResult::progress();
+}
+
+void VideoDecodeThread::handleDiscontinuity() {
+    // 断线前解出的帧与时钟都已过时
+    m_pendingFrames.clear();
+    if (m_syncEngine) {
+        m_syncEngine->reset();
     }
 
-    // 设置硬件解码
-    m_codecContext->hw_device_ctx = av_buffer_ref(m_hwDeviceContext);
-    LogInfo << "Hardware decoder initialized: " << av_hwdevice_get_type_name(hwType);
+    // 重连后的第一个包通常在GOP中间，缺少参考帧，丢弃到新的关键帧再解码
+    m_waitForKeyframe = !m_keyframeOnlyActive;
+
+    AVRational timeBase{0, 1};
+    AVCodecParameters *params = m_packetRing.takeCodecParameters(&timeBase);
+    if (!params) {
+        // 编解码参数未变，复用解码器，从新的关键帧继续
+        avcodec_flush_buffers(m_codecContext);
+        m_timeBase = timeBase;
+        m_codecContext->pkt_timebase = timeBase;
+        LogInfo << "Video stream resumed, decoder reused";
+        return;
+    }
 
-    return true;
+    // 参数变化，按新参数重新打开解码器
+    releaseCodec();
+    resetConverters();
+    if (!openCodec(params, timeBase)) {
+        LogErr << "Failed to reopen video decoder after reconnect";
+        m_running = false;
+    } else {
+        LogInfo << "Video decoder reopened with new codec parameters";
+    }
+    avcodec_parameters_free(&params);
 }
 
-bool VideoDecodeThread::createSwsContext() {
-    if (m_swsContext) {
-        return true;
-    }
+bool VideoDecodeThread::initHardwareDecoder() {
+    if (!m_codec) return false;
 
-    // 确定源像素格式（硬件解码时使用软件帧格式）
-    AVPixelFormat srcFormat = m_hardwareDecoding ?
-                              m_hwPixelFormat  :
-                              static_cast<AVPixelFormat>(m_frame->format);
+    const QList<AVHWDeviceType> preferred = m_hwDeviceTypes.isEmpty()
+                                                ? defaultHardwareDeviceTypes()
+                                                : m_hwDeviceTypes;
 
-    // 创建SWS上下文
-    m_swsContext = sws_getContext(
-        m_videoSize.width(), m_videoSize.height(), srcFormat,
-        m_targetSize.width(), m_targetSize.height(), AV_PIX_FMT_RGBA,
-        SWS_BILINEAR, nullptr, nullptr, nullptr
-        );
+    // 按优先顺序尝试：解码器需支持该设备类型，且设备能创建成功（无GPU/驱动时在此失败）
+    for (AVHWDeviceType type : preferred) {
+        AVPixelFormat hwFormat = AV_PIX_FMT_NONE;
+        for (int i = 0;; i++) {
+            const AVCodecHWConfig *config = avcodec_get_hw_config(m_codec, i);
+            if (!config) break;
 
-    if (!m_swsContext) {
-        emit errorOccurred("Failed to create image conversion context");
-        return false;
+            if ((config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX)
+                    && config->device_type == type) {
+                hwFormat = config->pix_fmt;
+                break;
+            }
+        }
+
+        const char *typeName = av_hwdevice_get_type_name(type);
+        if (hwFormat == AV_PIX_FMT_NONE) {
+            LogDebug << "Decoder " << m_codec->name << " does not support " << typeName;
+            continue;
+        }
+
+        // 创建硬件设备上下文
+        int ret = av_hwdevice_ctx_create(&m_hwDeviceContext, type, nullptr, nullptr, 0);
+        if (ret < 0) {
+            char error[AV_ERROR_MAX_STRING_SIZE] = {0};
+            av_strerror(ret, error, sizeof(error));
+            LogWarn << "Failed to create " << typeName << " device: " << error;
+            continue;
+        }
+
+        // 设置硬件解码，像素格式由get_format回调协商
+        m_hwPixelFormat = hwFormat;
+        m_codecContext->hw_device_ctx = av_buffer_ref(m_hwDeviceContext);
+        m_codecContext->opaque = this;
+        m_codecContext->get_format = &VideoDecodeThread::selectPixelFormat;
+        m_hwErrorCount = 0;
+        {
+            QMutexLocker locker(&m_statsMutex);
+            m_hwDeviceType = type;
+        }
+        LogInfo << "Hardware decoder initialized: " << typeName;
+        return true;
     }
 
-    // 分配图像缓冲区
-    m_imageBufferSize = av_image_get_buffer_size(
-        AV_PIX_FMT_RGBA, m_targetSize.width(), m_targetSize.height(), 1
-        );
+    LogWarn << "No usable hardware decoder for " << m_codec->name;
+    return false;
+}
 
-    if (m_imageBufferSize <= 0) {
-        emit errorOccurred("Invalid image buffer size");
-        return false;
+AVPixelFormat VideoDecodeThread::selectPixelFormat(AVCodecContext *context, const AVPixelFormat *formats) {
+    VideoDecodeThread *self = static_cast<VideoDecodeThread*>(context->opaque);
+
+    for (const AVPixelFormat *format = formats; *format != AV_PIX_FMT_NONE; ++format) {
+        if (*format == self->m_hwPixelFormat) {
+            return *format;
+        }
     }
 
-    m_imageBuffer = std::make_unique<uint8_t[]>(m_imageBufferSize);
+    // 码流（如不支持的profile/分辨率）无法硬件解码：本次按软件格式解码，并在下一个关键帧改为软件解码器
+    self->requestSoftwareFallback("hardware format not offered for this stream");
+    for (const AVPixelFormat *format = formats; *format != AV_PIX_FMT_NONE; ++format) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(*format);
+        if (desc && !(desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+            return *format;
+        }
+    }
+    return AV_PIX_FMT_NONE;
+}
 
-    LogInfo << "SWS context created for conversion: "
-            << av_get_pix_fmt_name(srcFormat) << " -> RGBA "
-            << m_videoSize.width() << "x" << m_videoSize.height()
-            << " -> " << m_targetSize.width() << "x" << m_targetSize.height();
+void VideoDecodeThread::requestSoftwareFallback(const char *reason) {
+    if (m_hwFailed) {
+        return;
+    }
 
-    return true;
+    m_hwFailed = true;
+    m_reopenRequested = true;
+    LogWarn << "Hardware decoding failed (" << reason << "), switching to software at next keyframe";
 }
 
 bool VideoDecodeThread::decodePacket(AVPacket *packet) {
     // 发送包到解码器
-    int ret = avcodec_send_packet(m_codecContext, packet);
+    int ret;
+    {
+        MetricTimer timer(m_metrics, PipelineMetrics::VideoSendPacket);
+        ret = avcodec_send_packet(m_codecContext, packet);
+    }
     if (ret < 0) {
         // 忽略EOF和EAGAIN错误
         if (ret != AVERROR_EOF && ret != AVERROR(EAGAIN)) {
@@ -325,6 +840,7 @@ bool VideoDecodeThread::decodePacket(AVPacket *packet) {
 
     // 接收解码帧
     while (ret >= 0) {
+        const int64_t receiveStartUs = m_metrics ? av_gettime_relative() : 0;
         ret = avcodec_receive_frame(m_codecContext, m_frame);
         if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
             return true;
@@ -333,8 +849,15 @@ bool VideoDecodeThread::decodePacket(AVPacket *packet) {
             char error[AV_ERROR_MAX_STRING_SIZE] = {0};
             av_strerror(ret, error, sizeof(error));
             LogWarn << "Error receiving frame from decoder: " << error;
+            if (m_hwDeviceContext && ++m_hwErrorCount >= kMaxHardwareErrors) {
+                requestSoftwareFallback("repeated decode errors");
+            }
             return false;
         }
+        if (m_metrics) {
+            m_metrics->record(PipelineMetrics::VideoReceiveFrame, av_gettime_relative() - receiveStartUs);
+            m_metrics->addVideoFrameDecoded();
+        }
 
         // 处理解码帧
         processDecodedFrame(m_frame);
@@ -349,31 +872,30 @@ bool VideoDecodeThread::decodePacket(AVPacket *packet) {
 void VideoDecodeThread::processDecodedFrame(AVFrame *frame) {
     AVFrame *frameToProcess = frame;
 
-    // 硬件解码处理
-    if (m_hardwareDecoding && frame->format == m_hwPixelFormat) {
+    // 硬件解码处理（get_format回退时帧已是软件格式）
+    if (m_hwDeviceContext && frame->format == m_hwPixelFormat) {
         // 将硬件帧传输到软件帧
         int ret = av_hwframe_transfer_data(m_hwFrame, frame, 0);
         if (ret < 0) {
             char error[AV_ERROR_MAX_STRING_SIZE] = {0};
             av_strerror(ret, error, sizeof(error));
             LogWarn << "Failed to transfer hardware frame: " << error;
+            if (++m_hwErrorCount >= kMaxHardwareErrors) {
+                requestSoftwareFallback("frame download failed");
+            }
             return;
         }
+        m_hwErrorCount = 0;
 
         // 复制帧属性
         av_frame_copy_props(m_hwFrame, frame);
         frameToProcess = m_hwFrame;
     }
 
-    // 创建SWS上下文（如果不存在）
-    if (!createSwsContext()) {
-        return;
-    }
-
-    // 转换帧为QImage
-    QImage image = convertFrameToImage(frameToProcess);
-    if (!image.isNull()) {
-        emit videoFrameDecoded(image);
+    // 只增加引用，转换推迟到显示时，被丢弃的帧不做转换
+    std::shared_ptr<AVFrame> pending = FrameConverter::reference(frameToProcess);
+    if (pending) {
+        m_pendingFrames.push_back(std::move(pending));
     }
 
     // 释放硬件帧（如果使用）
@@ -382,41 +904,156 @@ void VideoDecodeThread::processDecodedFrame(AVFrame *frame) {
     }
 }
 
-QImage VideoDecodeThread::convertFrameToImage(AVFrame *frame)
-{
-    uint8_t *dstData[1] = { m_imageBuffer.get() };
-    int dstLinesize[1] = { m_targetSize.width() * 4 };
+void VideoDecodeThread::presentFrame(const std::shared_ptr<AVFrame> &frame, bool newOutputsOnly) {
+    // 空输出到此为止，帧在调用方释放
+    if (m_nullOutput) {
+        if (m_metrics && !newOutputsOnly) {
+            m_metrics->addVideoFramePresented();
+        }
+        return;
+    }
+    m_lastFrame = frame;
+
+    // 逐个输出转换；尺寸与方式相同的输出共用转换结果，YUV直通的输出共享原帧引用
+    QMutexLocker locker(&m_outputsMutex);
+    std::vector<std::pair<QSize, std::shared_ptr<AVFrame>>> converted;
+    bool presented = m_outputs.empty();
+    for (VideoOutput &output : m_outputs) {
+        // 不可见的输出不转换（暂停前最后几帧、流结束时的剩余帧）
+        if (!output.visible || (newOutputsOnly && !output.needsFrame)) {
+            continue;
+        }
+        output.needsFrame = false;
+        if (output.sizeChanged) {
+            output.converter->setTargetSize(output.targetSize);
+            output.sizeChanged = false;
+        }
 
-    // 转换帧格式
-    int ret = sws_scale(m_swsContext,
-                        frame->data, frame->linesize,
-                        0, frame->height,
-                        dstData, dstLinesize);
+        std::shared_ptr<AVFrame> outFrame;
+        if (output.yuvPassthrough && FrameConverter::isDirectRenderable(frame->format)) {
+            outFrame = frame;
+        } else {
+            for (const auto &item : converted) {
+                if (item.first == output.targetSize) {
+                    outFrame = item.second;
+                    break;
+                }
+            }
+            if (!outFrame) {
+                MetricTimer timer(m_metrics, PipelineMetrics::VideoScale);
+                outFrame = output.converter->convert(frame.get());
+                if (outFrame) {
+                    converted.emplace_back(output.targetSize, outFrame);
+                }
+            }
+        }
 
-    if (ret <= 0) {
-        LogWarn << "Failed to convert frame to image";
-        return QImage();
+        if (outFrame) {
+            presented = true;
+            emit videoFrameDecoded(output.id, outFrame);
+        }
     }
 
-    // 创建QImage（使用内存拷贝）
-    QImage image(m_imageBuffer.get(),
-                 m_targetSize.width(), m_targetSize.height(),
-                 QImage::Format_RGBA8888);
+    if (presented && m_metrics && !newOutputsOnly) {
+        m_metrics->addVideoFramePresented();
+    }
+}
 
-    return image.copy();
+void VideoDecodeThread::resetConverters() {
+    QMutexLocker locker(&m_outputsMutex);
+    for (VideoOutput &output : m_outputs) {
+        output.converter->reset();
+        output.sizeChanged = true;
+    }
+}
+
+void VideoDecodeThread::skipStalePackets(int64_t *arrivalUs) {
+    if (m_timeBase.num <= 0 || m_timeBase.den <= 0) {
+        return;
+    }
+
+    const int64_t maxDelay = av_rescale_q(m_targetLatencyMs.load(), AVRational{1, 1000}, m_timeBase);
+    const int skipped = m_packetRing.skipToKeyframe(m_packet, maxDelay, arrivalUs);
+    if (skipped <= 0) {
+        return;
+    }
+
+    // 丢包后参考帧已失效，从关键帧重新开始解码，之前解出的帧也已过时
+    avcodec_flush_buffers(m_codecContext);
+    if (m_metrics) {
+        m_metrics->addVideoFramesDropped(static_cast<int>(m_pendingFrames.size()));
+    }
+    m_pendingFrames.clear();
+
+    {
+        QMutexLocker locker(&m_statsMutex);
+        m_latencyStats.skippedPackets += skipped;
+        m_latencyStats.skipEvents++;
+    }
+    LogInfo << "Video latency above " << m_targetLatencyMs.load()
+            << "ms, skipped " << skipped << " packets to next keyframe";
+}
+
+void VideoDecodeThread::recordLatency(const AVFrame *frame) {
+    if (frame->reordered_opaque <= 0) {
+        return;
+    }
+
+    const int64_t nowUs = av_gettime_relative();
+    const double latencyMs = (nowUs - frame->reordered_opaque) / 1000.0;
+
+    QMutexLocker locker(&m_statsMutex);
+    m_latencyStats.lastMs = latencyMs;
+    m_latencyStats.averageMs = m_latencyStats.averageMs > 0
+                                   ? m_latencyStats.averageMs * 0.9 + latencyMs * 0.1
+                                   : latencyMs;
+    m_latencyStats.maxMs = qMax(m_latencyStats.maxMs, latencyMs);
+
+    // 低延迟模式定期输出实际延迟
+    if (m_lowLatency && nowUs - m_lastLatencyReportUs > 5000000) {
+        m_lastLatencyReportUs = nowUs;
+        LogInfo << "Live latency: last " << latencyMs << "ms, avg " << m_latencyStats.averageMs
+                << "ms, max " << m_latencyStats.maxMs << "ms, skipped "
+                << m_latencyStats.skippedPackets << " packets";
+    }
+}
+
+double VideoDecodeThread::framePts(const AVFrame *frame) const {
+    if (m_timeBase.num <= 0 || m_timeBase.den <= 0) {
+        return NAN;
+    }
+
+    int64_t timestamp = frame->best_effort_timestamp;
+    if (timestamp == AV_NOPTS_VALUE) {
+        timestamp = frame->pts;
+    }
+    if (timestamp == AV_NOPTS_VALUE) {
+        return NAN;
+    }
+    return timestamp * av_q2d(m_timeBase);
+}
+
+double VideoDecodeThread::frameDuration(const AVFrame *frame) const {
+    if (frame->pkt_duration > 0 && m_timeBase.num > 0) {
+        return frame->pkt_duration * av_q2d(m_timeBase);
+    }
+    if (m_frameRate > 0) {
+        return 1.0 / m_frameRate;
+    }
+    return 0.04;
 }
 
 void VideoDecodeThread::cleanup() {
+    const bool hadResources = m_packet || m_frame || m_codecContext || m_threadingId >= 0;
+
     // 清空包队列
-    {
-        QMutexLocker locker(&m_queueMutex);
-        while (!m_packetQueue.isEmpty()) {
-            AVPacket *packet = m_packetQueue.dequeue();
-            av_packet_free(&packet);
-        }
+    m_packetRing.clear();
+
+    // 释放包和帧
+    if (m_packet) {
+        av_packet_free(&m_packet);
     }
 
-    // 释放帧
     if (m_frame) {
         av_frame_free(&m_frame);
         m_frame = nullptr;
@@ -427,6 +1064,25 @@ void VideoDecodeThread::cleanup() {
         m_hwFrame = nullptr;
     }
 
+    releaseCodec();
+
+    // 释放待显示帧与转换上下文
+    m_pendingFrames.clear();
+    m_previewPacket.reset();
+    m_lastFrame.reset();
+    resetConverters();
+
+    // 重置状态
+    m_running = false;
+    m_flushing = false;
+    unregisterThreading();
+
+    if (hadResources) {
+        LogInfo << "Video decoder resources cleaned up";
+    }
+}
+
+void VideoDecodeThread::releaseCodec() {
     // 释放解码器上下文
     if (m_codecContext) {
         avcodec_free_context(&m_codecContext);
@@ -439,22 +1095,10 @@ void VideoDecodeThread::cleanup() {
         m_hwDeviceContext = nullptr;
     }
 
-    // 释放SWS上下文
-    if (m_swsContext) {
-        sws_freeContext(m_swsContext);
-        m_swsContext = nullptr;
-    }
-
-    // 释放图像缓冲区
-    m_imageBuffer.reset();
-    m_imageBufferSize = 0;
-
-    // 重置状态
-    m_running = false;
-    m_flushing = false;
     m_hwPixelFormat = AV_PIX_FMT_NONE;
 
-    LogInfo << "Video decoder resources cleaned up";
+    QMutexLocker locker(&m_statsMutex);
+    m_hwDeviceType = AV_HWDEVICE_TYPE_NONE;
 }
 
 double VideoDecodeThread::frameRate() const
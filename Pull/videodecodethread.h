@@ -2,13 +2,20 @@
 #define VIDEODECODETHREAD_H
 
 #include <QThread>
-#include <QMutex>
-#include <QQueue>
 #include <QSize>
-#include <QImage>
+#include <QMutex>
+#include <QList>
+#include <deque>
+#include <functional>
 #include <memory>
-#include <QWaitCondition>
+#include <vector>
 #include "DataStruct.h"
+#include "packetring.h"
+#include "frameconverter.h"
+#include "decodethreading.h"
+
+class AVSyncEngine;
+class PipelineMetrics;
 
 
 class VideoDecodeThread : public QThread
@@ -18,12 +25,100 @@ public:
     explicit VideoDecodeThread(QObject *parent = nullptr);
     ~VideoDecodeThread();
 
-    bool init(AVCodecParameters *codecParams);
-    void setTargetSize(const QSize &size);
+    // timeBase为流时间基，用于将帧时间戳换算为秒
+    bool init(const AVCodecParameters *codecParams, AVRational timeBase);
+
+    // 设置同步引擎（需在启动前设置），为空时解码后立即显示
+    void setSyncEngine(AVSyncEngine *syncEngine);
+
+    // 设置流水线统计（需在启动前设置），为空时不统计
+    void setMetrics(PipelineMetrics *metrics);
+
+    // 显示输出：一次解码分发给多个显示组件，每个输出有自己的目标尺寸与转换上下文，
+    // 尺寸与方式相同的输出共用一次转换。以下接口线程安全，解码线程在下一帧生效
+    int addOutput(const QSize &targetSize, bool yuvPassthrough = false);
+    void removeOutput(int outputId);
+    int outputCount() const;
+
+    // 设置输出的显示区域尺寸
+    void setOutputTargetSize(int outputId, const QSize &size);
 
-    // 设置硬件解码
+    // YUV直通：可直接渲染的YUV帧不做sws_scale，原样交给GL渲染组件
+    void setOutputYuvPassthrough(int outputId, bool enable);
+
+    // 输出要求全画质（画面放大时），不论当前尺寸
+    void setOutputFullQuality(int outputId, bool enable);
+
+    // 输出是否可见（隐藏、最小化或被遮挡时为false）。所有输出都不可见时暂停解码：
+    // 不再解码与转换，包队列只保留最近一个GOP；任一输出恢复可见后从该关键帧起解码，
+    // 第一帧不等同步时钟立即显示
+    void setOutputVisible(int outputId, bool visible);
+    bool isSuspended() const { return m_suspended; }
+
+    // 按显示尺寸降低解码画质（默认开启）：所有输出都远小于视频时跳过环路滤波/IDCT，
+    // 解码器支持时使用lowres低分辨率解码；任一输出变大或放大后恢复全画质
+    void setTileAwareDecoding(bool enable);
+
+    // 解码画质级别
+    enum DecodeQualityLevel {
+        FullQuality,        // 完整解码
+        ReducedQuality,     // 输出不超过视频的1/2：非参考帧跳过环路滤波与IDCT，lowres 1
+        MinimalQuality      // 输出不超过视频的1/4：同ReducedQuality，lowres 2
+    };
+    DecodeQualityLevel decodeQuality() const { return m_qualityLevel; }
+
+    // 仅关键帧模式（可随时切换，用于大规模画面墙预览）：非关键帧包在送入解码器前丢弃，
+    // 每个关键帧单独解码并立即输出；切回全帧率时保持当前画面，从下一个关键帧起连续解码
+    void setKeyframeOnly(bool enable);
+    bool isKeyframeOnly() const { return m_keyframeOnly; }
+
+    // 设置硬件解码（需在init前设置）
     void setHardwareDecoding(const bool &enable);
 
+    // 硬件设备类型的优先顺序（需在init前设置），依次尝试，解码器不支持或设备创建失败时试下一个，
+    // 全部失败时使用软件解码；为空时使用当前平台的默认顺序
+    void setHardwareDeviceTypes(const QList<AVHWDeviceType> &types);
+
+    // 当前平台的默认顺序：Windows D3D11VA/DXVA2/CUDA，Linux VAAPI/VDPAU/CUDA，macOS VideoToolbox
+    static QList<AVHWDeviceType> defaultHardwareDeviceTypes();
+
+    // 按名称解析（逗号分隔，如 "vaapi,vdpau"），"auto" 为默认顺序，未知名称忽略并告警
+    static QList<AVHWDeviceType> parseHardwareDeviceTypes(const QString &names);
+
+    // 实际使用的解码方式：硬件设备类型名（如 "vaapi"），软件解码时为 "software"
+    QString activeDecoderName() const;
+
+    // 首帧预览（init之后、启动之前设置）：解码开始前先单独解码该关键帧（通常来自GOP缓存）并立即显示，
+    // 之后从包队列的下一个关键帧起连续解码，不显示缺少参考帧的画面
+    void setPreviewPacket(std::shared_ptr<AVPacket> packet);
+
+    // 暂停后恢复解码而包队列中已没有关键帧时调用（需在启动前设置），
+    // 由拉流层把缓存的GOP重放到包队列，不等下一个关键帧
+    void setGopReplayHandler(std::function<void()> handler);
+
+    // 空输出：帧照常按同步调度"显示"并计入统计，但不做格式转换、不发出videoFrameDecoded
+    void setNullOutput(bool enable);
+
+    // 低延迟模式（需在init前设置）：解码器低延迟标志，包队列排队超过目标延迟时跳到最近的关键帧
+    void setLowLatency(bool enable, int targetLatencyMs);
+
+    // 本路解码线程数（threadCount<0 时按全局 DecodeThreadingPolicy 决定）；
+    // 解码中修改时在下一个关键帧处重新打开解码器生效
+    void setDecodeThreads(int threadCount, int threadType = FF_THREAD_FRAME | FF_THREAD_SLICE);
+
+    // 当前解码器使用的线程设置
+    DecodeThreadingPolicy::Settings decodeThreads() const;
+
+    // 延迟统计：数据包入队到画面发出的时长（不含网络与显示）
+    struct LatencyStats {
+        double lastMs = 0.0;
+        double averageMs = 0.0;
+        double maxMs = 0.0;
+        quint64 skippedPackets = 0;     // 为追赶目标延迟丢弃的包数
+        quint64 skipEvents = 0;         // 跳关键帧次数
+    };
+    LatencyStats latencyStats() const;
+
     // 关闭解码器
     void close();
 
@@ -36,39 +131,104 @@ public:
     double frameRate() const;
     void setFrameRate(double newFrameRate);
 
+    // 包队列，由拉流线程直接写入
+    PacketRing *packetRing() { return &m_packetRing; }
+
+    // 以外部调度方式启动（线程池模式），不创建线程，由调度器驱动step
+    void startExternal();
+
+    // 执行一步：按同步引擎的调度显示已解码帧，或解码一个数据包
+    StepResult step();
+
 signals:
-    // 视频帧就绪信号
-    void videoFrameDecoded(const QImage& image);
+    // 视频帧就绪信号：RGBA帧已按该输出的显示尺寸转换，可直接绘制；
+    // 开启YUV直通时为解码原帧的引用（多个输出共享，只读）。
+    // 流结束时发出一次 outputId 为 -1 的空帧
+    void videoFrameDecoded(int outputId, std::shared_ptr<AVFrame> frame);
     // 错误信号
     void errorOccurred(const QString &error);
     // 视频信息信号
     void videoInfoUpdated(int width, int height, double frameRate);
 
-public slots:
-    // 接收视频包
-    void onVideoPacketReceived(AVPacket *packet);
-    // 更新音频时钟
-    void updateAudioClock(qint64 clock);
-
-
 protected:
     void run() override;
 
 private:
-    // 初始化硬件解码器
+    // 重置运行状态
+    void prepareDecoding();
+
+    // 创建并打开解码器 / 释放解码器
+    bool openCodec(const AVCodecParameters *codecParams, AVRational timeBase);
+    void releaseCodec();
+
+    // 处理重连后的不连续标记：参数不变时刷新解码器，否则重新打开
+    void handleDiscontinuity();
+
+    // 按优先顺序初始化硬件解码器
     bool initHardwareDecoder();
 
-    // 创建SWS上下文
-    bool createSwsContext();
+    // get_format回调：选择硬件像素格式，硬件不支持当前码流时回退到软件格式
+    static AVPixelFormat selectPixelFormat(AVCodecContext *context, const AVPixelFormat *formats);
+
+    // 硬件解码运行中失败，在下一个关键帧处改为软件解码重新打开
+    void requestSoftwareFallback(const char *reason);
+
+    // 按本路设置或全局策略计算解码线程设置 / 写入解码器上下文（avcodec_open2前调用）
+    DecodeThreadingPolicy::Settings desiredThreadSettings() const;
+    void applyThreadSettings();
+
+    // 线程设置、lowres变化或硬件回退后在关键帧处重新打开解码器，先取出解码器中缓存的帧
+    void reopenCodec();
+
+    // 按输出尺寸计算解码画质 / 写入解码器上下文
+    struct DecodeQuality {
+        DecodeQualityLevel level = FullQuality;
+        int lowres = 0;
+        AVDiscard skipLoopFilter = AVDISCARD_DEFAULT;
+        AVDiscard skipIdct = AVDISCARD_DEFAULT;
+    };
+    DecodeQuality desiredDecodeQuality() const;
+    void applyDecodeQuality(const DecodeQuality &quality);
+
+    // 输出尺寸变化后更新解码画质，lowres变化需在关键帧处重新打开
+    void updateDecodeQuality();
+
+    // 注销全局线程策略中的解码器
+    void unregisterThreading();
 
     // 解码视频包
     bool decodePacket(AVPacket *packet);
 
-    // 处理解码帧
+    // 处理解码帧（硬件帧下载后加入待显示队列）
     void processDecodedFrame(AVFrame *frame);
 
-    // 转换帧为QImage
-    QImage convertFrameToImage(AVFrame *frame);
+    // 按输出可见性更新暂停请求（调用方持有m_outputsMutex）
+    void updateSuspended();
+
+    // 所有输出不可见时的处理：丢弃积压到最近的关键帧，返回false表示本轮不再解码
+    bool handleSuspension(StepResult *result);
+
+    // 按同步调度显示或丢弃待显示帧
+    StepResult presentPendingFrames();
+
+    // 转换并发出显示帧（逐个输出），newOutputsOnly只发给尚未显示过画面的输出
+    void presentFrame(const std::shared_ptr<AVFrame> &frame, bool newOutputsOnly = false);
+
+    // 单独解码预览关键帧
+    void decodePreviewPacket();
+
+    // 释放所有输出的转换上下文
+    void resetConverters();
+
+    // 低延迟模式下丢弃超出目标延迟的排队包
+    void skipStalePackets(int64_t *arrivalUs);
+
+    // 记录一帧的入队到显示延迟
+    void recordLatency(const AVFrame *frame);
+
+    // 帧时间戳与时长（秒）
+    double framePts(const AVFrame *frame) const;
+    double frameDuration(const AVFrame *frame) const;
 
     // 清理资源
     void cleanup();
@@ -80,31 +240,88 @@ private:
     const AVCodec *m_codec = nullptr;
 
     // 帧处理
+    AVPacket *m_packet = nullptr;
     AVFrame *m_frame = nullptr;
     AVFrame *m_hwFrame = nullptr;
     enum AVPixelFormat m_hwPixelFormat = AV_PIX_FMT_NONE;
+    AVHWDeviceType m_hwDeviceType = AV_HWDEVICE_TYPE_NONE;
+    QList<AVHWDeviceType> m_hwDeviceTypes;
+    bool m_hwFailed = false;                // 本次播放硬件解码已失败，重新打开时不再尝试
+    int m_hwErrorCount = 0;                 // 连续的硬件解码/下载错误
+    AVRational m_timeBase{0, 1};
+
+    // 已解码、等待显示的帧（只在队列为空时继续解码，长度不超过单个包解出的帧数）
+    std::deque<std::shared_ptr<AVFrame>> m_pendingFrames;
+    AVSyncEngine *m_syncEngine = nullptr;
+    PipelineMetrics *m_metrics = nullptr;
 
 
-    // 转换
-    SwsContext *m_swsContext = nullptr;
-    std::unique_ptr<uint8_t[]> m_imageBuffer;
-    int m_imageBufferSize = 0;
+    // 显示输出，转换上下文只在解码线程使用
+    struct VideoOutput {
+        int id = 0;
+        QSize targetSize;
+        bool sizeChanged = true;
+        bool yuvPassthrough = false;
+        bool fullQuality = false;
+        bool visible = true;
+        bool needsFrame = true;         // 新加入，尚未显示过画面
+        std::unique_ptr<FrameConverter> converter;
+    };
+    mutable QMutex m_outputsMutex;
+    std::vector<VideoOutput> m_outputs;
+    int m_nextOutputId = 1;
 
     // 包队列
-    QQueue<AVPacket*> m_packetQueue;
-    QMutex m_queueMutex;
-    QWaitCondition m_queueCondition;
+    PacketRing m_packetRing{512};
 
     // 状态控制
     std::atomic_bool m_running{false};
     std::atomic_bool m_hardwareDecoding{false};
     std::atomic_bool m_flushing{false};
+    std::atomic_bool m_nullOutput{false};
+    std::atomic_bool m_lowLatency{false};
+    std::atomic<int> m_targetLatencyMs{0};
+
+    // 解码线程设置
+    std::atomic<int> m_threadCountOverride{-1};
+    std::atomic<int> m_threadTypeOverride{FF_THREAD_FRAME | FF_THREAD_SLICE};
+    std::atomic_bool m_threadSettingsChanged{false};
+    std::atomic_bool m_reopenRequested{false};
+
+    // 按显示尺寸的解码画质（解码线程访问，级别供查询）
+    std::atomic_bool m_tileAwareDecoding{true};
+    std::atomic_bool m_qualityChanged{true};
+    std::atomic<DecodeQualityLevel> m_qualityLevel{FullQuality};
+    DecodeQuality m_decodeQuality;
+    bool m_lowresChanged = false;
+
+    // 仅关键帧模式（解码线程按请求切换）
+    std::atomic_bool m_keyframeOnly{false};
+    bool m_keyframeOnlyActive = false;
+    bool m_waitForKeyframe = false;         // 切回全帧率后参考帧已清空，等待关键帧
+
+    // 不可见时暂停解码（解码线程按请求切换）
+    std::atomic_bool m_suspended{false};
+    bool m_suspendedActive = false;
+    bool m_presentNextImmediately = false;  // 恢复后第一帧跳过同步调度
+    std::function<void()> m_gopReplayHandler;
+
+    // 首帧预览与最近显示的帧（新加入的输出立即显示，不等下一帧解码）
+    std::shared_ptr<AVPacket> m_previewPacket;
+    std::shared_ptr<AVFrame> m_lastFrame;
+    std::atomic_bool m_outputsAdded{false};
+    QSize m_sourceSize;                     // 码流原始分辨率（不受lowres影响）
+    DecodeThreadingPolicy::Settings m_threadSettings;
+    int m_threadingId = -1;
+
+    // 延迟统计
+    mutable QMutex m_statsMutex;
+    LatencyStats m_latencyStats;
+    int64_t m_lastLatencyReportUs = 0;
 
     // 视频信息
-    QSize m_targetSize;
     QSize m_videoSize;
     double m_frameRate = 0.0;
-    std::atomic<qint64> m_audioClock{0};
 };
 
 #endif // VIDEODECODETHREAD_H
@@ -4,6 +4,9 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 CONFIG += c++17
 
+# 编译期最低日志级别（0调试 1信息 2警告 3错误 4关闭），发布版不生成调试日志代码
+CONFIG(release, debug|release): DEFINES += LOG_MIN_LEVEL=1
+
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
@@ -17,12 +20,24 @@ win32:CONFIG(release, debug|release): DESTDIR += $$PWD/bin/Release
 else:win32:CONFIG(debug, debug|release): DESTDIR += $$PWD/bin/Debug
 
 SOURCES += \
+    LogDemo/Logger.cpp \
     Pull/audiodecodethread.cpp \
+    Pull/avsyncengine.cpp \
+    Pull/decodescheduler.cpp \
+    Pull/decodethreading.cpp \
+    Pull/frameconverter.cpp \
+    Pull/framepool.cpp \
+    Pull/glvideorenderer.cpp \
+    Pull/gopcache.cpp \
+    Pull/packetring.cpp \
+    Pull/pipelinemetrics.cpp \
     Pull/rtspsyncpull.cpp \
+    Pull/streammanager.cpp \
     Pull/streampullthread.cpp \
     Pull/videodecodethread.cpp \
     Pull/playimage.cpp \
     Pull/audioplayer.cpp \
+    Pull/audioringbuffer.cpp \
 #    ffmpegdecode.cpp \
 #    ffmpegthread.cpp \
     main.cpp \
@@ -32,12 +47,26 @@ SOURCES += \
 
 HEADERS += \
     DataStruct.h \
+    LogDemo/Logger.h \
+    LogDemo/LoggerTemplate.h \
+    LogDemo/StructuredLog.h \
     Pull/audiodecodethread.h \
+    Pull/avsyncengine.h \
+    Pull/decodescheduler.h \
+    Pull/decodethreading.h \
+    Pull/frameconverter.h \
+    Pull/framepool.h \
+    Pull/glvideorenderer.h \
+    Pull/gopcache.h \
+    Pull/packetring.h \
+    Pull/pipelinemetrics.h \
     Pull/rtspsyncpull.h \
+    Pull/streammanager.h \
     Pull/streampullthread.h \
     Pull/videodecodethread.h \
     Pull/playimage.h \
     Pull/audioplayer.h \
+    Pull/audioringbuffer.h \
 #    ffmpegdecode.h \
 #    ffmpegthread.h \
     mainwindow.h \
@@ -1,9 +1,11 @@
 ﻿#include "mainwindow.h"
 
 #include <QApplication>
+#include <Logger.h>
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    Logger::initLog();
     MainWindow w;
     w.show();
     return a.exec();